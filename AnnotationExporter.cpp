@@ -0,0 +1,124 @@
+#include "AnnotationExporter.h"
+#include "AnnotationManager.h"
+#include "YoloLabelWriter.h"
+#include <QDir>
+#include <QMetaObject>
+#include <QRunnable>
+#include <QThread>
+
+namespace {
+
+// Large enough to amortize the queued result, small enough for smooth progress
+const int ChunkSize = 512;
+
+class ExportTask : public QRunnable
+{
+public:
+    ExportTask(QObject *target, const QSharedPointer<AnnotationStore> &store,
+               const QStringList &keys, const QString &labelsDirectory, quint64 generation)
+        : m_target(target), m_store(store), m_keys(keys),
+          m_labelsDirectory(labelsDirectory), m_generation(generation)
+    {
+    }
+
+    void run() override
+    {
+        int written = 0;
+        int failed = 0;
+        QVector<YoloLabelParser::Box> boxes;
+        YoloLabelWriter writer;
+        for (const QString &key : m_keys) {
+            boxes.clear();
+            if (!m_store->get(key, boxes)) {
+                failed++;
+                continue;
+            }
+            writer.clear();
+            for (const YoloLabelParser::Box &box : boxes) {
+                writer.appendBox(box.classId, box.xCenter, box.yCenter, box.width, box.height);
+            }
+            if (AnnotationManager::writeFileAtomically(m_labelsDirectory + "/" + key, writer.data())) {
+                written++;
+            } else {
+                failed++;
+            }
+        }
+
+        QMetaObject::invokeMethod(m_target, "onChunkExported", Qt::QueuedConnection,
+                                  Q_ARG(int, written),
+                                  Q_ARG(int, failed),
+                                  Q_ARG(quint64, m_generation));
+    }
+
+private:
+    QObject *m_target;
+    QSharedPointer<AnnotationStore> m_store;
+    QStringList m_keys;
+    QString m_labelsDirectory;
+    quint64 m_generation;
+};
+
+} // namespace
+
+AnnotationExporter::AnnotationExporter(QObject *parent)
+    : QObject(parent),
+      m_total(0),
+      m_written(0),
+      m_failed(0),
+      m_generation(0)
+{
+    // Formatting is cheap; the threads mostly wait on file creation
+    m_pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+}
+
+AnnotationExporter::~AnnotationExporter()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+bool AnnotationExporter::start(const QSharedPointer<AnnotationStore> &store, const QString &labelsDirectory)
+{
+    if (isRunning() || !store) {
+        return false;
+    }
+
+    QStringList keys = store->keys();
+    if (keys.isEmpty() || !QDir().mkpath(labelsDirectory)) {
+        emit finished(0, keys.size());
+        return true;
+    }
+
+    m_total = keys.size();
+    m_written = 0;
+    m_failed = 0;
+    for (int i = 0; i < keys.size(); i += ChunkSize) {
+        m_pool.start(new ExportTask(this, store, keys.mid(i, ChunkSize), labelsDirectory, m_generation));
+    }
+    emit progress(0, m_total);
+    return true;
+}
+
+void AnnotationExporter::cancel()
+{
+    // Chunks already running still finish their files
+    m_pool.clear();
+    m_generation++;
+    m_total = 0;
+}
+
+void AnnotationExporter::onChunkExported(int written, int failed, quint64 generation)
+{
+    if (generation != m_generation || m_total == 0) {
+        return;
+    }
+    m_written += written;
+    m_failed += failed;
+
+    int done = m_written + m_failed;
+    emit progress(done, m_total);
+    if (done >= m_total) {
+        m_total = 0;
+        emit finished(m_written, m_failed);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef ANNOTATIONEXPORTER_H
+#define ANNOTATIONEXPORTER_H
+
+#include "AnnotationStore.h"
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QString>
+
+/**
+ * @brief Writes the records of an AnnotationStore out as YOLO label files
+ *
+ * The keys of the store are split into chunks that are formatted and
+ * written on a pool, each chunk with its own YoloLabelWriter buffer, so
+ * the labels/<image>.txt files of a large dataset are written in parallel.
+ * Files are replaced atomically; the store stays readable (and writable)
+ * while an export runs.
+ */
+class AnnotationExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AnnotationExporter(QObject *parent = nullptr);
+    ~AnnotationExporter();
+
+    // Export every key of store to labelsDirectory/<key>; false if an
+    // export is already running
+    bool start(const QSharedPointer<AnnotationStore> &store, const QString &labelsDirectory);
+
+    // Chunks not started yet are dropped; finished() is not emitted
+    void cancel();
+    bool isRunning() const { return m_total > 0; }
+
+signals:
+    void progress(int done, int total);
+    void finished(int written, int failed);
+
+private slots:
+    void onChunkExported(int written, int failed, quint64 generation);
+
+private:
+    QThreadPool m_pool;
+    int m_total;                // Keys of the running export, 0 when idle
+    int m_written;
+    int m_failed;
+    quint64 m_generation;       // Bumped by cancel()
+};
+
+#endif // ANNOTATIONEXPORTER_H
@@ -0,0 +1,385 @@
+#include "AnnotationIndex.h"
+#include "AnnotationManager.h"
+#include "YoloLabelParser.h"
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+namespace {
+
+const int ChunkSize = 512;
+// Replaced boxes are only worth dropping once there are many of them
+const int MinCompactGarbage = 4096;
+
+class LoadTask : public QRunnable
+{
+public:
+    LoadTask(QObject *target, const QSharedPointer<AnnotationIndex::Chunk> &chunk,
+             const QString &labelsDirectory, const QSharedPointer<AnnotationStore> &store,
+             const QSharedPointer<AnnotationIndex::Results> &results,
+             QAtomicInt *currentGeneration, int generation)
+        : m_target(target), m_chunk(chunk), m_labelsDirectory(labelsDirectory), m_store(store),
+          m_results(results), m_currentGeneration(currentGeneration), m_generation(generation)
+    {
+    }
+
+    void run() override
+    {
+        QVector<YoloLabelParser::Box> parsed;
+        m_chunk->boxCounts.reserve(m_chunk->imagePaths.size());
+        for (const QString &path : m_chunk->imagePaths) {
+            if (m_currentGeneration->load() != m_generation) {
+                return;
+            }
+
+            QString key = AnnotationManager::labelFileName(path);
+            parsed.clear();
+            bool found;
+            if (m_store) {
+                found = m_store->get(key, parsed);
+            } else {
+                // Malformed lines are skipped; only a missing file means "not annotated"
+                YoloLabelParser::Error error;
+                found = YoloLabelParser::parseFile(m_labelsDirectory + "/" + key, parsed, &error, true) ||
+                        error.line != 0;
+            }
+
+            m_chunk->boxCounts.append(found ? parsed.size() : -1);
+            for (const YoloLabelParser::Box &box : parsed) {
+                AnnotationIndex::Box compact;
+                compact.classId = box.classId;
+                compact.xCenter = static_cast<float>(box.xCenter);
+                compact.yCenter = static_cast<float>(box.yCenter);
+                compact.width = static_cast<float>(box.width);
+                compact.height = static_cast<float>(box.height);
+                m_chunk->boxes.append(compact);
+            }
+        }
+
+        {
+            QMutexLocker locker(&m_results->mutex);
+            m_results->chunks.append(m_chunk);
+        }
+        QMetaObject::invokeMethod(m_target, "onChunkLoaded", Qt::QueuedConnection,
+                                  Q_ARG(int, m_generation));
+    }
+
+private:
+    QObject *m_target;
+    QSharedPointer<AnnotationIndex::Chunk> m_chunk;
+    QString m_labelsDirectory;
+    QSharedPointer<AnnotationStore> m_store;
+    QSharedPointer<AnnotationIndex::Results> m_results;
+    QAtomicInt *m_currentGeneration;
+    int m_generation;
+};
+
+} // namespace
+
+AnnotationIndex::AnnotationIndex(QObject *parent)
+    : QObject(parent),
+      m_generation(0),
+      m_results(new Results),
+      m_garbageBoxes(0),
+      m_pending(0),
+      m_annotatedImages(0),
+      m_totalBoxes(0)
+{
+    // Label files are tiny; the threads mostly wait on the filesystem
+    m_pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+}
+
+AnnotationIndex::~AnnotationIndex()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void AnnotationIndex::setSource(const QString &labelsDirectory, const QSharedPointer<AnnotationStore> &store)
+{
+    clear();
+    m_labelsDirectory = labelsDirectory;
+    m_store = store;
+}
+
+void AnnotationIndex::append(const QStringList &imagePaths)
+{
+    if (imagePaths.isEmpty()) {
+        return;
+    }
+    int first = m_ranges.size();
+    Range pending = {0, Pending};
+    m_imagePaths += imagePaths;
+    m_ranges.insert(m_ranges.end(), imagePaths.size(), pending);
+    m_pending += imagePaths.size();
+    load(first, imagePaths.size());
+}
+
+void AnnotationIndex::removeIndexes(const QVector<int> &indexes)
+{
+    if (indexes.isEmpty()) {
+        return;
+    }
+
+    QStringList imagePaths;
+    QVector<Range> ranges;
+    imagePaths.reserve(m_imagePaths.size() - indexes.size());
+    ranges.reserve(m_ranges.size() - indexes.size());
+    int next = 0;
+    for (int image = 0; image < m_ranges.size(); ++image) {
+        if (next < indexes.size() && indexes[next] == image) {
+            next++;
+            account(image, -1);
+            m_garbageBoxes += boxCount(image);
+            if (m_ranges[image].count == Pending) {
+                m_pending--;
+            }
+            continue;
+        }
+        imagePaths.append(m_imagePaths[image]);
+        ranges.append(m_ranges[image]);
+    }
+    m_imagePaths = imagePaths;
+    m_ranges = ranges;
+
+    // Chunks still loading refer to the old queue indexes
+    if (m_pending > 0) {
+        m_generation.fetchAndAddOrdered(1);
+        m_pool.clear();
+        m_results.reset(new Results);
+        loadPending();
+    }
+    emit changed();
+}
+
+void AnnotationIndex::renameImage(int image, const QString &imagePath)
+{
+    if (image < 0 || image >= m_ranges.size()) {
+        return;
+    }
+    m_imagePaths[image] = imagePath;
+    if (m_ranges[image].count != Pending) {
+        account(image, -1);
+        m_garbageBoxes += boxCount(image);
+        m_ranges[image].count = Pending;
+        m_pending++;
+    }
+
+    // Chunks still loading may carry the old name
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_results.reset(new Results);
+    loadPending();
+    emit changed();
+}
+
+void AnnotationIndex::reload()
+{
+    QStringList imagePaths = m_imagePaths;
+    clear();
+    append(imagePaths);
+}
+
+void AnnotationIndex::clear()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_results.reset(new Results);
+
+    m_imagePaths.clear();
+    m_ranges.clear();
+    m_boxes.clear();
+    m_garbageBoxes = 0;
+    m_pending = 0;
+    m_annotatedImages = 0;
+    m_totalBoxes = 0;
+    m_classBoxes.clear();
+    m_classImages.clear();
+    emit changed();
+}
+
+bool AnnotationIndex::containsClass(int image, int classId) const
+{
+    const Box *box = boxes(image);
+    for (int i = boxCount(image); i > 0; --i, ++box) {
+        if (box->classId == classId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AnnotationIndex::setBoxes(int image, const QList<BoundingBox> &boxes, int imageWidth, int imageHeight)
+{
+    if (image < 0 || image >= m_ranges.size() || imageWidth <= 0 || imageHeight <= 0) {
+        return;
+    }
+
+    QVector<Box> compact;
+    compact.reserve(boxes.size());
+    for (const BoundingBox &boundingBox : boxes) {
+        double xCenter, yCenter, width, height;
+        boundingBox.toYoloFormat(imageWidth, imageHeight, xCenter, yCenter, width, height);
+        Box box;
+        box.classId = boundingBox.classId();
+        box.xCenter = static_cast<float>(xCenter);
+        box.yCenter = static_cast<float>(yCenter);
+        box.width = static_cast<float>(width);
+        box.height = static_cast<float>(height);
+        compact.append(box);
+    }
+
+    resolvePending(image);
+    assign(image, compact.constData(), compact.size());
+    emit changed();
+    if (m_pending == 0) {
+        emit loaded();
+    }
+}
+
+int AnnotationIndex::boxesOfClass(int classId) const
+{
+    return m_classBoxes.value(classId);
+}
+
+int AnnotationIndex::imagesWithClass(int classId) const
+{
+    return m_classImages.value(classId);
+}
+
+void AnnotationIndex::load(int firstImage, int count)
+{
+    for (int offset = 0; offset < count; offset += ChunkSize) {
+        QSharedPointer<Chunk> chunk(new Chunk);
+        chunk->firstImage = firstImage + offset;
+        chunk->imagePaths = m_imagePaths.mid(chunk->firstImage, qMin(ChunkSize, count - offset));
+        m_pool.start(new LoadTask(this, chunk, m_labelsDirectory, m_store, m_results,
+                                  &m_generation, m_generation.load()));
+    }
+}
+
+void AnnotationIndex::loadPending()
+{
+    int image = 0;
+    while (image < m_ranges.size()) {
+        if (m_ranges[image].count != Pending) {
+            image++;
+            continue;
+        }
+        int end = image + 1;
+        while (end < m_ranges.size() && m_ranges[end].count == Pending) {
+            end++;
+        }
+        load(image, end - image);
+        image = end;
+    }
+}
+
+void AnnotationIndex::resolvePending(int image)
+{
+    if (m_ranges[image].count == Pending) {
+        m_ranges[image].count = NotAnnotated;
+        m_pending--;
+    }
+}
+
+void AnnotationIndex::onChunkLoaded(int generation)
+{
+    if (generation != m_generation.load()) {
+        return;
+    }
+
+    QVector<QSharedPointer<Chunk> > chunks;
+    {
+        QMutexLocker locker(&m_results->mutex);
+        chunks.swap(m_results->chunks);
+    }
+    if (chunks.isEmpty()) {
+        return;
+    }
+
+    for (const QSharedPointer<Chunk> &chunk : chunks) {
+        const Box *boxes = chunk->boxes.constData();
+        for (int i = 0; i < chunk->boxCounts.size(); ++i) {
+            int image = chunk->firstImage + i;
+            int count = chunk->boxCounts[i];
+            // Boxes saved while the chunk was loading are newer
+            if (m_ranges[image].count == Pending) {
+                resolvePending(image);
+                if (count >= 0) {
+                    assign(image, boxes, count);
+                }
+            }
+            boxes += qMax(0, count);
+        }
+    }
+
+    emit changed();
+    if (m_pending == 0) {
+        emit loaded();
+    }
+}
+
+void AnnotationIndex::assign(int image, const Box *boxes, int count)
+{
+    account(image, -1);
+    m_garbageBoxes += boxCount(image);
+
+    Range &range = m_ranges[image];
+    range.first = m_boxes.size();
+    range.count = count;
+    m_boxes.reserve(m_boxes.size() + count);
+    for (int i = 0; i < count; ++i) {
+        m_boxes.append(boxes[i]);
+    }
+    account(image, 1);
+
+    if (m_garbageBoxes >= MinCompactGarbage && m_garbageBoxes > m_boxes.size() / 2) {
+        compact();
+    }
+}
+
+void AnnotationIndex::account(int image, int sign)
+{
+    const Range &range = m_ranges[image];
+    if (range.count < 0) {
+        return;
+    }
+    m_annotatedImages += sign;
+    m_totalBoxes += sign * range.count;
+
+    const Box *boxes = m_boxes.constData() + range.first;
+    for (int i = 0; i < range.count; ++i) {
+        int classId = boxes[i].classId;
+        if (classId < 0) {
+            continue;
+        }
+        m_classBoxes[classId] += sign;
+
+        // An image counts once per class, at the first box of that class
+        bool seen = false;
+        for (int j = 0; j < i && !seen; ++j) {
+            seen = boxes[j].classId == classId;
+        }
+        if (!seen) {
+            m_classImages[classId] += sign;
+        }
+    }
+}
+
+void AnnotationIndex::compact()
+{
+    QVector<Box> boxes;
+    boxes.reserve(m_boxes.size() - m_garbageBoxes);
+    for (Range &range : m_ranges) {
+        int first = boxes.size();
+        for (int i = 0; i < range.count; ++i) {
+            boxes.append(m_boxes[range.first + i]);
+        }
+        range.first = first;
+    }
+    m_boxes.swap(boxes);
+    m_garbageBoxes = 0;
+}
@@ -0,0 +1,139 @@
+#ifndef ANNOTATIONINDEX_H
+#define ANNOTATIONINDEX_H
+
+#include "AnnotationStore.h"
+#include "BoundingBox.h"
+#include <QObject>
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+/**
+ * @brief The boxes of every image in the queue, held in memory
+ *
+ * Images are addressed by their queue index. Each has a range into one
+ * flat array of compact boxes (class id plus four floats), so a dataset
+ * of a million boxes takes about 20 MB and counting, filtering by class
+ * or stepping to the next image with a class never touches the disk.
+ *
+ * append() loads the label files of new images on a pool, in chunks, from
+ * the labels folder or from an AnnotationStore. Results are merged in the
+ * GUI thread; images whose chunk has not arrived yet count as not
+ * annotated. setBoxes() keeps the index current as annotations are saved.
+ * Replaced boxes stay in the array until they make up half of it.
+ */
+class AnnotationIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Box {
+        qint32 classId;
+        float xCenter;      // Normalized, as in the label file
+        float yCenter;
+        float width;
+        float height;
+    };
+
+    // Images loaded by one worker task
+    struct Chunk {
+        int firstImage;
+        QStringList imagePaths;
+        QVector<qint32> boxCounts;  // Per image, -1 if it has no label file
+        QVector<Box> boxes;
+    };
+
+    // Filled by the workers of one generation; replaced when it is dropped
+    struct Results {
+        QMutex mutex;
+        QVector<QSharedPointer<Chunk> > chunks;
+    };
+
+    explicit AnnotationIndex(QObject *parent = nullptr);
+    ~AnnotationIndex();
+
+    // Where label files are read from; store replaces labelsDirectory if set.
+    // Drops all images.
+    void setSource(const QString &labelsDirectory, const QSharedPointer<AnnotationStore> &store);
+
+    // Add images to the end of the queue and load their annotations
+    void append(const QStringList &imagePaths);
+
+    // Drop the images at the given (ascending) queue indexes
+    void removeIndexes(const QVector<int> &indexes);
+
+    // The image at a queue index was renamed; its labels are looked up again
+    // under the new name
+    void renameImage(int image, const QString &imagePath);
+
+    // Load every image again, e.g. after the source changed
+    void reload();
+    void clear();
+
+    int count() const { return m_ranges.size(); }
+    bool isLoading() const { return m_pending > 0; }
+
+    // An image is annotated once a label file (or store record) exists,
+    // even with no boxes in it
+    bool isLoaded(int image) const { return m_ranges[image].count != Pending; }
+    bool isAnnotated(int image) const { return m_ranges[image].count >= 0; }
+    int boxCount(int image) const { return qMax(0, m_ranges[image].count); }
+    const Box *boxes(int image) const { return m_boxes.constData() + m_ranges[image].first; }
+    bool containsClass(int image, int classId) const;
+
+    // Record boxes just saved for an image
+    void setBoxes(int image, const QList<BoundingBox> &boxes, int imageWidth, int imageHeight);
+
+    // Dataset statistics
+    int annotatedImages() const { return m_annotatedImages; }
+    int totalBoxes() const { return m_totalBoxes; }
+    int boxesOfClass(int classId) const;
+    int imagesWithClass(int classId) const;
+
+signals:
+    // Statistics changed (chunks merged or boxes set)
+    void changed();
+    // All images appended so far are loaded
+    void loaded();
+
+private slots:
+    void onChunkLoaded(int generation);
+
+private:
+    enum { Pending = -2, NotAnnotated = -1 };
+
+    struct Range {
+        qint32 first;
+        qint32 count;           // Box count, or Pending / NotAnnotated
+    };
+
+    void load(int firstImage, int count);
+    void loadPending();
+    void resolvePending(int image);
+    void assign(int image, const Box *boxes, int count);
+    void account(int image, int sign);
+    void compact();
+
+    QThreadPool m_pool;
+    QAtomicInt m_generation;    // Bumped to drop chunks still loading
+    QSharedPointer<Results> m_results;
+    QString m_labelsDirectory;
+    QSharedPointer<AnnotationStore> m_store;
+
+    QStringList m_imagePaths;
+    QVector<Range> m_ranges;    // Per image
+    QVector<Box> m_boxes;       // Ranges point into this
+    int m_garbageBoxes;         // Boxes no range points to
+    int m_pending;              // Images whose chunk has not been merged
+    int m_annotatedImages;
+    int m_totalBoxes;
+    QHash<int, int> m_classBoxes;    // Class id -> boxes; ids are read from files, so not an array
+    QHash<int, int> m_classImages;   // Class id -> images with a box of it
+};
+
+#endif // ANNOTATIONINDEX_H
@@ -4,20 +4,266 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QDebug>
+#include <QSettings>
+#include <QMetaObject>
+#include <QRunnable>
+#include <QTemporaryFile>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <io.h>
+#elif defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int MaxUnsyncedFiles = 32;
+
+// Atomically replace path with tempPath
+bool replaceFile(const QString &tempPath, const QString &path)
+{
+#if defined(Q_OS_WIN)
+    return MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(tempPath).utf16()),
+                       reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(path).utf16()),
+                       MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return ::rename(QFile::encodeName(tempPath).constData(), QFile::encodeName(path).constData()) == 0;
+#endif
+}
+
+bool syncFile(QFile &file)
+{
+#if defined(Q_OS_WIN)
+    return _commit(file.handle()) == 0;
+#elif defined(Q_OS_UNIX)
+    return ::fsync(file.handle()) == 0;
+#else
+    Q_UNUSED(file);
+    return true;
+#endif
+}
+
+bool syncDirectory(const QString &path)
+{
+#if defined(Q_OS_UNIX)
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#else
+    // Directory entries are not flushed separately on Windows
+    Q_UNUSED(path);
+    return true;
+#endif
+}
+
+// Places one image into the images folder, skipping or hardlinking it if
+// the same content is already there. contentStore is null when duplicates
+// are placed like any file.
+void placeImage(const QString &imagePath, const QString &destinationPath,
+                FilePlacement::Strategy strategy, ContentStore *contentStore)
+{
+    // Don't copy if already exists
+    if (QFile::exists(destinationPath)) {
+        return;
+    }
+    
+    ContentStore::Content content;
+    if (contentStore) {
+        QString existing = contentStore->claim(imagePath, destinationPath, &content);
+        if (!existing.isEmpty()) {
+            // Same image under another name; the label file pairs by name,
+            // so it still needs an entry of its own
+            FilePlacement::Strategy used = FilePlacement::Copy;
+            if (FilePlacement::place(existing, destinationPath, FilePlacement::Hardlink, &used)) {
+                contentStore->add(destinationPath, content);
+                if (used != FilePlacement::Copy) {
+                    contentStore->countLinked(content.size);
+                }
+                return;
+            }
+            contentStore->add(destinationPath, content);
+        }
+    }
+    
+    // Hardlink/reflink/move avoid duplicating the image data where possible
+    if (!FilePlacement::place(imagePath, destinationPath, strategy)) {
+        qWarning() << "Failed to place" << imagePath << "in the output folder";
+        if (contentStore) {
+            contentStore->forget(destinationPath);
+        }
+    }
+}
+
+class PlaceImageTask : public QRunnable
+{
+public:
+    PlaceImageTask(const QString &imagePath, const QString &destinationPath,
+                   FilePlacement::Strategy strategy, ContentStore *contentStore)
+        : m_imagePath(imagePath), m_destinationPath(destinationPath),
+          m_strategy(strategy), m_contentStore(contentStore)
+    {
+    }
+
+    void run() override
+    {
+        placeImage(m_imagePath, m_destinationPath, m_strategy, m_contentStore);
+    }
+
+private:
+    QString m_imagePath;
+    QString m_destinationPath;
+    FilePlacement::Strategy m_strategy;
+    ContentStore *m_contentStore;
+};
+
+// Writes the boxes of a batch of images and places the images; the labels
+// folder is synced once for the whole batch
+class SaveAnnotationsTask : public QRunnable
+{
+public:
+    SaveAnnotationsTask(const QVector<AnnotationManager::PendingAnnotation> &annotations,
+                        const QString &outputDirectory, const QSharedPointer<AnnotationStore> &store,
+                        FilePlacement::Strategy strategy, ContentStore *contentStore,
+                        QObject *receiver, const char *member)
+        : m_annotations(annotations), m_outputDirectory(outputDirectory), m_store(store),
+          m_strategy(strategy), m_contentStore(contentStore), m_receiver(receiver), m_member(member)
+    {
+    }
+
+    void run() override
+    {
+        QStringList saved;
+        QStringList failed;
+        YoloLabelWriter writer;
+        QVector<YoloLabelParser::Box> packed;
+        for (const AnnotationManager::PendingAnnotation &annotation : m_annotations) {
+            QFileInfo imageInfo(annotation.imagePath);
+            QString labelFileName = AnnotationManager::labelFileName(annotation.imagePath);
+            int width = annotation.imageSize.width();
+            int height = annotation.imageSize.height();
+            
+            bool written;
+            if (m_store) {
+                packed.clear();
+                for (const BoundingBox &box : annotation.boxes) {
+                    YoloLabelParser::Box yolo;
+                    yolo.classId = box.classId();
+                    box.toYoloFormat(width, height, yolo.xCenter, yolo.yCenter, yolo.width, yolo.height);
+                    packed.append(yolo);
+                }
+                written = m_store->put(labelFileName, packed);
+            } else {
+                writer.clear();
+                for (const BoundingBox &box : annotation.boxes) {
+                    double xCenter, yCenter, boxWidth, boxHeight;
+                    box.toYoloFormat(width, height, xCenter, yCenter, boxWidth, boxHeight);
+                    writer.appendBox(box.classId(), xCenter, yCenter, boxWidth, boxHeight);
+                }
+                written = AnnotationManager::writeFileAtomically(
+                    m_outputDirectory + "/labels/" + labelFileName, writer.data());
+            }
+            if (!written) {
+                failed.append(annotation.imagePath);
+                continue;
+            }
+            
+            placeImage(annotation.imagePath, m_outputDirectory + "/images/" + imageInfo.fileName(),
+                       m_strategy, m_contentStore);
+            saved.append(annotation.imagePath);
+        }
+        
+        if (m_store) {
+            m_store->sync();
+        } else if (!saved.isEmpty()) {
+            syncDirectory(m_outputDirectory + "/labels");
+        }
+        QMetaObject::invokeMethod(m_receiver, m_member, Qt::QueuedConnection,
+                                  Q_ARG(QStringList, saved),
+                                  Q_ARG(QStringList, failed));
+    }
+
+private:
+    QVector<AnnotationManager::PendingAnnotation> m_annotations;
+    QString m_outputDirectory;
+    QSharedPointer<AnnotationStore> m_store;   // Null for the LabelFiles backend
+    FilePlacement::Strategy m_strategy;
+    ContentStore *m_contentStore;
+    QObject *m_receiver;
+    const char *m_member;
+};
+
+} // namespace
 
 AnnotationManager::AnnotationManager()
-    : m_outputDirectory("annotated_images"), m_nextClassId(0)
+    : m_outputDirectory("annotated_images"), m_nextClassId(0), m_labelsDirty(false), m_unsyncedFiles(0),
+      m_placementStrategy(FilePlacement::Copy), m_deduplicate(true), m_backend(LabelFiles)
+{
+}
+
+AnnotationManager::~AnnotationManager()
 {
+    m_placementPool.waitForDone();
+    sync();
 }
 
 void AnnotationManager::setOutputDirectory(const QString &directory)
 {
+    if (directory != m_outputDirectory) {
+        // Placements still queued belong to the old folder
+        m_placementPool.waitForDone();
+        m_contentStore.clear();
+        // The new folder needs its own classes.txt
+        m_labelsDirty = !m_labelToId.isEmpty();
+    }
     m_outputDirectory = directory;
     
     // Create directory structure
     QDir dir;
     dir.mkpath(m_outputDirectory + "/images");
     dir.mkpath(m_outputDirectory + "/labels");
+    
+    if (m_backend == PackedStore && (!m_store || m_store->filePath() != m_outputDirectory + "/annotations.pack")) {
+        openStore();
+    }
+}
+
+bool AnnotationManager::setStorageBackend(StorageBackend backend)
+{
+    m_backend = backend;
+    if (backend == LabelFiles || m_outputDirectory.isEmpty()) {
+        m_store.clear();
+        return true;
+    }
+    return openStore();
+}
+
+bool AnnotationManager::openStore()
+{
+    QSharedPointer<AnnotationStore> store(new AnnotationStore(m_outputDirectory + "/annotations.pack"));
+    if (!store->open()) {
+        qWarning() << "Failed to open annotation store:" << store->filePath();
+        m_store.clear();
+        return false;
+    }
+    m_store = store;
+    return true;
+}
+
+AnnotationManager::StorageBackend AnnotationManager::savedStorageBackend()
+{
+    return QSettings().value("annotations/backend").toString() == "packed" ? PackedStore : LabelFiles;
+}
+
+void AnnotationManager::saveStorageBackend(StorageBackend backend)
+{
+    QSettings().setValue("annotations/backend", backend == PackedStore ? "packed" : "files");
 }
 
 void AnnotationManager::addLabel(const QString &label)
@@ -26,6 +272,7 @@ void AnnotationManager::addLabel(const QString &label)
         m_labelToId[label] = m_nextClassId;
         m_idToLabel[m_nextClassId] = label;
         m_nextClassId++;
+        m_labelsDirty = true;
     }
 }
 
@@ -35,6 +282,7 @@ void AnnotationManager::removeLabel(const QString &label)
         int classId = m_labelToId[label];
         m_labelToId.remove(label);
         m_idToLabel.remove(classId);
+        m_labelsDirty = true;
     }
 }
 
@@ -61,14 +309,8 @@ bool AnnotationManager::hasLabel(const QString &label) const
 bool AnnotationManager::saveClassesFile()
 {
     QString classesFilePath = m_outputDirectory + "/classes.txt";
-    QFile file(classesFilePath);
-    
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        qWarning() << "Failed to open classes file for writing:" << classesFilePath;
-        return false;
-    }
-    
-    QTextStream out(&file);
+    QByteArray data;
+    QTextStream out(&data, QIODevice::WriteOnly);
     
     // Write labels in order of class ID
     for (int i = 0; i < m_nextClassId; ++i) {
@@ -76,8 +318,13 @@ bool AnnotationManager::saveClassesFile()
             out << m_idToLabel[i] << "\n";
         }
     }
+    out.flush();
     
-    file.close();
+    if (!writeFile(classesFilePath, data)) {
+        qWarning() << "Failed to write classes file:" << classesFilePath;
+        return false;
+    }
+    m_labelsDirty = false;
     return true;
 }
 
@@ -105,6 +352,7 @@ bool AnnotationManager::loadClassesFile()
     }
     
     file.close();
+    m_labelsDirty = false;
     return true;
 }
 
@@ -112,33 +360,48 @@ bool AnnotationManager::saveAnnotations(const QString &imagePath,
                                         const QList<BoundingBox> &boxes,
                                         int imageWidth, int imageHeight)
 {
-    QString annotationPath = getAnnotationFilePath(imagePath);
-    QFile file(annotationPath);
-    
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        qWarning() << "Failed to open annotation file for writing:" << annotationPath;
-        return false;
+    if (m_backend == PackedStore) {
+        if (!m_store) {
+            return false;
+        }
+        m_parsedBoxes.clear();
+        for (const BoundingBox &box : boxes) {
+            YoloLabelParser::Box packed;
+            packed.classId = box.classId();
+            box.toYoloFormat(imageWidth, imageHeight, packed.xCenter, packed.yCenter, packed.width, packed.height);
+            m_parsedBoxes.append(packed);
+        }
+        if (!m_store->put(labelFileName(imagePath), m_parsedBoxes)) {
+            qWarning() << "Failed to append annotations to" << m_store->filePath();
+            return false;
+        }
+        if (m_labelsDirty) {
+            saveClassesFile();
+        }
+        return true;
     }
     
-    QTextStream out(&file);
+    QString annotationPath = getAnnotationFilePath(imagePath);
     
-    // Write each bounding box in YOLO format
+    // Formatted into one reused buffer; same bytes as QString::number(v, 'f', 6)
+    m_labelWriter.clear();
     for (const BoundingBox &box : boxes) {
         double xCenter, yCenter, width, height;
         box.toYoloFormat(imageWidth, imageHeight, xCenter, yCenter, width, height);
         
         // Format: <class_id> <x_center> <y_center> <width> <height>
-        out << box.classId() << " "
-            << QString::number(xCenter, 'f', 6) << " "
-            << QString::number(yCenter, 'f', 6) << " "
-            << QString::number(width, 'f', 6) << " "
-            << QString::number(height, 'f', 6) << "\n";
+        m_labelWriter.appendBox(box.classId(), xCenter, yCenter, width, height);
     }
     
-    file.close();
+    if (!writeFile(annotationPath, m_labelWriter.data())) {
+        qWarning() << "Failed to write annotation file:" << annotationPath;
+        return false;
+    }
     
-    // Also save the classes file
-    saveClassesFile();
+    // Also save the classes file if a label was added or removed
+    if (m_labelsDirty) {
+        saveClassesFile();
+    }
     
     return true;
 }
@@ -147,78 +410,156 @@ bool AnnotationManager::loadAnnotations(const QString &imagePath,
                                         QList<BoundingBox> &boxes,
                                         int imageWidth, int imageHeight)
 {
-    QString annotationPath = getAnnotationFilePath(imagePath);
-    QFile file(annotationPath);
-    
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        // No annotations exist yet - this is not an error
-        return true;
+    m_parsedBoxes.clear();
+    if (m_backend == PackedStore) {
+        if (!m_store || !m_store->get(labelFileName(imagePath), m_parsedBoxes)) {
+            // No annotations exist yet - this is not an error
+            return true;
+        }
+    } else {
+        QString annotationPath = getAnnotationFilePath(imagePath);
+        if (!QFile::exists(annotationPath)) {
+            // No annotations exist yet - this is not an error
+            return true;
+        }
+        
+        // Parsed straight from the mapped file; m_parsedBoxes keeps its capacity
+        YoloLabelParser::Error error;
+        if (!YoloLabelParser::parseFile(annotationPath, m_parsedBoxes, &error, true)) {
+            if (error.line == 0) {
+                // Unreadable file: treated like a missing one, as before
+                return true;
+            }
+            qWarning() << "Invalid annotation line in" << annotationPath
+                       << QString("(line %1, column %2): %3").arg(error.line).arg(error.column).arg(error.message);
+        }
     }
     
     boxes.clear();
-    QTextStream in(&file);
-    
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-        if (line.isEmpty()) continue;
-        
-        QStringList parts = line.split(' ', Qt::SkipEmptyParts);
-        if (parts.size() != 5) {
-            qWarning() << "Invalid annotation line:" << line;
-            continue;
-        }
-        
-        bool ok;
-        int classId = parts[0].toInt(&ok);
-        if (!ok) continue;
-        
-        double xCenter = parts[1].toDouble(&ok);
-        if (!ok) continue;
-        
-        double yCenter = parts[2].toDouble(&ok);
-        if (!ok) continue;
-        
-        double width = parts[3].toDouble(&ok);
-        if (!ok) continue;
-        
-        double height = parts[4].toDouble(&ok);
-        if (!ok) continue;
-        
-        QString label = getLabel(classId);
+    boxes.reserve(m_parsedBoxes.size());
+    for (const YoloLabelParser::Box &parsed : m_parsedBoxes) {
+        QString label = getLabel(parsed.classId);
         BoundingBox box = BoundingBox::fromYoloFormat(
-            xCenter, yCenter, width, height,
-            imageWidth, imageHeight, label, classId);
+            parsed.xCenter, parsed.yCenter, parsed.width, parsed.height,
+            imageWidth, imageHeight, label, parsed.classId);
         
         boxes.append(box);
     }
     
+    return true;
+}
+
+bool AnnotationManager::writeFile(const QString &path, const QByteArray &data)
+{
+    if (!writeFileAtomically(path, data)) {
+        return false;
+    }
+    
+    QString directory = QFileInfo(path).absolutePath();
+    if (!m_unsynced.contains(directory)) {
+        m_unsynced.append(directory);
+    }
+    if (++m_unsyncedFiles >= MaxUnsyncedFiles) {
+        sync();
+    }
+    return true;
+}
+
+bool AnnotationManager::writeFileAtomically(const QString &path, const QByteArray &data)
+{
+    // Written next to the target so the rename stays on one filesystem; the
+    // name is unique, so concurrent writers of one path never share it
+    QTemporaryFile file(path + ".XXXXXX.tmp");
+    file.setAutoRemove(false);
+    if (!file.open()) {
+        return false;
+    }
+    file.setTextModeEnabled(true);
+    QString tempPath = file.fileName();
+    // Temporary files are created private; label files are not
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner |
+                        QFileDevice::ReadGroup | QFileDevice::ReadOther);
+    // The data must be on disk before the rename can make it the only copy
+    if (file.write(data) != data.size() || !file.flush() || !syncFile(file)) {
+        file.close();
+        QFile::remove(tempPath);
+        return false;
+    }
     file.close();
+    
+    if (!replaceFile(tempPath, path)) {
+        QFile::remove(tempPath);
+        return false;
+    }
     return true;
 }
 
+bool AnnotationManager::sync()
+{
+    bool synced = true;
+    if (m_store) {
+        synced = m_store->sync();
+    }
+    if (m_unsynced.isEmpty()) {
+        return synced;
+    }
+    
+    // The file contents were synced before their renames; the renames
+    // themselves live in the directories
+    for (const QString &directory : m_unsynced) {
+        synced = syncDirectory(directory) && synced;
+    }
+    
+    m_unsynced.clear();
+    m_unsyncedFiles = 0;
+    return synced;
+}
+
 bool AnnotationManager::hasAnnotations(const QString &imagePath) const
 {
+    if (m_backend == PackedStore) {
+        return m_store && m_store->contains(labelFileName(imagePath));
+    }
     QString annotationPath = getAnnotationFilePath(imagePath);
     return QFile::exists(annotationPath);
 }
 
 QString AnnotationManager::getAnnotationFilePath(const QString &imagePath) const
 {
-    QString fileName = getAnnotationFileName(imagePath);
+    QString fileName = labelFileName(imagePath);
     return m_outputDirectory + "/labels/" + fileName;
 }
 
-bool AnnotationManager::copyImageToOutput(const QString &imagePath)
+void AnnotationManager::copyImageToOutput(const QString &imagePath)
 {
-    QString fileName = getImageFileName(imagePath);
-    QString destPath = m_outputDirectory + "/images/" + fileName;
-    
-    // Don't copy if already exists
-    if (QFile::exists(destPath)) {
-        return true;
+    QString destPath = m_outputDirectory + "/images/" + getImageFileName(imagePath);
+    m_placementPool.start(new PlaceImageTask(imagePath, destPath, m_placementStrategy,
+                                             m_deduplicate ? &m_contentStore : nullptr));
+}
+
+void AnnotationManager::saveAnnotationsInBackground(const QVector<PendingAnnotation> &annotations,
+                                                    QObject *receiver, const char *member)
+{
+    if (m_labelsDirty) {
+        saveClassesFile();
     }
-    
-    return QFile::copy(imagePath, destPath);
+    QSharedPointer<AnnotationStore> store;
+    if (m_backend == PackedStore) {
+        if (!m_store) {
+            QStringList failed;
+            for (const PendingAnnotation &annotation : annotations) {
+                failed.append(annotation.imagePath);
+            }
+            QMetaObject::invokeMethod(receiver, member, Qt::QueuedConnection,
+                                      Q_ARG(QStringList, QStringList()),
+                                      Q_ARG(QStringList, failed));
+            return;
+        }
+        store = m_store;
+    }
+    m_placementPool.start(new SaveAnnotationsTask(annotations, m_outputDirectory, store, m_placementStrategy,
+                                                  m_deduplicate ? &m_contentStore : nullptr,
+                                                  receiver, member));
 }
 
 QString AnnotationManager::getImageFileName(const QString &imagePath) const
@@ -226,9 +567,8 @@ QString AnnotationManager::getImageFileName(const QString &imagePath) const
     return QFileInfo(imagePath).fileName();
 }
 
-QString AnnotationManager::getAnnotationFileName(const QString &imagePath) const
+QString AnnotationManager::labelFileName(const QString &imagePath)
 {
-    QFileInfo fileInfo(imagePath);
-    return fileInfo.baseName() + ".txt";
+    return QFileInfo(imagePath).baseName() + ".txt";
 }
 
@@ -2,9 +2,19 @@
 #define ANNOTATIONMANAGER_H
 
 #include "BoundingBox.h"
+#include "FilePlacement.h"
+#include "ContentStore.h"
+#include "YoloLabelParser.h"
+#include "YoloLabelWriter.h"
+#include "AnnotationStore.h"
+#include <QSharedPointer>
+#include <QSize>
+#include <QThreadPool>
 #include <QString>
 #include <QList>
+#include <QVector>
 #include <QMap>
+#include <QStringList>
 
 /**
  * @brief Manages saving and loading of object detection annotations
@@ -13,11 +23,34 @@
  * - One .txt file per image with bounding box annotations
  * - classes.txt file with label names
  * - Format: <class_id> <x_center> <y_center> <width> <height> (normalized 0-1)
+ *
+ * Files are written to a temporary file and renamed over the old one, so
+ * an interrupted save never leaves a truncated file behind. Each temporary
+ * file is fsync'ed before the rename; only the directory entries of the
+ * renames are flushed in groups by sync(). classes.txt is only rewritten
+ * when the labels have changed.
+ *
+ * With the PackedStore backend the boxes of all images go into a single
+ * AnnotationStore file in the output folder instead; AnnotationExporter
+ * turns it into the labels/<image>.txt files when needed.
  */
 class AnnotationManager
 {
 public:
+    enum StorageBackend {
+        LabelFiles,     // labels/<image>.txt per image
+        PackedStore     // annotations.pack for the whole output folder
+    };
+    
+    // Boxes of one image for saveAnnotationsInBackground()
+    struct PendingAnnotation {
+        QString imagePath;
+        QList<BoundingBox> boxes;   // Class ids already assigned
+        QSize imageSize;
+    };
+    
     AnnotationManager();
+    ~AnnotationManager();
     
     // Set the output directory for annotations
     void setOutputDirectory(const QString &directory);
@@ -34,34 +67,92 @@ public:
     // Save/load classes.txt file
     bool saveClassesFile();
     bool loadClassesFile();
+    bool labelsDirty() const { return m_labelsDirty; }
     
     // Save/load annotations for a specific image
     bool saveAnnotations(const QString &imagePath, 
                         const QList<BoundingBox> &boxes,
                         int imageWidth, int imageHeight);
     
+    // Save the boxes of several images and place the images on the
+    // placement pool. classes.txt is saved first if the labels changed.
+    // When the batch is done, member of receiver is invoked queued with the
+    // image paths saved and those that failed (two QStringLists). receiver
+    // must outlive this manager.
+    void saveAnnotationsInBackground(const QVector<PendingAnnotation> &annotations,
+                                     QObject *receiver, const char *member);
+    
     bool loadAnnotations(const QString &imagePath,
                         QList<BoundingBox> &boxes,
                         int imageWidth, int imageHeight);
     
+    // Where boxes are saved and loaded from. Switching does not convert
+    // existing annotations; use AnnotationExporter for PackedStore -> files.
+    bool setStorageBackend(StorageBackend backend);
+    StorageBackend storageBackend() const { return m_backend; }
+    QSharedPointer<AnnotationStore> store() const { return m_store; }
+    
+    // Backend stored in the "annotations/backend" setting (LabelFiles by default)
+    static StorageBackend savedStorageBackend();
+    static void saveStorageBackend(StorageBackend backend);
+    
+    // Replace path with data through a temporary file that is fsync'ed and
+    // then renamed; the directory itself is not synced
+    static bool writeFileAtomically(const QString &path, const QByteArray &data);
+    
+    // Name of the label file (and store key) of an image: its base name
+    // with a .txt suffix. Everything that looks up labels goes through this.
+    static QString labelFileName(const QString &imagePath);
+    
+    // Force the renames of files written since the last sync to disk. Also
+    // happens automatically every few dozen files and on destruction.
+    bool sync();
+    
     // Check if annotations exist for an image
     bool hasAnnotations(const QString &imagePath) const;
     
     // Get annotation file path for an image
     QString getAnnotationFilePath(const QString &imagePath) const;
     
-    // Copy image to output directory
-    bool copyImageToOutput(const QString &imagePath);
+    // Copy image to output directory. Placing (and hashing, if a file of
+    // the same size is already there) runs on a background thread.
+    void copyImageToOutput(const QString &imagePath);
+    
+    // Block until all queued copyImageToOutput() and
+    // saveAnnotationsInBackground() calls are done
+    void waitForPlacements() { m_placementPool.waitForDone(); }
+    
+    // How copyImageToOutput() places images (Copy by default)
+    void setPlacementStrategy(FilePlacement::Strategy strategy) { m_placementStrategy = strategy; }
+    FilePlacement::Strategy placementStrategy() const { return m_placementStrategy; }
+    
+    // Hardlink images whose content is already in the output folder under
+    // another name instead of copying them again (on by default)
+    void setDeduplicate(bool enabled) { m_deduplicate = enabled; }
+    bool deduplicate() const { return m_deduplicate; }
+    const ContentStore &contentStore() const { return m_contentStore; }
     
 private:
     QString m_outputDirectory;
     QMap<QString, int> m_labelToId;  // Map label name to class ID
     QMap<int, QString> m_idToLabel;  // Map class ID to label name
     int m_nextClassId;
+    bool m_labelsDirty;              // classes.txt does not match the labels
+    QStringList m_unsynced;          // Directories with renames not fsync'ed yet
+    int m_unsyncedFiles;             // Files renamed since the last sync()
+    FilePlacement::Strategy m_placementStrategy;
+    bool m_deduplicate;
+    ContentStore m_contentStore;     // Content of the images folder
+    QThreadPool m_placementPool;     // Runs copyImageToOutput() and saveAnnotationsInBackground()
+    QVector<YoloLabelParser::Box> m_parsedBoxes;  // Reused by loadAnnotations()
+    YoloLabelWriter m_labelWriter;                // Reused by saveAnnotations()
+    StorageBackend m_backend;
+    QSharedPointer<AnnotationStore> m_store;      // Open while m_backend is PackedStore
     
     // Helper methods
     QString getImageFileName(const QString &imagePath) const;
-    QString getAnnotationFileName(const QString &imagePath) const;
+    bool writeFile(const QString &path, const QByteArray &data);
+    bool openStore();
 };
 
 #endif // ANNOTATIONMANAGER_H
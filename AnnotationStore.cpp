@@ -0,0 +1,158 @@
+#include "AnnotationStore.h"
+#include <QMutexLocker>
+#include <cstring>
+
+namespace {
+
+const quint32 StoreMagic = 0x414e4e50;   // "ANNP"
+const quint32 RecordMagic = 0x414e4e52;  // "ANNR"
+const quint32 IndexMagic = 0x414e4e49;   // "ANNI"
+const quint32 StoreVersion = 1;
+
+// Written in host byte order, like the thumbnail pack
+struct RecordHeader {
+    quint32 magic;
+    quint16 keyLength;
+    quint16 reserved;
+    quint32 boxCount;
+    quint32 reserved2;
+};
+
+struct BoxRecord {
+    qint32 classId;
+    qint32 reserved;
+    double xCenter;
+    double yCenter;
+    double width;
+    double height;
+};
+
+qint64 recordLength(const uchar *data)
+{
+    RecordHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    return static_cast<qint64>(sizeof(header)) + header.keyLength +
+           static_cast<qint64>(header.boxCount) * sizeof(BoxRecord);
+}
+
+const RecordPack::Format StoreFormat = {
+    StoreMagic, RecordMagic, IndexMagic, StoreVersion, sizeof(RecordHeader), recordLength
+};
+
+} // namespace
+
+AnnotationStore::AnnotationStore(const QString &filePath)
+    : m_pack(filePath, StoreFormat)
+{
+}
+
+AnnotationStore::~AnnotationStore()
+{
+    close();
+}
+
+bool AnnotationStore::open()
+{
+    QMutexLocker locker(&m_mutex);
+    // Annotations are user data: never overwrite a file we do not understand
+    return m_pack.open(false);
+}
+
+void AnnotationStore::close()
+{
+    QMutexLocker locker(&m_mutex);
+    m_pack.close();
+}
+
+bool AnnotationStore::put(const QString &key, const QVector<YoloLabelParser::Box> &boxes)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QByteArray keyBytes = key.toUtf8();
+    RecordHeader header;
+    header.magic = RecordMagic;
+    header.keyLength = static_cast<quint16>(keyBytes.size());
+    header.reserved = 0;
+    header.boxCount = static_cast<quint32>(boxes.size());
+    header.reserved2 = 0;
+
+    // One write per record
+    QByteArray record;
+    record.reserve(static_cast<int>(sizeof(header)) + keyBytes.size() + boxes.size() * static_cast<int>(sizeof(BoxRecord)));
+    record.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    record.append(keyBytes);
+    for (const YoloLabelParser::Box &box : boxes) {
+        BoxRecord packed;
+        packed.classId = box.classId;
+        packed.reserved = 0;
+        packed.xCenter = box.xCenter;
+        packed.yCenter = box.yCenter;
+        packed.width = box.width;
+        packed.height = box.height;
+        record.append(reinterpret_cast<const char *>(&packed), sizeof(packed));
+    }
+    return m_pack.append(key, record);
+}
+
+bool AnnotationStore::get(const QString &key, QVector<YoloLabelParser::Box> &boxes) const
+{
+    QMutexLocker locker(&m_mutex);
+    quint32 length = 0;
+    const uchar *record = m_pack.record(key, &length);
+    if (!record) {
+        return false;
+    }
+
+    RecordHeader header;
+    std::memcpy(&header, record, sizeof(header));
+    const uchar *data = record + length - static_cast<qint64>(header.boxCount) * sizeof(BoxRecord);
+    boxes.reserve(boxes.size() + static_cast<int>(header.boxCount));
+    for (quint32 i = 0; i < header.boxCount; ++i) {
+        BoxRecord packed;
+        std::memcpy(&packed, data + i * sizeof(BoxRecord), sizeof(packed));
+        YoloLabelParser::Box box;
+        box.classId = packed.classId;
+        box.xCenter = packed.xCenter;
+        box.yCenter = packed.yCenter;
+        box.width = packed.width;
+        box.height = packed.height;
+        boxes.append(box);
+    }
+    return true;
+}
+
+bool AnnotationStore::contains(const QString &key) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pack.contains(key);
+}
+
+QStringList AnnotationStore::keys() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pack.keys();
+}
+
+int AnnotationStore::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pack.count();
+}
+
+bool AnnotationStore::sync()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pack.sync();
+}
+
+qint64 AnnotationStore::fileSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pack.size();
+}
+
+qint64 AnnotationStore::garbageBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pack.garbageBytes();
+}
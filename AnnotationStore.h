@@ -0,0 +1,56 @@
+#ifndef ANNOTATIONSTORE_H
+#define ANNOTATIONSTORE_H
+
+#include "RecordPack.h"
+#include "YoloLabelParser.h"
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+#include <QVector>
+
+/**
+ * @brief All annotations of an output folder in one append-only file
+ *
+ * An alternative to one labels/<image>.txt per image: each save appends a record
+ * (image key, normalized YOLO boxes) to a single RecordPack, and an in-memory
+ * index maps each key to its latest record. Loading maps the pack and
+ * copies one record out, so both directions are O(1) per image no matter
+ * how many images the folder holds.
+ *
+ * The index is saved next to the pack on close(); records appended after
+ * it (e.g. before a crash) are recovered by scanning, and a record cut
+ * short is dropped. Superseded records stay in the pack as garbage.
+ *
+ * All methods are thread-safe, so exporters can read while the GUI saves.
+ */
+class AnnotationStore
+{
+public:
+    explicit AnnotationStore(const QString &filePath);
+    ~AnnotationStore();
+
+    bool open();
+    void close();
+    QString filePath() const { return m_pack.filePath(); }
+
+    // Replace the boxes of key (an empty list records "no objects")
+    bool put(const QString &key, const QVector<YoloLabelParser::Box> &boxes);
+
+    // Append the boxes of key; false if key was never saved
+    bool get(const QString &key, QVector<YoloLabelParser::Box> &boxes) const;
+    bool contains(const QString &key) const;
+    QStringList keys() const;
+    int count() const;
+
+    // Force appended records to disk
+    bool sync();
+
+    qint64 fileSize() const;
+    qint64 garbageBytes() const;
+
+private:
+    mutable QMutex m_mutex;
+    RecordPack m_pack;
+};
+
+#endif // ANNOTATIONSTORE_H
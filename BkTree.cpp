@@ -0,0 +1,55 @@
+#include "BkTree.h"
+
+void BkTree::insert(quint64 hash, int id)
+{
+    Node node;
+    node.hash = hash;
+    node.id = id;
+
+    if (m_nodes.isEmpty()) {
+        m_nodes.append(node);
+        return;
+    }
+
+    int current = 0;
+    for (;;) {
+        int distance = qPopulationCount(m_nodes[current].hash ^ hash);
+        int next = -1;
+        for (const QPair<int, int> &child : m_nodes[current].children) {
+            if (child.first == distance) {
+                next = child.second;
+                break;
+            }
+        }
+        if (next < 0) {
+            m_nodes.append(node);
+            m_nodes[current].children.append(qMakePair(distance, m_nodes.size() - 1));
+            return;
+        }
+        current = next;
+    }
+}
+
+QVector<int> BkTree::find(quint64 hash, int radius) const
+{
+    QVector<int> result;
+    if (m_nodes.isEmpty()) {
+        return result;
+    }
+
+    QVector<int> pending;
+    pending.append(0);
+    while (!pending.isEmpty()) {
+        const Node &node = m_nodes[pending.takeLast()];
+        int distance = qPopulationCount(node.hash ^ hash);
+        if (distance <= radius) {
+            result.append(node.id);
+        }
+        for (const QPair<int, int> &child : node.children) {
+            if (child.first >= distance - radius && child.first <= distance + radius) {
+                pending.append(child.second);
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,38 @@
+#ifndef BKTREE_H
+#define BKTREE_H
+
+#include <QVector>
+#include <QPair>
+#include <QtGlobal>
+
+/**
+ * @brief Burkhard-Keller tree over 64-bit hashes under Hamming distance
+ *
+ * Finds every stored hash within a radius of a query without comparing
+ * against all of them: the triangle inequality rules out whole subtrees.
+ * Entries cannot be removed; callers ignore ids they no longer use.
+ */
+class BkTree
+{
+public:
+    BkTree() {}
+
+    void insert(quint64 hash, int id);
+
+    // Ids of all hashes at distance <= radius from hash
+    QVector<int> find(quint64 hash, int radius) const;
+
+    int size() const { return m_nodes.size(); }
+    void clear() { m_nodes.clear(); }
+
+private:
+    struct Node {
+        quint64 hash;
+        int id;
+        QVector<QPair<int, int>> children;   // (distance to this node, child node)
+    };
+
+    QVector<Node> m_nodes;                   // m_nodes[0] is the root
+};
+
+#endif // BKTREE_H
@@ -0,0 +1,375 @@
+#include "ClassificationManifest.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QMetaObject>
+#include <QRunnable>
+#include <QSaveFile>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#elif defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int MaxBufferSize = 64 * 1024;
+const int FlushIntervalMs = 1000;
+const int SyncIntervalMs = 5000;
+const char CsvHeader[] = "path,category,timestamp";
+
+bool syncFile(QFile &file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#if defined(Q_OS_WIN)
+    return _commit(file.handle()) == 0;
+#elif defined(Q_OS_UNIX)
+    return ::fsync(file.handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+QByteArray csvField(const QString &value)
+{
+    QByteArray field = value.toUtf8();
+    if (field.contains(',') || field.contains('"') || field.contains('\n') || field.contains('\r')) {
+        field.replace("\"", "\"\"");
+        field = "\"" + field + "\"";
+    }
+    return field;
+}
+
+// Image path of one manifest line (the first CSV field or the "path" key)
+QByteArray recordKey(const QByteArray &line, ClassificationManifest::Format format)
+{
+    if (format == ClassificationManifest::JsonLines) {
+        return QJsonDocument::fromJson(line).object().value("path").toString().toUtf8();
+    }
+
+    if (!line.startsWith('"')) {
+        int comma = line.indexOf(',');
+        return comma < 0 ? line : line.left(comma);
+    }
+
+    QByteArray key;
+    for (int i = 1; i < line.size(); ++i) {
+        if (line[i] == '"') {
+            if (i + 1 < line.size() && line[i + 1] == '"') {
+                key.append('"');
+                ++i;
+            } else {
+                break;
+            }
+        } else {
+            key.append(line[i]);
+        }
+    }
+    return key;
+}
+
+// Whether a line withdraws the label of its image (empty category)
+bool isWithdrawal(const QByteArray &line, ClassificationManifest::Format format)
+{
+    if (format == ClassificationManifest::JsonLines) {
+        return QJsonDocument::fromJson(line).object().value("category").toString().isEmpty();
+    }
+
+    // Skip the path field, which may be quoted
+    int i = 0;
+    if (line.startsWith('"')) {
+        for (i = 1; i < line.size(); ++i) {
+            if (line[i] == '"') {
+                if (i + 1 < line.size() && line[i + 1] == '"') {
+                    ++i;
+                } else {
+                    ++i;
+                    break;
+                }
+            }
+        }
+    } else {
+        i = line.indexOf(',');
+        if (i < 0) {
+            return true;
+        }
+    }
+    return i + 1 >= line.size() || line[i + 1] == ',';
+}
+
+// Appends a chunk of records, opening the file on first use
+class WriteTask : public QRunnable
+{
+public:
+    WriteTask(QObject *target, QFile *file, const QString &filePath,
+              ClassificationManifest::Format format, const QByteArray &data, bool sync,
+              quint64 generation)
+        : m_target(target), m_file(file), m_filePath(filePath), m_format(format),
+          m_data(data), m_sync(sync), m_generation(generation)
+    {
+    }
+
+    void run() override
+    {
+        if (!m_file->isOpen()) {
+            QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+            m_file->setFileName(m_filePath);
+            if (!m_file->open(QIODevice::WriteOnly | QIODevice::Append)) {
+                fail(m_file->errorString());
+                return;
+            }
+            if (m_file->size() == 0 && m_format == ClassificationManifest::Csv) {
+                m_data.prepend(QByteArray(CsvHeader) + "\n");
+            }
+        }
+
+        if (m_file->write(m_data) != m_data.size()) {
+            fail(m_file->errorString());
+            return;
+        }
+        if (m_sync && !syncFile(*m_file)) {
+            fail(m_file->errorString());
+        }
+    }
+
+private:
+    void fail(const QString &error)
+    {
+        QMetaObject::invokeMethod(m_target, "onWriteFailed", Qt::QueuedConnection,
+                                  Q_ARG(QString, error),
+                                  Q_ARG(quint64, m_generation));
+    }
+
+    QObject *m_target;
+    QFile *m_file;
+    QString m_filePath;
+    ClassificationManifest::Format m_format;
+    QByteArray m_data;
+    bool m_sync;
+    quint64 m_generation;
+};
+
+// Rewrites the manifest with the last record of every image
+class CompactTask : public QRunnable
+{
+public:
+    CompactTask(QObject *target, QFile *file, const QString &filePath,
+                ClassificationManifest::Format format, quint64 generation)
+        : m_target(target), m_file(file), m_filePath(filePath), m_format(format),
+          m_generation(generation)
+    {
+    }
+
+    void run() override
+    {
+        // Appending resumes on the compacted file
+        m_file->close();
+
+        QFile input(m_filePath);
+        if (!input.open(QIODevice::ReadOnly)) {
+            return;
+        }
+
+        QList<QByteArray> lines;
+        QHash<QByteArray, int> latest;   // Image path -> index of its last record
+        QByteArray header;
+        while (!input.atEnd()) {
+            QByteArray line = input.readLine();
+            if (line.endsWith('\n')) {
+                line.chop(1);
+            }
+            if (line.endsWith('\r')) {
+                line.chop(1);
+            }
+            if (line.isEmpty()) {
+                continue;
+            }
+            if (lines.isEmpty() && header.isEmpty() && line == CsvHeader) {
+                header = line;
+                continue;
+            }
+            latest.insert(recordKey(line, m_format), lines.size());
+            lines.append(line);
+        }
+        input.close();
+
+        QSaveFile output(m_filePath);
+        if (!output.open(QIODevice::WriteOnly)) {
+            fail(output.errorString());
+            return;
+        }
+        if (!header.isEmpty()) {
+            output.write(header + "\n");
+        }
+        int kept = 0;
+        for (int i = 0; i < lines.size(); ++i) {
+            if (latest.value(recordKey(lines[i], m_format)) == i && !isWithdrawal(lines[i], m_format)) {
+                output.write(lines[i] + "\n");
+                kept++;
+            }
+        }
+        if (!output.commit()) {
+            fail(output.errorString());
+            return;
+        }
+
+        QMetaObject::invokeMethod(m_target, "onCompacted", Qt::QueuedConnection,
+                                  Q_ARG(int, lines.size()),
+                                  Q_ARG(int, kept),
+                                  Q_ARG(quint64, m_generation));
+    }
+
+private:
+    void fail(const QString &error)
+    {
+        QMetaObject::invokeMethod(m_target, "onWriteFailed", Qt::QueuedConnection,
+                                  Q_ARG(QString, error),
+                                  Q_ARG(quint64, m_generation));
+    }
+
+    QObject *m_target;
+    QFile *m_file;
+    QString m_filePath;
+    ClassificationManifest::Format m_format;
+    quint64 m_generation;
+};
+
+} // namespace
+
+ClassificationManifest::ClassificationManifest(QObject *parent)
+    : QObject(parent),
+      m_format(Csv),
+      m_flushTimer(new QTimer(this)),
+      m_unsynced(false),
+      m_recordCount(0),
+      m_generation(0)
+{
+    m_pool.setMaxThreadCount(1);
+
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(FlushIntervalMs);
+    connect(m_flushTimer, &QTimer::timeout, this, &ClassificationManifest::onFlushTimer);
+
+    m_sinceSync.start();
+}
+
+ClassificationManifest::~ClassificationManifest()
+{
+    flush(true);
+    m_pool.waitForDone();
+    m_file.close();
+}
+
+void ClassificationManifest::setFilePath(const QString &filePath)
+{
+    if (filePath == m_filePath) {
+        return;
+    }
+
+    // Finish the old file before the writer thread is pointed elsewhere
+    flush(true);
+    m_pool.waitForDone();
+    m_file.close();
+
+    m_generation++;
+    m_filePath = filePath;
+    m_format = filePath.endsWith(".jsonl", Qt::CaseInsensitive) ? JsonLines : Csv;
+    m_recordCount = 0;
+}
+
+QByteArray ClassificationManifest::formatRecord(const QString &imagePath, const QString &category) const
+{
+    QString timestamp = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+
+    if (m_format == JsonLines) {
+        QJsonObject record;
+        record.insert("path", imagePath);
+        record.insert("category", category);
+        record.insert("timestamp", timestamp);
+        return QJsonDocument(record).toJson(QJsonDocument::Compact) + "\n";
+    }
+
+    return csvField(imagePath) + "," + csvField(category) + "," + timestamp.toUtf8() + "\n";
+}
+
+void ClassificationManifest::append(const QString &imagePath, const QString &category)
+{
+    if (m_filePath.isEmpty()) {
+        return;
+    }
+
+    m_buffer.append(formatRecord(imagePath, category));
+    m_recordCount++;
+
+    if (m_buffer.size() >= MaxBufferSize) {
+        flush();
+    } else if (!m_flushTimer->isActive()) {
+        m_flushTimer->start(FlushIntervalMs);
+    }
+}
+
+void ClassificationManifest::flush(bool sync)
+{
+    m_flushTimer->stop();
+
+    bool syncNow = (sync || m_sinceSync.elapsed() >= SyncIntervalMs) &&
+                   (m_unsynced || !m_buffer.isEmpty());
+    if (m_buffer.isEmpty() && !syncNow) {
+        return;
+    }
+
+    m_pool.start(new WriteTask(this, &m_file, m_filePath, m_format, m_buffer, syncNow, m_generation));
+    m_buffer.clear();
+
+    if (syncNow) {
+        m_unsynced = false;
+        m_sinceSync.restart();
+    } else {
+        // Make sure the data reaches the disk even if nothing else is written
+        m_unsynced = true;
+        m_flushTimer->start(SyncIntervalMs);
+    }
+}
+
+void ClassificationManifest::onFlushTimer()
+{
+    flush(m_unsynced && m_buffer.isEmpty());
+}
+
+void ClassificationManifest::compact()
+{
+    if (m_filePath.isEmpty()) {
+        return;
+    }
+
+    flush(true);
+    m_pool.start(new CompactTask(this, &m_file, m_filePath, m_format, m_generation));
+}
+
+QString ClassificationManifest::statusText() const
+{
+    return QString("Manifest: %1 labels recorded").arg(m_recordCount);
+}
+
+void ClassificationManifest::onCompacted(int recordsBefore, int recordsAfter, quint64 generation)
+{
+    if (generation != m_generation) {
+        return;
+    }
+    emit compacted(recordsBefore, recordsAfter);
+}
+
+void ClassificationManifest::onWriteFailed(const QString &error, quint64 generation)
+{
+    if (generation != m_generation) {
+        return;
+    }
+    emit writeFailed(error);
+}
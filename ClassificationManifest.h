@@ -0,0 +1,80 @@
+#ifndef CLASSIFICATIONMANIFEST_H
+#define CLASSIFICATIONMANIFEST_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTimer>
+
+/**
+ * @brief Append-only label manifest for classification without file copies
+ *
+ * Each classification appends one (path, category, timestamp) record to a
+ * CSV or JSON Lines file, chosen by the file's suffix (".jsonl" or ".csv").
+ * Records are buffered in memory and written by a single background thread
+ * once a second or when the buffer fills up; the file is fsync'ed at most
+ * every few seconds and when the manifest is closed.
+ *
+ * Reclassifying an image simply appends another record; a record with an
+ * empty category withdraws the label (undo). compact() rewrites the file
+ * with only the latest record per image and drops withdrawn images.
+ */
+class ClassificationManifest : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        Csv,
+        JsonLines
+    };
+
+    explicit ClassificationManifest(QObject *parent = nullptr);
+    ~ClassificationManifest();
+
+    // Switch to another manifest file, closing the current one
+    void setFilePath(const QString &filePath);
+    QString filePath() const { return m_filePath; }
+    Format format() const { return m_format; }
+
+    // Record imagePath as belonging to category; an empty category
+    // withdraws its label
+    void append(const QString &imagePath, const QString &category);
+
+    // Write buffered records; sync also forces them to disk
+    void flush(bool sync = false);
+
+    // Rewrite the manifest keeping the latest label per image
+    void compact();
+
+    // Records appended since the manifest was opened
+    int recordCount() const { return m_recordCount; }
+    QString statusText() const;
+
+signals:
+    void compacted(int recordsBefore, int recordsAfter);
+    void writeFailed(const QString &error);
+
+private slots:
+    void onFlushTimer();
+    void onCompacted(int recordsBefore, int recordsAfter, quint64 generation);
+    void onWriteFailed(const QString &error, quint64 generation);
+
+private:
+    QByteArray formatRecord(const QString &imagePath, const QString &category) const;
+
+    QThreadPool m_pool;             // One thread; keeps writes and compaction in order
+    QFile m_file;                   // Only used on the pool thread
+    QString m_filePath;
+    Format m_format;
+    QByteArray m_buffer;            // Records not handed to the writer yet
+    QTimer *m_flushTimer;
+    QElapsedTimer m_sinceSync;
+    bool m_unsynced;                // Written but not fsync'ed yet
+    int m_recordCount;
+    quint64 m_generation;           // Bumped when switching files
+};
+
+#endif // CLASSIFICATIONMANIFEST_H
@@ -0,0 +1,373 @@
+#include "CocoExporter.h"
+#include "AnnotationManager.h"
+#include "FolderScanner.h"
+#include "ImageLoader.h"
+#include "YoloLabelParser.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QMetaObject>
+#include <QQueue>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSemaphore>
+#include <QTemporaryFile>
+#include <QThread>
+#include <cstring>
+
+namespace {
+
+const int ChunkSize = 256;
+const qint64 SpoolCopyBlockSize = 1024 * 1024;
+
+void appendInteger(QByteArray &out, qint64 value)
+{
+    char digits[20];
+    int count = 0;
+    quint64 magnitude = value < 0 ? 0 - static_cast<quint64>(value) : static_cast<quint64>(value);
+    do {
+        digits[count++] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) {
+        out.append('-');
+    }
+    while (count > 0) {
+        out.append(digits[--count]);
+    }
+}
+
+// Two decimals are plenty for pixel coordinates; rounding may push a box
+// edge slightly below 0, which is clamped
+void appendPixels(QByteArray &out, double value)
+{
+    if (!(value < 1e15)) {
+        out.append(QByteArray::number(value, 'f', 2));
+        return;
+    }
+    qint64 hundredths = value > 0 ? static_cast<qint64>(value * 100.0 + 0.5) : 0;
+    appendInteger(out, hundredths / 100);
+    out.append('.');
+    out.append(static_cast<char>('0' + hundredths % 100 / 10));
+    out.append(static_cast<char>('0' + hundredths % 10));
+}
+
+void appendJsonString(QByteArray &out, const QString &text)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    const QByteArray utf8 = text.toUtf8();
+    out.append('"');
+    for (char c : utf8) {
+        uchar byte = static_cast<uchar>(c);
+        if (c == '"' || c == '\\') {
+            out.append('\\');
+            out.append(c);
+        } else if (byte < 0x20) {
+            out.append("\\u00");
+            out.append(hexDigits[byte >> 4]);
+            out.append(hexDigits[byte & 0xf]);
+        } else {
+            out.append(c);
+        }
+    }
+    out.append('"');
+}
+
+struct Source
+{
+    QString imagesDirectory;
+    QString labelsDirectory;
+    QSharedPointer<AnnotationStore> store;   // Used instead of labelsDirectory if set
+};
+
+// Images of one chunk, formatted by a worker and written by the writer
+struct Chunk
+{
+    Chunk() : firstImageId(0), imageCount(0), failed(0) {}
+
+    QStringList fileNames;
+    int firstImageId;
+    QByteArray images;          // ",\n{...}" per image
+    QByteArray annotations;     // Everything after the id, one annotation per line
+    int imageCount;
+    int failed;
+    QSemaphore done;            // Released once the worker is finished
+};
+
+class ChunkTask : public QRunnable
+{
+public:
+    ChunkTask(const QSharedPointer<Chunk> &chunk, const Source &source)
+        : m_chunk(chunk), m_source(source)
+    {
+    }
+
+    void run() override
+    {
+        QVector<YoloLabelParser::Box> boxes;
+        for (int i = 0; i < m_chunk->fileNames.size(); ++i) {
+            const QString &fileName = m_chunk->fileNames.at(i);
+            // Header probe only; the pixels are never decoded
+            QSize size = ImageLoader::imageSize(m_source.imagesDirectory + "/" + fileName);
+            if (!size.isValid()) {
+                m_chunk->failed++;
+                continue;
+            }
+            int imageId = m_chunk->firstImageId + i;
+
+            QByteArray &images = m_chunk->images;
+            images.append(",\n{\"id\":");
+            appendInteger(images, imageId);
+            images.append(",\"file_name\":");
+            appendJsonString(images, fileName);
+            images.append(",\"width\":");
+            appendInteger(images, size.width());
+            images.append(",\"height\":");
+            appendInteger(images, size.height());
+            images.append('}');
+            m_chunk->imageCount++;
+
+            QString key = AnnotationManager::labelFileName(fileName);
+            boxes.clear();
+            if (m_source.store) {
+                m_source.store->get(key, boxes);
+            } else {
+                YoloLabelParser::parseFile(m_source.labelsDirectory + "/" + key, boxes, nullptr, true);
+            }
+
+            QByteArray &annotations = m_chunk->annotations;
+            for (const YoloLabelParser::Box &box : boxes) {
+                double width = box.width * size.width();
+                double height = box.height * size.height();
+                annotations.append(",\"image_id\":");
+                appendInteger(annotations, imageId);
+                annotations.append(",\"category_id\":");
+                appendInteger(annotations, box.classId);
+                annotations.append(",\"bbox\":[");
+                appendPixels(annotations, box.xCenter * size.width() - width / 2);
+                annotations.append(',');
+                appendPixels(annotations, box.yCenter * size.height() - height / 2);
+                annotations.append(',');
+                appendPixels(annotations, width);
+                annotations.append(',');
+                appendPixels(annotations, height);
+                annotations.append("],\"area\":");
+                appendPixels(annotations, width * height);
+                annotations.append(",\"iscrowd\":0}\n");
+            }
+        }
+        m_chunk->done.release();
+    }
+
+private:
+    QSharedPointer<Chunk> m_chunk;
+    Source m_source;
+};
+
+class ExportTask : public QRunnable
+{
+public:
+    ExportTask(QObject *target, const QString &outputPath, const Source &source,
+               const QMap<int, QString> &categories, QAtomicInt *currentGeneration, int generation)
+        : m_target(target), m_outputPath(outputPath), m_source(source), m_categories(categories),
+          m_currentGeneration(currentGeneration), m_generation(generation),
+          m_images(0), m_annotations(0), m_failed(0)
+    {
+    }
+
+    void run() override
+    {
+        bool success = write();
+        if (cancelled()) {
+            return;
+        }
+        QMetaObject::invokeMethod(m_target, "onExportFinished", Qt::QueuedConnection,
+                                  Q_ARG(bool, success),
+                                  Q_ARG(int, m_images),
+                                  Q_ARG(int, m_annotations),
+                                  Q_ARG(int, m_failed),
+                                  Q_ARG(int, m_generation));
+    }
+
+private:
+    bool cancelled() const
+    {
+        return m_currentGeneration->load() != m_generation;
+    }
+
+    bool write()
+    {
+        // Without commit() the previous output stays as it was
+        QSaveFile output(m_outputPath);
+        QTemporaryFile spool(m_outputPath + ".annotations-XXXXXX");
+        if (!output.open(QIODevice::WriteOnly) || !spool.open()) {
+            return false;
+        }
+
+        QByteArray head("{\n\"info\":{\"description\":\"Image Classification Tool export\",\"date_created\":");
+        appendJsonString(head, QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+        head.append("},\n\"images\":[");
+        output.write(head);
+
+        // Chunks are formatted in parallel but consumed in listing order;
+        // at most maxInFlight of them exist at any time
+        QThreadPool workers;
+        workers.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+        const int maxInFlight = 2 * workers.maxThreadCount();
+        QQueue<QSharedPointer<Chunk> > inFlight;
+        QDirIterator it(m_source.imagesDirectory, FolderScanner::IMAGE_NAME_FILTERS, QDir::Files);
+        int nextImageId = 1;
+        bool ok = true;
+
+        while (true) {
+            while (ok && inFlight.size() < maxInFlight && it.hasNext()) {
+                QSharedPointer<Chunk> chunk(new Chunk);
+                chunk->firstImageId = nextImageId;
+                while (chunk->fileNames.size() < ChunkSize && it.hasNext()) {
+                    it.next();
+                    chunk->fileNames.append(it.fileName());
+                }
+                nextImageId += chunk->fileNames.size();
+                inFlight.enqueue(chunk);
+                workers.start(new ChunkTask(chunk, m_source));
+            }
+            if (inFlight.isEmpty()) {
+                break;
+            }
+
+            // Chunks still queued after a failure or cancel are drained unused
+            QSharedPointer<Chunk> chunk = inFlight.dequeue();
+            chunk->done.acquire();
+            ok = ok && !cancelled() && appendChunk(*chunk, output, spool);
+            if (ok) {
+                QMetaObject::invokeMethod(m_target, "onExportProgress", Qt::QueuedConnection,
+                                          Q_ARG(int, m_images),
+                                          Q_ARG(int, m_generation));
+            }
+        }
+        if (!ok) {
+            return false;
+        }
+
+        output.write("\n],\n\"annotations\":[");
+        if (!spool.seek(0)) {
+            return false;
+        }
+        while (!spool.atEnd()) {
+            QByteArray block = spool.read(SpoolCopyBlockSize);
+            if (block.isEmpty()) {
+                return false;
+            }
+            output.write(block);
+        }
+
+        QByteArray tail("\n],\n\"categories\":[");
+        for (QMap<int, QString>::const_iterator category = m_categories.constBegin();
+             category != m_categories.constEnd(); ++category) {
+            tail.append(category == m_categories.constBegin() ? "\n{\"id\":" : ",\n{\"id\":");
+            appendInteger(tail, category.key());
+            tail.append(",\"name\":");
+            appendJsonString(tail, category.value());
+            tail.append(",\"supercategory\":\"none\"}");
+        }
+        tail.append("\n]\n}\n");
+        output.write(tail);
+
+        // Also fails if any earlier write did
+        return output.commit();
+    }
+
+    bool appendChunk(const Chunk &chunk, QSaveFile &output, QTemporaryFile &spool)
+    {
+        m_failed += chunk.failed;
+        if (!chunk.images.isEmpty()) {
+            // The first entry of the array has no separator
+            int skip = m_images == 0 ? 1 : 0;
+            output.write(chunk.images.constData() + skip, chunk.images.size() - skip);
+            m_images += chunk.imageCount;
+        }
+
+        // Annotation ids run over the whole file, so they are only known here
+        m_spoolBuffer.clear();
+        const char *begin = chunk.annotations.constData();
+        const char *end = begin + chunk.annotations.size();
+        while (begin < end) {
+            const char *lineEnd = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+            m_spoolBuffer.append(m_annotations == 0 ? "\n{\"id\":" : ",\n{\"id\":");
+            appendInteger(m_spoolBuffer, ++m_annotations);
+            m_spoolBuffer.append(begin, static_cast<int>(lineEnd - begin));
+            begin = lineEnd + 1;
+        }
+        return spool.write(m_spoolBuffer) == m_spoolBuffer.size();
+    }
+
+    QObject *m_target;
+    QString m_outputPath;
+    Source m_source;
+    QMap<int, QString> m_categories;
+    QAtomicInt *m_currentGeneration;
+    int m_generation;
+    int m_images;
+    int m_annotations;
+    int m_failed;
+    QByteArray m_spoolBuffer;   // Reused for the annotations of each chunk
+};
+
+} // namespace
+
+CocoExporter::CocoExporter(QObject *parent)
+    : QObject(parent),
+      m_generation(0),
+      m_running(false)
+{
+    // One writer; the per-image work runs on a pool of its own
+    m_pool.setMaxThreadCount(1);
+}
+
+CocoExporter::~CocoExporter()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void CocoExporter::start(const QString &outputPath, const QString &imagesDirectory,
+                         const QString &labelsDirectory, const QSharedPointer<AnnotationStore> &store,
+                         const QMap<int, QString> &categories)
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_running = true;
+
+    Source source;
+    source.imagesDirectory = imagesDirectory;
+    source.labelsDirectory = labelsDirectory;
+    source.store = store;
+    m_pool.start(new ExportTask(this, outputPath, source, categories,
+                                &m_generation, m_generation.load()));
+}
+
+void CocoExporter::cancel()
+{
+    // The writer notices the new generation after the chunk it waits for
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_running = false;
+}
+
+void CocoExporter::onExportProgress(int images, int generation)
+{
+    if (generation != m_generation.load()) {
+        return;
+    }
+    emit progress(images);
+}
+
+void CocoExporter::onExportFinished(bool success, int images, int annotations, int failed, int generation)
+{
+    if (generation != m_generation.load()) {
+        return;
+    }
+    m_running = false;
+    emit finished(success, images, annotations, failed);
+}
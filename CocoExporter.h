@@ -0,0 +1,64 @@
+#ifndef COCOEXPORTER_H
+#define COCOEXPORTER_H
+
+#include "AnnotationStore.h"
+#include <QObject>
+#include <QAtomicInt>
+#include <QMap>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QString>
+
+/**
+ * @brief Writes the annotated images of an output folder as one COCO JSON file
+ *
+ * The images folder is listed with QDirIterator and handed out in chunks to
+ * a pool of workers. Each worker reads the image dimensions from the file
+ * header (ImageLoader::imageSize(), no decode), loads the boxes from the
+ * labels folder or an AnnotationStore and formats its part of the JSON.
+ * A single writer thread appends finished chunks strictly in listing order,
+ * and only a bounded number of chunks is in flight, so memory stays
+ * constant however large the dataset is.
+ *
+ * "images" entries go straight to the output file while "annotations"
+ * entries are spooled to a temporary file next to it and appended at the
+ * end, followed by "categories". The output is written through QSaveFile,
+ * so a cancelled or failed export leaves any previous file untouched.
+ *
+ * Category ids are the YOLO class ids; box coordinates are in pixels.
+ */
+class CocoExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CocoExporter(QObject *parent = nullptr);
+    ~CocoExporter();
+
+    // Export imagesDirectory to outputPath, reading boxes from store if it is
+    // set and from labelsDirectory/<name>.txt otherwise. categories maps class
+    // ids to label names. Cancels any export in progress.
+    void start(const QString &outputPath, const QString &imagesDirectory,
+               const QString &labelsDirectory, const QSharedPointer<AnnotationStore> &store,
+               const QMap<int, QString> &categories);
+
+    // Stop the running export; the output file is not written
+    void cancel();
+    bool isRunning() const { return m_running; }
+
+signals:
+    void progress(int images);
+    // failed counts images whose size could not be read; they are left out
+    void finished(bool success, int images, int annotations, int failed);
+
+private slots:
+    void onExportProgress(int images, int generation);
+    void onExportFinished(bool success, int images, int annotations, int failed, int generation);
+
+private:
+    QThreadPool m_pool;
+    QAtomicInt m_generation;   // Bumped to cancel the running export
+    bool m_running;
+};
+
+#endif // COCOEXPORTER_H
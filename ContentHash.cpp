@@ -0,0 +1,182 @@
+#include "ContentHash.h"
+#include <QFile>
+#include <cstring>
+
+namespace {
+
+const quint64 Prime1 = Q_UINT64_C(0x9E3779B185EBCA87);
+const quint64 Prime2 = Q_UINT64_C(0xC2B2AE3D27D4EB4F);
+const quint64 Prime3 = Q_UINT64_C(0x165667B19E3779F9);
+const quint64 Prime4 = Q_UINT64_C(0x85EBCA77C2B2AE63);
+const quint64 Prime5 = Q_UINT64_C(0x27D4EB2F165667C5);
+
+const qint64 ReadChunkSize = 1024 * 1024;
+
+inline quint64 rotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little-endian loads regardless of host order or alignment
+inline quint64 read64(const uchar *p)
+{
+    return quint64(p[0]) | (quint64(p[1]) << 8) | (quint64(p[2]) << 16) | (quint64(p[3]) << 24) |
+           (quint64(p[4]) << 32) | (quint64(p[5]) << 40) | (quint64(p[6]) << 48) | (quint64(p[7]) << 56);
+}
+
+inline quint32 read32(const uchar *p)
+{
+    return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16) | (quint32(p[3]) << 24);
+}
+
+inline quint64 round(quint64 lane, quint64 input)
+{
+    lane += input * Prime2;
+    lane = rotateLeft(lane, 31);
+    return lane * Prime1;
+}
+
+inline quint64 mergeRound(quint64 acc, quint64 lane)
+{
+    acc ^= round(0, lane);
+    return acc * Prime1 + Prime4;
+}
+
+} // namespace
+
+ContentHash::ContentHash(quint64 seed)
+    : m_seed(seed),
+      m_buffered(0),
+      m_total(0)
+{
+    m_lanes[0] = seed + Prime1 + Prime2;
+    m_lanes[1] = seed + Prime2;
+    m_lanes[2] = seed;
+    m_lanes[3] = seed - Prime1;
+}
+
+void ContentHash::update(const char *data, qint64 size)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + size;
+    m_total += static_cast<quint64>(size);
+
+    if (m_buffered + size < 32) {
+        std::memcpy(m_buffer + m_buffered, p, static_cast<size_t>(size));
+        m_buffered += static_cast<int>(size);
+        return;
+    }
+
+    if (m_buffered > 0) {
+        int fill = 32 - m_buffered;
+        std::memcpy(m_buffer + m_buffered, p, fill);
+        for (int lane = 0; lane < 4; ++lane) {
+            m_lanes[lane] = round(m_lanes[lane], read64(m_buffer + lane * 8));
+        }
+        p += fill;
+        m_buffered = 0;
+    }
+
+    // Four independent lanes keep the multiplier pipeline busy
+    quint64 v1 = m_lanes[0], v2 = m_lanes[1], v3 = m_lanes[2], v4 = m_lanes[3];
+    while (end - p >= 32) {
+        v1 = round(v1, read64(p));
+        v2 = round(v2, read64(p + 8));
+        v3 = round(v3, read64(p + 16));
+        v4 = round(v4, read64(p + 24));
+        p += 32;
+    }
+    m_lanes[0] = v1; m_lanes[1] = v2; m_lanes[2] = v3; m_lanes[3] = v4;
+
+    m_buffered = static_cast<int>(end - p);
+    std::memcpy(m_buffer, p, m_buffered);
+}
+
+quint64 ContentHash::digest() const
+{
+    quint64 h;
+    if (m_total >= 32) {
+        h = rotateLeft(m_lanes[0], 1) + rotateLeft(m_lanes[1], 7) +
+            rotateLeft(m_lanes[2], 12) + rotateLeft(m_lanes[3], 18);
+        for (int lane = 0; lane < 4; ++lane) {
+            h = mergeRound(h, m_lanes[lane]);
+        }
+    } else {
+        h = m_seed + Prime5;
+    }
+    h += m_total;
+
+    const uchar *p = m_buffer;
+    const uchar *end = m_buffer + m_buffered;
+    while (end - p >= 8) {
+        h ^= round(0, read64(p));
+        h = rotateLeft(h, 27) * Prime1 + Prime4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        h ^= quint64(read32(p)) * Prime1;
+        h = rotateLeft(h, 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= quint64(*p) * Prime5;
+        h = rotateLeft(h, 11) * Prime1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+quint64 ContentHash::hash(const char *data, qint64 size, quint64 seed)
+{
+    ContentHash state(seed);
+    state.update(data, size);
+    return state.digest();
+}
+
+bool ContentHash::hashFile(const QString &filePath, quint64 *hash, QString *error)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+
+    qint64 size = file.size();
+    if (size == 0) {
+        *hash = ContentHash::hash(nullptr, 0);
+        return true;
+    }
+
+    // Mapping avoids copying the file through a read buffer
+    if (uchar *data = file.map(0, size)) {
+        *hash = ContentHash::hash(reinterpret_cast<const char *>(data), size);
+        file.unmap(data);
+        return true;
+    }
+
+    ContentHash state;
+    QByteArray buffer(static_cast<int>(qMin(size, ReadChunkSize)), Qt::Uninitialized);
+    for (;;) {
+        qint64 read = file.read(buffer.data(), buffer.size());
+        if (read < 0) {
+            if (error) {
+                *error = file.errorString();
+            }
+            return false;
+        }
+        if (read == 0) {
+            break;
+        }
+        state.update(buffer.constData(), read);
+    }
+    *hash = state.digest();
+    return true;
+}
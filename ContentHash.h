@@ -0,0 +1,35 @@
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * @brief Fast non-cryptographic 64-bit content hash (XXH64)
+ *
+ * Used to recognise identical image files. Runs at several GB/s, so hashing
+ * is bound by disk reads. Output matches the reference XXH64 implementation,
+ * which makes stored hashes comparable with the xxhsum tool.
+ */
+class ContentHash
+{
+public:
+    explicit ContentHash(quint64 seed = 0);
+
+    void update(const char *data, qint64 size);
+    quint64 digest() const;
+
+    static quint64 hash(const char *data, qint64 size, quint64 seed = 0);
+
+    // Hash a whole file, memory-mapping it when possible
+    static bool hashFile(const QString &filePath, quint64 *hash, QString *error = nullptr);
+
+private:
+    quint64 m_seed;
+    quint64 m_lanes[4];
+    uchar m_buffer[32];          // Input not yet consumed as a full stripe
+    int m_buffered;
+    quint64 m_total;
+};
+
+#endif // CONTENTHASH_H
@@ -0,0 +1,222 @@
+#include "ContentStore.h"
+#include "ContentHash.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+ContentStore::ContentStore()
+    : m_skipped(0),
+      m_linked(0),
+      m_bytesSaved(0),
+      m_bytesHashed(0)
+{
+}
+
+QString ContentStore::claim(const QString &sourcePath, const QString &destinationPath, Content *content)
+{
+    *content = Content();
+    QFileInfo source(sourcePath);
+    if (!source.exists()) {
+        return QString();
+    }
+    content->size = source.size();
+
+    QFileInfo destination(destinationPath);
+    QString folder = destination.absolutePath();
+    QStringList candidates;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_listedFolders.contains(folder)) {
+            listFolder(folder);
+        }
+        // A file of a size nobody else has cannot be a duplicate; it is
+        // only hashed once another file of its size turns up
+        if (!m_unhashed.contains(content->size) && !m_hashedSizes.contains(content->size)) {
+            insertUnhashed(destination.absoluteFilePath(), content->size);
+            return QString();
+        }
+        candidates = m_unhashed.take(content->size);
+        for (const QString &path : candidates) {
+            m_unhashedSizes.remove(path);
+        }
+    }
+
+    if (!ContentHash::hashFile(sourcePath, &content->hash)) {
+        QMutexLocker locker(&m_mutex);
+        for (const QString &path : candidates) {
+            insertUnhashed(path, content->size);
+        }
+        content->size = -1;
+        return QString();
+    }
+    content->hashed = true;
+
+    // Candidates that can no longer be read were deleted behind our back
+    for (const QString &path : candidates) {
+        quint64 existingHash;
+        if (ContentHash::hashFile(path, &existingHash)) {
+            QMutexLocker locker(&m_mutex);
+            m_bytesHashed += content->size;
+            insert(path, Key(content->size, existingHash));
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_bytesHashed += content->size;
+    Key key(content->size, content->hash);
+    QString elsewhere;
+    const QStringList holders = m_paths.value(key);
+    for (const QString &path : holders) {
+        if (!QFile::exists(path)) {
+            // Deleted or renamed behind our back
+            m_paths[key].removeAll(path);
+            m_keys.remove(path);
+            if (--m_hashedSizes[key.first] == 0) {
+                m_hashedSizes.remove(key.first);
+            }
+            continue;
+        }
+        if (QFileInfo(path).absolutePath() == folder) {
+            return path;
+        }
+        if (elsewhere.isEmpty()) {
+            elsewhere = path;
+        }
+    }
+    if (elsewhere.isEmpty()) {
+        insert(destination.absoluteFilePath(), key);
+    }
+    return elsewhere;
+}
+
+void ContentStore::listFolder(const QString &folder)
+{
+    m_listedFolders.insert(folder);
+    const QFileInfoList files = QDir(folder).entryInfoList(QDir::Files | QDir::NoDotAndDotDot);
+    for (const QFileInfo &file : files) {
+        insertUnhashed(file.absoluteFilePath(), file.size());
+    }
+}
+
+void ContentStore::insert(const QString &path, const Key &key)
+{
+    if (m_keys.contains(path)) {
+        return;
+    }
+    removeUnhashed(path);
+    m_keys.insert(path, key);
+    m_paths[key].append(path);
+    m_hashedSizes[key.first]++;
+}
+
+void ContentStore::insertUnhashed(const QString &path, qint64 size)
+{
+    if (m_keys.contains(path) || m_unhashedSizes.contains(path)) {
+        return;
+    }
+    m_unhashedSizes.insert(path, size);
+    m_unhashed[size].append(path);
+}
+
+void ContentStore::removeUnhashed(const QString &path)
+{
+    if (!m_unhashedSizes.contains(path)) {
+        return;
+    }
+    qint64 size = m_unhashedSizes.take(path);
+    QStringList &paths = m_unhashed[size];
+    paths.removeAll(path);
+    if (paths.isEmpty()) {
+        m_unhashed.remove(size);
+    }
+}
+
+void ContentStore::add(const QString &path, const Content &content)
+{
+    if (content.size < 0) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    QString absolutePath = QFileInfo(path).absoluteFilePath();
+    if (content.hashed) {
+        insert(absolutePath, Key(content.size, content.hash));
+    } else {
+        insertUnhashed(absolutePath, content.size);
+    }
+}
+
+void ContentStore::forget(const QString &path)
+{
+    QMutexLocker locker(&m_mutex);
+    QString absolutePath = QFileInfo(path).absoluteFilePath();
+    removeUnhashed(absolutePath);
+    if (!m_keys.contains(absolutePath)) {
+        return;
+    }
+    Key key = m_keys.take(absolutePath);
+    m_paths[key].removeAll(absolutePath);
+    if (m_paths[key].isEmpty()) {
+        m_paths.remove(key);
+    }
+    if (--m_hashedSizes[key.first] == 0) {
+        m_hashedSizes.remove(key.first);
+    }
+}
+
+void ContentStore::countSkipped(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_skipped++;
+    m_bytesSaved += bytes;
+}
+
+void ContentStore::countLinked(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_linked++;
+    m_bytesSaved += bytes;
+}
+
+int ContentStore::skippedCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_skipped;
+}
+
+int ContentStore::linkedCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_linked;
+}
+
+qint64 ContentStore::bytesSaved() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytesSaved;
+}
+
+qint64 ContentStore::bytesHashed() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytesHashed;
+}
+
+QString ContentStore::statusText() const
+{
+    QMutexLocker locker(&m_mutex);
+    return QString("Duplicates: %1 skipped, %2 linked (%3 MB not written)")
+        .arg(m_skipped).arg(m_linked)
+        .arg(m_bytesSaved / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
+void ContentStore::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_paths.clear();
+    m_keys.clear();
+    m_hashedSizes.clear();
+    m_unhashed.clear();
+    m_unhashedSizes.clear();
+    m_listedFolders.clear();
+}
@@ -0,0 +1,86 @@
+#ifndef CONTENTSTORE_H
+#define CONTENTSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QMutex>
+
+/**
+ * @brief Content-addressed lookup of files placed into output folders
+ *
+ * Maps (size, XXH64 hash) to the files holding that content. Nothing is
+ * hashed until two files of the same size meet: placed files and the files
+ * already in a destination folder (listed on first use) are recorded by
+ * size only, and a source whose size matches none of them is placed
+ * without reading it at all. Only when a same-size candidate exists are
+ * the source and the candidates hashed, so Move, Hardlink and Reflink stay
+ * O(1) for the usual unrelated images.
+ *
+ * Thread-safe: hashing happens on the calling (worker) thread, outside the
+ * lock. Also counts the duplicates callers resolved and the bytes that were
+ * therefore never written.
+ */
+class ContentStore
+{
+public:
+    struct Content {
+        Content() : size(-1), hash(0), hashed(false) {}
+
+        qint64 size;        // -1 for a missing or unreadable file
+        quint64 hash;       // Only valid if hashed
+        bool hashed;
+    };
+
+    ContentStore();
+
+    // Return a file with the same content as sourcePath, preferring one in
+    // the folder of destinationPath. If there is none, destinationPath is
+    // recorded as the holder of that content (call forget() if placing it
+    // fails) and an empty string is returned. content receives the
+    // source's; it is only hashed if a file of the same size is known. A
+    // missing or unreadable source gets size -1 and is never reported as a
+    // duplicate.
+    QString claim(const QString &sourcePath, const QString &destinationPath, Content *content);
+
+    // Record a file known to hold the given content (ignored for size -1)
+    void add(const QString &path, const Content &content);
+    void forget(const QString &path);
+
+    // Bookkeeping for the report
+    void countSkipped(qint64 bytes);
+    void countLinked(qint64 bytes);
+
+    int skippedCount() const;
+    int linkedCount() const;
+    qint64 bytesSaved() const;
+    qint64 bytesHashed() const;
+    QString statusText() const;
+
+    // Forget everything, e.g. when the output folder changes
+    void clear();
+
+private:
+    typedef QPair<qint64, quint64> Key;
+
+    void listFolder(const QString &folder);
+    void insert(const QString &path, const Key &key);
+    void insertUnhashed(const QString &path, qint64 size);
+    void removeUnhashed(const QString &path);
+
+    mutable QMutex m_mutex;
+    QHash<Key, QStringList> m_paths;                  // Content -> hashed files holding it
+    QHash<QString, Key> m_keys;                       // Hashed file -> its content
+    QHash<qint64, int> m_hashedSizes;                 // Size -> number of hashed files
+    QHash<qint64, QStringList> m_unhashed;            // Size -> files not hashed yet
+    QHash<QString, qint64> m_unhashedSizes;           // File not hashed yet -> its size
+    QSet<QString> m_listedFolders;
+    int m_skipped;
+    int m_linked;
+    qint64 m_bytesSaved;
+    qint64 m_bytesHashed;
+};
+
+#endif // CONTENTSTORE_H
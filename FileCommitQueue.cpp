@@ -0,0 +1,475 @@
+#include "FileCommitQueue.h"
+#include <QRunnable>
+#include <QMetaObject>
+#include <QThread>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSettings>
+
+namespace {
+
+const int MaxBatchSize = 64;
+const int FlushDelayMs = 50;
+const int MaxAttempts = 3;
+const int MaxRevertible = 256;   // Placements revert() still knows about
+
+// How to take back one placement; one byte per file in batch results
+enum RevertAction {
+    NothingToRevert = 'n',       // Content was already there; nothing was placed
+    RemoveDestination = 'r',     // A copy or link was created
+    MoveBack = 'm'               // The source itself was moved
+};
+
+// First free name of the form name.ext, name_1.ext, name_2.ext, ...
+QString uniqueDestination(const QString &destinationFolder, const QFileInfo &fileInfo)
+{
+    QString path = destinationFolder + "/" + fileInfo.fileName();
+    QString baseName = fileInfo.completeBaseName();
+    QString suffix = fileInfo.suffix().isEmpty() ? QString() : "." + fileInfo.suffix();
+    for (int n = 1; QFile::exists(path); ++n) {
+        path = destinationFolder + "/" + baseName + "_" + QString::number(n) + suffix;
+    }
+    return path;
+}
+
+// Places one batch of files, retrying transient failures
+class CommitBatchTask : public QRunnable
+{
+public:
+    CommitBatchTask(QObject *target, const QStringList &sources, const QStringList &destinationFolders,
+                    FilePlacement::Strategy strategy, ContentStore *contentStore)
+        : m_target(target), m_sources(sources), m_destinationFolders(destinationFolders),
+          m_strategy(strategy), m_contentStore(contentStore)
+    {
+    }
+
+    void run() override
+    {
+        QStringList destinations;
+        QStringList errors;
+        QByteArray revertActions;
+        int withoutCopy = 0;
+
+        for (int i = 0; i < m_sources.size(); ++i) {
+            QString destination;
+            QString error;
+            FilePlacement::Strategy used = FilePlacement::Copy;
+            char revert = NothingToRevert;
+            for (int attempt = 0; attempt < MaxAttempts; ++attempt) {
+                if (attempt > 0) {
+                    // Give network shares and USB disks a moment to recover
+                    QThread::msleep(100 << attempt);
+                }
+                error = commit(m_sources[i], m_destinationFolders[i], destination, used, revert);
+                if (error.isEmpty()) {
+                    break;
+                }
+            }
+            destinations.append(error.isEmpty() ? destination : QString());
+            errors.append(error);
+            revertActions.append(error.isEmpty() ? revert : char(NothingToRevert));
+            if (error.isEmpty() && used != FilePlacement::Copy) {
+                withoutCopy++;
+            }
+        }
+
+        QMetaObject::invokeMethod(m_target, "onBatchCommitted", Qt::QueuedConnection,
+                                  Q_ARG(QStringList, m_sources),
+                                  Q_ARG(QStringList, m_destinationFolders),
+                                  Q_ARG(QStringList, destinations),
+                                  Q_ARG(QStringList, errors),
+                                  Q_ARG(QByteArray, revertActions),
+                                  Q_ARG(int, withoutCopy));
+    }
+
+private:
+    // Returns an empty string on success. A source whose content is already
+    // in the destination folder is not placed again (used is then Move,
+    // as nothing was copied); content found in another folder is hardlinked
+    // from there. The source is never deleted for a duplicate, even with
+    // the Move strategy.
+    QString commit(const QString &sourcePath, const QString &destinationFolder,
+                   QString &destinationPath, FilePlacement::Strategy &used, char &revert)
+    {
+        revert = NothingToRevert;
+        QFileInfo fileInfo(sourcePath);
+        if (!fileInfo.exists()) {
+            return "Source file no longer exists";
+        }
+
+        if (!QDir().mkpath(destinationFolder)) {
+            return "Failed to create folder " + destinationFolder;
+        }
+
+        // Never reuse a taken name, so images that share a name all arrive
+        destinationPath = uniqueDestination(destinationFolder, fileInfo);
+
+        ContentStore::Content content;
+        if (m_contentStore) {
+            QString existing = m_contentStore->claim(sourcePath, destinationPath, &content);
+            if (!existing.isEmpty()) {
+                if (QFileInfo(existing).absolutePath() == QFileInfo(destinationPath).absolutePath()) {
+                    destinationPath = existing;
+                    used = FilePlacement::Move;
+                    m_contentStore->countSkipped(content.size);
+                    return QString();
+                }
+                if (FilePlacement::place(existing, destinationPath, FilePlacement::Hardlink, &used)) {
+                    m_contentStore->add(destinationPath, content);
+                    revert = RemoveDestination;
+                    if (used != FilePlacement::Copy) {
+                        m_contentStore->countLinked(content.size);
+                    }
+                    return QString();
+                }
+                m_contentStore->add(destinationPath, content);
+            }
+        }
+
+        // Copy by default (safer than move in case of errors); hardlinks and
+        // reflinks keep the original without duplicating its data
+        QString error;
+        while (!FilePlacement::place(sourcePath, destinationPath, m_strategy, &used, &error)) {
+            if (m_contentStore) {
+                m_contentStore->forget(destinationPath);
+            }
+            // Another worker took the name in the meantime: pick the next one
+            if (!QFile::exists(destinationPath)) {
+                return error;
+            }
+            destinationPath = uniqueDestination(destinationFolder, fileInfo);
+            if (m_contentStore) {
+                m_contentStore->add(destinationPath, content);
+            }
+        }
+        revert = (used == FilePlacement::Move) ? MoveBack : RemoveDestination;
+        return QString();
+    }
+
+    QObject *m_target;
+    QStringList m_sources;
+    QStringList m_destinationFolders;
+    FilePlacement::Strategy m_strategy;
+    ContentStore *m_contentStore;   // Null when duplicates are placed like any file
+};
+
+// Takes back one placement
+class RevertTask : public QRunnable
+{
+public:
+    RevertTask(QObject *target, const QString &sourcePath, const QString &destinationPath,
+               char action, ContentStore *contentStore)
+        : m_target(target), m_sourcePath(sourcePath), m_destinationPath(destinationPath),
+          m_action(action), m_contentStore(contentStore)
+    {
+    }
+
+    void run() override
+    {
+        QString error;
+        if (m_action == MoveBack) {
+            if (!FilePlacement::place(m_destinationPath, m_sourcePath, FilePlacement::Move, nullptr, &error)) {
+                error = "Failed to move back: " + error;
+            }
+        } else if (m_action == RemoveDestination) {
+            if (!QFile::remove(m_destinationPath) && QFile::exists(m_destinationPath)) {
+                error = "Failed to remove " + m_destinationPath;
+            }
+        }
+        if (error.isEmpty()) {
+            m_contentStore->forget(m_destinationPath);
+        }
+
+        QMetaObject::invokeMethod(m_target, "onReverted", Qt::QueuedConnection,
+                                  Q_ARG(QString, m_sourcePath),
+                                  Q_ARG(QString, error));
+    }
+
+private:
+    QObject *m_target;
+    QString m_sourcePath;
+    QString m_destinationPath;
+    char m_action;
+    ContentStore *m_contentStore;
+};
+
+} // namespace
+
+FileCommitQueue::FileCommitQueue(QObject *parent)
+    : QObject(parent),
+      m_flushTimer(new QTimer(this)),
+      m_strategy(FilePlacement::Copy),
+      m_deduplicate(QSettings().value("placement/deduplicate", true).toBool()),
+      m_inFlight(0),
+      m_committed(0),
+      m_committedWithoutCopy(0),
+      m_batchTotal(0),
+      m_batchFailed(0)
+{
+    // Copies are I/O bound; a few concurrent batches hide latency of
+    // network shares without thrashing a local disk.
+    m_pool.setMaxThreadCount(qBound(2, QThread::idealThreadCount() / 2, 4));
+
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(FlushDelayMs);
+    connect(m_flushTimer, &QTimer::timeout, this, &FileCommitQueue::flush);
+}
+
+FileCommitQueue::~FileCommitQueue()
+{
+    // Requests were already acknowledged in the UI, so do not drop them
+    flush();
+    m_pool.waitForDone();
+}
+
+void FileCommitQueue::enqueue(const QString &sourcePath, const QString &destinationFolder)
+{
+    Request request;
+    request.sourcePath = sourcePath;
+    request.destinationFolder = destinationFolder;
+    m_queue.append(request);
+
+    if (m_queue.size() >= MaxBatchSize) {
+        flush();
+    } else if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+    emit statusChanged();
+}
+
+void FileCommitQueue::enqueueBatch(const QStringList &sourcePaths, const QString &destinationFolder)
+{
+    if (sourcePaths.isEmpty()) {
+        return;
+    }
+
+    for (const QString &sourcePath : sourcePaths) {
+        Request request;
+        request.sourcePath = sourcePath;
+        request.destinationFolder = destinationFolder;
+        m_queue.append(request);
+        if (!m_batchPending.contains(sourcePath)) {
+            m_batchPending.insert(sourcePath);
+            m_batchTotal++;
+        }
+    }
+
+    // Spread the files over all workers instead of filling 64-file batches
+    // one after another
+    m_flushTimer->stop();
+    int workers = qMax(1, m_pool.maxThreadCount());
+    startBatches(qBound(1, (m_queue.size() + workers - 1) / workers, MaxBatchSize));
+
+    emit batchProgress(m_batchTotal - m_batchPending.size(), m_batchTotal);
+    emit statusChanged();
+}
+
+void FileCommitQueue::flush()
+{
+    m_flushTimer->stop();
+    startBatches(MaxBatchSize);
+}
+
+void FileCommitQueue::startBatches(int batchSize)
+{
+    while (!m_queue.isEmpty()) {
+        QStringList sources;
+        QStringList destinationFolders;
+        while (!m_queue.isEmpty() && sources.size() < batchSize) {
+            Request request = m_queue.takeFirst();
+            sources.append(request.sourcePath);
+            destinationFolders.append(request.destinationFolder);
+        }
+
+        m_inFlight += sources.size();
+        for (const QString &source : sources) {
+            m_inFlightSources[source]++;
+        }
+        m_pool.start(new CommitBatchTask(this, sources, destinationFolders, m_strategy,
+                                         m_deduplicate ? &m_contentStore : nullptr));
+    }
+}
+
+void FileCommitQueue::setDeduplicate(bool enabled)
+{
+    m_deduplicate = enabled;
+    QSettings().setValue("placement/deduplicate", enabled);
+}
+
+void FileCommitQueue::waitForDone()
+{
+    flush();
+    m_pool.waitForDone();
+}
+
+void FileCommitQueue::onBatchCommitted(const QStringList &sources, const QStringList &destinationFolders,
+                                       const QStringList &destinations, const QStringList &errors,
+                                       const QByteArray &revertActions, int withoutCopy)
+{
+    m_inFlight -= sources.size();
+    m_committedWithoutCopy += withoutCopy;
+
+    bool batchAdvanced = false;
+    for (int i = 0; i < sources.size(); ++i) {
+        if (m_batchPending.remove(sources[i])) {
+            batchAdvanced = true;
+            if (!errors[i].isEmpty()) {
+                m_batchFailed++;
+            }
+        }
+        if (--m_inFlightSources[sources[i]] == 0) {
+            m_inFlightSources.remove(sources[i]);
+        }
+        bool revertNow = m_revertPending.contains(sources[i]);
+        if (revertNow && --m_revertPending[sources[i]] == 0) {
+            m_revertPending.remove(sources[i]);
+        }
+        if (errors[i].isEmpty()) {
+            m_committed++;
+            emit committed(sources[i], destinations[i]);
+            if (revertNow) {
+                // This placement, not a newer request for the same source
+                Placement placement;
+                placement.destinationPath = destinations[i];
+                placement.revertAction = revertActions.at(i);
+                startRevert(sources[i], placement);
+            } else {
+                rememberPlacement(sources[i], destinations[i], revertActions.at(i));
+            }
+        } else if (!revertNow) {
+            Failure failure;
+            failure.sourcePath = sources[i];
+            failure.destinationFolder = destinationFolders[i];
+            failure.error = errors[i];
+            m_failures.append(failure);
+            emit failed(sources[i], errors[i]);
+        }
+    }
+
+    if (batchAdvanced) {
+        emit batchProgress(m_batchTotal - m_batchPending.size(), m_batchTotal);
+        if (m_batchPending.isEmpty()) {
+            int total = m_batchTotal;
+            int failedCount = m_batchFailed;
+            m_batchTotal = 0;
+            m_batchFailed = 0;
+            emit batchFinished(total - failedCount, failedCount);
+        }
+    }
+    emit statusChanged();
+}
+
+void FileCommitQueue::rememberPlacement(const QString &sourcePath, const QString &destinationPath,
+                                        char revertAction)
+{
+    // A source classified again keeps its earlier placements below the new one
+    Placement placement;
+    placement.destinationPath = destinationPath;
+    placement.revertAction = revertAction;
+    m_placements[sourcePath].append(placement);
+    m_placementOrder.append(sourcePath);
+
+    while (m_placementOrder.size() > MaxRevertible) {
+        QString oldest = m_placementOrder.takeFirst();
+        QList<Placement> &placements = m_placements[oldest];
+        placements.removeFirst();
+        if (placements.isEmpty()) {
+            m_placements.remove(oldest);
+        }
+    }
+}
+
+void FileCommitQueue::startRevert(const QString &sourcePath, const Placement &placement)
+{
+    m_inFlight++;
+    m_pool.start(new RevertTask(this, sourcePath, placement.destinationPath,
+                                placement.revertAction, &m_contentStore));
+}
+
+void FileCommitQueue::revert(const QString &sourcePath)
+{
+    // Not handed to a worker yet: simply forget the request
+    for (int i = m_queue.size() - 1; i >= 0; --i) {
+        if (m_queue[i].sourcePath == sourcePath) {
+            m_queue.removeAt(i);
+            if (m_batchPending.remove(sourcePath)) {
+                m_batchTotal--;
+                emit batchProgress(m_batchTotal - m_batchPending.size(), m_batchTotal);
+                if (m_batchPending.isEmpty()) {
+                    emit batchFinished(m_batchTotal - m_batchFailed, m_batchFailed);
+                    m_batchTotal = 0;
+                    m_batchFailed = 0;
+                }
+            }
+            emit statusChanged();
+            return;
+        }
+    }
+
+    for (int i = 0; i < m_failures.size(); ++i) {
+        if (m_failures[i].sourcePath == sourcePath) {
+            m_failures.removeAt(i);
+            emit statusChanged();
+            return;
+        }
+    }
+
+    // Being placed right now, which is newer than anything already placed;
+    // reverted as soon as the batch reports back
+    if (m_revertPending.value(sourcePath) < m_inFlightSources.value(sourcePath)) {
+        m_revertPending[sourcePath]++;
+        return;
+    }
+
+    if (m_placements.contains(sourcePath)) {
+        QList<Placement> &placements = m_placements[sourcePath];
+        Placement placement = placements.takeLast();
+        if (placements.isEmpty()) {
+            m_placements.remove(sourcePath);
+        }
+        m_placementOrder.removeAt(m_placementOrder.lastIndexOf(sourcePath));
+        startRevert(sourcePath, placement);
+    }
+}
+
+void FileCommitQueue::onReverted(const QString &sourcePath, const QString &error)
+{
+    m_inFlight--;
+    if (error.isEmpty()) {
+        m_committed--;
+        emit reverted(sourcePath);
+    } else {
+        emit revertFailed(sourcePath, error);
+    }
+    emit statusChanged();
+}
+
+void FileCommitQueue::retryFailures()
+{
+    QList<Failure> failures = m_failures;
+    m_failures.clear();
+    for (const Failure &failure : failures) {
+        enqueue(failure.sourcePath, failure.destinationFolder);
+    }
+    emit statusChanged();
+}
+
+void FileCommitQueue::clearFailures()
+{
+    m_failures.clear();
+    emit statusChanged();
+}
+
+QString FileCommitQueue::statusText() const
+{
+    QString text = QString("Placed: %1 (%2 without copying) | Pending: %3")
+        .arg(m_committed).arg(m_committedWithoutCopy).arg(pendingCount());
+    if (m_contentStore.skippedCount() + m_contentStore.linkedCount() > 0) {
+        text += " | " + m_contentStore.statusText();
+    }
+    if (!m_failures.isEmpty()) {
+        text += QString(" | Failed: %1").arg(m_failures.size());
+    }
+    return text;
+}
@@ -0,0 +1,130 @@
+#ifndef FILECOMMITQUEUE_H
+#define FILECOMMITQUEUE_H
+
+#include "FilePlacement.h"
+#include "ContentStore.h"
+#include <QObject>
+#include <QThreadPool>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QTimer>
+
+/**
+ * @brief Places classified images into their category folders in the background
+ *
+ * enqueue() only records the request, so the GUI can move on immediately.
+ * Requests are grouped into batches and committed by worker threads with
+ * the selected FilePlacement strategy. A failed placement is retried a few
+ * times with a short back-off before it ends up on the failure list, from
+ * where it can be retried or discarded.
+ *
+ * revert() takes back one of the recent requests: a queued request is
+ * dropped, a placed file is removed again (or moved back with the Move
+ * strategy). Content that was already in the folder is left alone.
+ *
+ * enqueueBatch() places many files at once: they are split evenly across
+ * the workers right away, and batchProgress()/batchFinished() report on
+ * all of them together.
+ *
+ * Destroying the queue finishes every request still pending.
+ */
+class FileCommitQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Failure {
+        QString sourcePath;
+        QString destinationFolder;
+        QString error;
+    };
+
+    explicit FileCommitQueue(QObject *parent = nullptr);
+    ~FileCommitQueue();
+
+    // Place sourcePath into destinationFolder (created if needed)
+    void enqueue(const QString &sourcePath, const QString &destinationFolder);
+
+    // Place all sourcePaths into destinationFolder without waiting for the
+    // flush timer. Batches started while another is running are reported
+    // as one.
+    void enqueueBatch(const QStringList &sourcePaths, const QString &destinationFolder);
+
+    // Undo the most recent request for sourcePath; only the last few
+    // hundred placements can be reverted
+    void revert(const QString &sourcePath);
+
+    // Applies to requests that have not been handed to a worker yet
+    void setStrategy(FilePlacement::Strategy strategy) { m_strategy = strategy; }
+    FilePlacement::Strategy strategy() const { return m_strategy; }
+
+    // Skip or hardlink exact duplicates; saved in "placement/deduplicate"
+    void setDeduplicate(bool enabled);
+    bool deduplicate() const { return m_deduplicate; }
+    const ContentStore &contentStore() const { return m_contentStore; }
+
+    // Requests not committed yet, including batches in progress
+    int pendingCount() const { return m_queue.size() + m_inFlight; }
+
+    QList<Failure> failures() const { return m_failures; }
+    void retryFailures();
+    void clearFailures();
+
+    // Commit everything queued and block until it is done
+    void waitForDone();
+
+    QString statusText() const;
+
+signals:
+    void committed(const QString &sourcePath, const QString &destinationPath);
+    void failed(const QString &sourcePath, const QString &error);
+    void statusChanged();
+    void batchProgress(int done, int total);
+    void batchFinished(int placed, int failed);
+    void reverted(const QString &sourcePath);
+    void revertFailed(const QString &sourcePath, const QString &error);
+
+private slots:
+    void flush();
+    void onBatchCommitted(const QStringList &sources, const QStringList &destinationFolders,
+                          const QStringList &destinations, const QStringList &errors,
+                          const QByteArray &revertActions, int withoutCopy);
+    void onReverted(const QString &sourcePath, const QString &error);
+
+private:
+    struct Request {
+        QString sourcePath;
+        QString destinationFolder;
+    };
+
+    struct Placement {
+        QString destinationPath;
+        char revertAction;
+    };
+
+    void startBatches(int batchSize);
+    void rememberPlacement(const QString &sourcePath, const QString &destinationPath, char revertAction);
+    void startRevert(const QString &sourcePath, const Placement &placement);
+
+    QThreadPool m_pool;
+    QTimer *m_flushTimer;        // Groups requests made in quick succession
+    QList<Request> m_queue;      // Waiting for a worker
+    QList<Failure> m_failures;   // Gave up after retries
+    FilePlacement::Strategy m_strategy;
+    ContentStore m_contentStore;  // Shared by the workers
+    bool m_deduplicate;
+    int m_inFlight;              // Requests handed to workers
+    int m_committed;
+    int m_committedWithoutCopy;  // Moved, hardlinked, reflinked or already there
+    QSet<QString> m_batchPending; // Sources of enqueueBatch() not committed yet
+    int m_batchTotal;
+    int m_batchFailed;
+    QHash<QString, int> m_inFlightSources;   // Requests handed to workers, per source
+    QHash<QString, QList<Placement> > m_placements;  // Recent placements per source, oldest first, for revert()
+    QStringList m_placementOrder;            // Sources of m_placements, oldest placement first
+    QHash<QString, int> m_revertPending;     // Reverted while a worker was placing them, per source
+};
+
+#endif // FILECOMMITQUEUE_H
@@ -0,0 +1,244 @@
+#include "FilePlacement.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSettings>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_UNIX
+bool sameFileSystem(const QString &sourcePath, const QString &destinationPath)
+{
+    struct stat source;
+    struct stat folder;
+    QByteArray folderPath = QFile::encodeName(QFileInfo(destinationPath).absolutePath());
+    return ::stat(QFile::encodeName(sourcePath).constData(), &source) == 0 &&
+           ::stat(folderPath.constData(), &folder) == 0 &&
+           source.st_dev == folder.st_dev;
+}
+#endif
+
+#ifdef Q_OS_LINUX
+// Copies size bytes between two open files without passing them through
+// user space. Returns false if the kernel cannot do it for these files.
+bool kernelCopy(int in, int out, qint64 size, bool allowReflink, bool *cloned)
+{
+#ifdef FICLONE
+    if (allowReflink && ::ioctl(out, FICLONE, in) == 0) {
+        *cloned = true;
+        return true;
+    }
+#else
+    Q_UNUSED(allowReflink);
+#endif
+
+#ifdef SYS_copy_file_range
+    qint64 remaining = size;
+    while (remaining > 0) {
+        long copied = ::syscall(SYS_copy_file_range, in, nullptr, out, nullptr,
+                                static_cast<size_t>(remaining), 0u);
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        // EXDEV (older kernels), ENOSYS, EINVAL etc.: let the caller fall back
+        if (copied <= 0) {
+            return false;
+        }
+        remaining -= copied;
+    }
+    return true;
+#else
+    Q_UNUSED(size);
+    return false;
+#endif
+}
+#endif
+
+} // namespace
+
+bool FilePlacement::hardlink(const QString &sourcePath, const QString &destinationPath)
+{
+#if defined(Q_OS_UNIX)
+    return ::link(QFile::encodeName(sourcePath).constData(),
+                  QFile::encodeName(destinationPath).constData()) == 0;
+#elif defined(Q_OS_WIN)
+    QString source = QDir::toNativeSeparators(QFileInfo(sourcePath).absoluteFilePath());
+    QString destination = QDir::toNativeSeparators(QFileInfo(destinationPath).absoluteFilePath());
+    return CreateHardLinkW(reinterpret_cast<const wchar_t *>(destination.utf16()),
+                           reinterpret_cast<const wchar_t *>(source.utf16()), nullptr) != 0;
+#else
+    Q_UNUSED(sourcePath);
+    Q_UNUSED(destinationPath);
+    return false;
+#endif
+}
+
+bool FilePlacement::copy(const QString &sourcePath, const QString &destinationPath,
+                         bool allowReflink, Strategy *used, QString *error)
+{
+#ifdef Q_OS_LINUX
+    QByteArray source = QFile::encodeName(sourcePath);
+    QByteArray destination = QFile::encodeName(destinationPath);
+
+    int in = ::open(source.constData(), O_RDONLY | O_CLOEXEC);
+    if (in >= 0) {
+        struct stat info;
+        if (::fstat(in, &info) == 0) {
+            // O_EXCL: never replace a file that appeared in the meantime
+            int out = ::open(destination.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                             info.st_mode & 0777);
+            if (out < 0 && errno == EEXIST) {
+                ::close(in);
+                if (error) {
+                    *error = "Destination already exists";
+                }
+                return false;
+            }
+
+            if (out >= 0) {
+                bool cloned = false;
+                bool copied = kernelCopy(in, out, info.st_size, allowReflink, &cloned);
+                copied = (::close(out) == 0) && copied;
+                if (copied) {
+                    ::close(in);
+                    if (used) {
+                        *used = cloned ? Reflink : Copy;
+                    }
+                    return true;
+                }
+                ::unlink(destination.constData());
+            }
+        }
+        ::close(in);
+    }
+#else
+    Q_UNUSED(allowReflink);
+#endif
+
+    QFile file(sourcePath);
+    if (!file.copy(destinationPath)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    if (used) {
+        *used = Copy;
+    }
+    return true;
+}
+
+bool FilePlacement::place(const QString &sourcePath, const QString &destinationPath,
+                          Strategy strategy, Strategy *used, QString *error)
+{
+    if (QFile::exists(destinationPath)) {
+        if (error) {
+            *error = "Destination already exists";
+        }
+        return false;
+    }
+
+    switch (strategy) {
+    case Move: {
+#ifdef Q_OS_UNIX
+        // A rename cannot cross filesystems; copy with the fast path instead
+        // of QFile::rename()'s user-space fallback
+        if (!sameFileSystem(sourcePath, destinationPath)) {
+            if (!copy(sourcePath, destinationPath, false, used, error)) {
+                return false;
+            }
+            QFile::remove(sourcePath);
+            return true;
+        }
+#endif
+        // QFile::rename() refuses to replace an existing destination
+        QFile file(sourcePath);
+        if (!file.rename(destinationPath)) {
+            if (error) {
+                *error = file.errorString();
+            }
+            return false;
+        }
+        if (used) {
+            *used = Move;
+        }
+        return true;
+    }
+
+    case Hardlink:
+        // Fails across filesystems and on FAT/exFAT; a reflink or copy will do
+        if (hardlink(sourcePath, destinationPath)) {
+            if (used) {
+                *used = Hardlink;
+            }
+            return true;
+        }
+        return copy(sourcePath, destinationPath, true, used, error);
+
+    case Reflink:
+        return copy(sourcePath, destinationPath, true, used, error);
+
+    case Copy:
+    default:
+        return copy(sourcePath, destinationPath, false, used, error);
+    }
+}
+
+QString FilePlacement::strategyName(Strategy strategy)
+{
+    switch (strategy) {
+    case Move:
+        return "Move";
+    case Hardlink:
+        return "Hardlink";
+    case Reflink:
+        return "Reflink";
+    case Copy:
+    default:
+        return "Copy";
+    }
+}
+
+QStringList FilePlacement::strategyNames()
+{
+    return QStringList() << strategyName(Copy) << strategyName(Reflink)
+                         << strategyName(Hardlink) << strategyName(Move);
+}
+
+FilePlacement::Strategy FilePlacement::strategyFromName(const QString &name, Strategy fallback)
+{
+    for (int i = Copy; i <= Move; ++i) {
+        Strategy strategy = static_cast<Strategy>(i);
+        if (name.compare(strategyName(strategy), Qt::CaseInsensitive) == 0) {
+            return strategy;
+        }
+    }
+    return fallback;
+}
+
+FilePlacement::Strategy FilePlacement::savedStrategy(const QString &key)
+{
+    return strategyFromName(QSettings().value(key).toString());
+}
+
+void FilePlacement::saveStrategy(Strategy strategy, const QString &key)
+{
+    QSettings().setValue(key, strategyName(strategy));
+}
@@ -0,0 +1,52 @@
+#ifndef FILEPLACEMENT_H
+#define FILEPLACEMENT_H
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief Places a file at a new path as cheaply as the filesystem allows
+ *
+ * Strategies, from cheapest to most expensive:
+ * - Move: rename the file (the source disappears)
+ * - Hardlink: add a second name for the same data
+ * - Reflink: copy-on-write clone (FICLONE on btrfs/XFS)
+ * - Copy: kernel-side copy_file_range, which avoids user-space buffers
+ *
+ * Each strategy falls back automatically when the filesystem or platform
+ * does not support it: Hardlink and Reflink fall back to Copy, Copy falls
+ * back to QFile::copy(), and Move across filesystems becomes copy + remove.
+ * An existing destination is never overwritten.
+ */
+class FilePlacement
+{
+public:
+    enum Strategy {
+        Copy,
+        Reflink,
+        Hardlink,
+        Move
+    };
+
+    // Place sourcePath at destinationPath. On success, used (if given) tells
+    // which strategy actually did the work; on failure error describes why.
+    static bool place(const QString &sourcePath, const QString &destinationPath,
+                      Strategy strategy, Strategy *used = nullptr, QString *error = nullptr);
+
+    // Names for settings and UI
+    static QString strategyName(Strategy strategy);
+    static QStringList strategyNames();
+    static Strategy strategyFromName(const QString &name, Strategy fallback = Copy);
+
+    // Strategy stored in a setting, "placement/strategy" unless another key
+    // is given (Copy by default)
+    static Strategy savedStrategy(const QString &key = QStringLiteral("placement/strategy"));
+    static void saveStrategy(Strategy strategy, const QString &key = QStringLiteral("placement/strategy"));
+
+private:
+    static bool hardlink(const QString &sourcePath, const QString &destinationPath);
+    static bool copy(const QString &sourcePath, const QString &destinationPath,
+                     bool allowReflink, Strategy *used, QString *error);
+};
+
+#endif // FILEPLACEMENT_H
@@ -0,0 +1,487 @@
+#include "FolderIndex.h"
+#include "FolderScanner.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+namespace {
+
+const quint32 IndexMagic = 0x46494458;   // "FIDX"
+const quint32 IndexVersion = 2;   // 2: separate classified/annotated bits
+
+qint64 modifiedTime(const QFileInfo &info)
+{
+    return info.lastModified().toMSecsSinceEpoch();
+}
+
+} // namespace
+
+FolderIndex::FolderIndex()
+    : m_recursive(false),
+      m_dirty(false)
+{
+}
+
+void FolderIndex::reset(const QString &folderPath, bool recursive)
+{
+    m_rootPath = QDir(folderPath).absolutePath();
+    m_recursive = recursive;
+    m_directories.clear();
+    m_entries.clear();
+    m_directoryRows.clear();
+    m_rows.clear();
+    m_dirty = true;
+}
+
+QString FolderIndex::indexFilePath(const QString &folderPath, bool recursive)
+{
+    QString key = QDir(folderPath).absolutePath() + (recursive ? "|recursive" : "|flat");
+    QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           "/folder-index/" + QString::fromLatin1(hash) + ".idx";
+}
+
+QString FolderIndex::absoluteDirectoryPath(int directory) const
+{
+    const QString &relativePath = m_directories[directory].relativePath;
+    return relativePath.isEmpty() ? m_rootPath : m_rootPath + "/" + relativePath;
+}
+
+int FolderIndex::addDirectory(const QString &relativePath, qint64 modified)
+{
+    Directory directory;
+    directory.relativePath = relativePath;
+    directory.modified = modified;
+    m_directories.append(directory);
+    m_directoryRows.insert(relativePath, m_directories.size() - 1);
+    return m_directories.size() - 1;
+}
+
+void FolderIndex::appendEntry(int directory, const QString &fileName)
+{
+    Entry entry;
+    entry.directory = static_cast<quint32>(directory);
+    entry.fileName = fileName;
+    entry.size = -1;
+    entry.modified = -1;
+    entry.width = 0;
+    entry.height = 0;
+    entry.status = Unprocessed;
+    m_entries.append(entry);
+}
+
+bool FolderIndex::listFiles(int directory, const FileVisitor &visitor)
+{
+    QString directoryPath = absoluteDirectoryPath(directory);
+    QDirIterator it(directoryPath, FolderScanner::IMAGE_NAME_FILTERS,
+                    QDir::Files | QDir::NoDotAndDotDot);
+    QStringList fileNames;
+    while (it.hasNext()) {
+        it.next();
+        fileNames.append(it.fileName());
+    }
+
+    // readdir order is arbitrary; keep the name order QDir used to give,
+    // one directory at a time so results still stream
+    fileNames.sort(Qt::CaseInsensitive);
+    for (const QString &fileName : fileNames) {
+        appendEntry(directory, fileName);
+
+        if (visitor && !visitor(directoryPath + "/" + fileName)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FolderIndex::scanTree(const QString &relativePath, const FileVisitor &visitor)
+{
+    // Breadth-first so shallow images are reported first
+    QStringList pending;
+    pending.append(relativePath);
+
+    while (!pending.isEmpty()) {
+        QString current = pending.takeFirst();
+        QString absolutePath = current.isEmpty() ? m_rootPath : m_rootPath + "/" + current;
+
+        int directory = addDirectory(current, modifiedTime(QFileInfo(absolutePath)));
+        if (!listFiles(directory, visitor)) {
+            return false;
+        }
+
+        if (m_recursive) {
+            QStringList children;
+            QDirIterator it(absolutePath, QDir::Dirs | QDir::NoDotAndDotDot);
+            while (it.hasNext()) {
+                it.next();
+                QString child = current.isEmpty() ? it.fileName() : current + "/" + it.fileName();
+                if (!m_directoryRows.contains(child)) {
+                    children.append(child);
+                }
+            }
+            children.sort(Qt::CaseInsensitive);
+            pending.append(children);
+        }
+    }
+    return true;
+}
+
+bool FolderIndex::scan(const FileVisitor &visitor)
+{
+    m_dirty = true;
+    return scanTree(QString(), visitor);
+}
+
+bool FolderIndex::refresh()
+{
+    // A directory's mtime changes when entries are added, removed or renamed
+    // in it, so unchanged directories keep their file lists.
+    QList<int> changed;
+    QSet<int> vanished;
+    for (int i = 0; i < m_directories.size(); ++i) {
+        QFileInfo info(absoluteDirectoryPath(i));
+        if (!info.isDir()) {
+            if (m_directories[i].modified != -1) {
+                vanished.insert(i);
+            }
+        } else if (modifiedTime(info) != m_directories[i].modified) {
+            changed.append(i);
+        }
+    }
+
+    if (changed.isEmpty() && vanished.isEmpty()) {
+        return false;
+    }
+
+    // Current file names of the changed directories
+    QHash<int, QSet<QString>> listings;
+    for (int directory : changed) {
+        QSet<QString> &names = listings[directory];
+        QDirIterator it(absoluteDirectoryPath(directory), FolderScanner::IMAGE_NAME_FILTERS,
+                        QDir::Files | QDir::NoDotAndDotDot);
+        while (it.hasNext()) {
+            it.next();
+            names.insert(it.fileName());
+        }
+    }
+
+    // Drop entries that are gone, keeping the order of the rest
+    int kept = 0;
+    for (int i = 0; i < m_entries.size(); ++i) {
+        const Entry &entry = m_entries[i];
+        int directory = static_cast<int>(entry.directory);
+        if (vanished.contains(directory)) {
+            continue;
+        }
+
+        QHash<int, QSet<QString>>::iterator listing = listings.find(directory);
+        if (listing != listings.end()) {
+            if (!listing->contains(entry.fileName)) {
+                continue;
+            }
+            // Whatever is left in the listing afterwards is new
+            listing->remove(entry.fileName);
+        }
+
+        if (kept != i) {
+            m_entries[kept] = entry;
+        }
+        kept++;
+    }
+    m_entries.resize(kept);
+
+    for (int directory : vanished) {
+        m_directories[directory].modified = -1;
+    }
+
+    // New files go to the end of the queue, sorted for a stable order
+    for (int directory : changed) {
+        QStringList added = listings.value(directory).values();
+        added.sort(Qt::CaseInsensitive);
+        for (const QString &fileName : added) {
+            appendEntry(directory, fileName);
+        }
+
+        m_directories[directory].modified = modifiedTime(QFileInfo(absoluteDirectoryPath(directory)));
+
+        if (m_recursive) {
+            QString parent = m_directories[directory].relativePath;
+            QDirIterator it(absoluteDirectoryPath(directory), QDir::Dirs | QDir::NoDotAndDotDot);
+            while (it.hasNext()) {
+                it.next();
+                QString child = parent.isEmpty() ? it.fileName() : parent + "/" + it.fileName();
+                if (!m_directoryRows.contains(child)) {
+                    scanTree(child, FileVisitor());
+                }
+            }
+        }
+    }
+
+    m_rows.clear();
+    m_dirty = true;
+    return true;
+}
+
+bool FolderIndex::load(const QString &folderPath, bool recursive)
+{
+    reset(folderPath, recursive);
+    m_dirty = false;
+
+    QFile file(indexFilePath(folderPath, recursive));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != IndexMagic || version != IndexVersion) {
+        return false;
+    }
+
+    QString rootPath;
+    bool storedRecursive = false;
+    in >> rootPath >> storedRecursive;
+    if (rootPath != m_rootPath || storedRecursive != recursive) {
+        return false;
+    }
+
+    quint32 directoryCount = 0;
+    in >> directoryCount;
+    m_directories.reserve(static_cast<int>(directoryCount));
+    for (quint32 i = 0; i < directoryCount && in.status() == QDataStream::Ok; ++i) {
+        QByteArray relativePath;
+        qint64 modified = 0;
+        in >> relativePath >> modified;
+        addDirectory(QString::fromUtf8(relativePath), modified);
+    }
+
+    quint32 entryCount = 0;
+    in >> entryCount;
+    m_entries.reserve(static_cast<int>(entryCount));
+    for (quint32 i = 0; i < entryCount && in.status() == QDataStream::Ok; ++i) {
+        Entry entry;
+        QByteArray fileName;
+        in >> entry.directory >> fileName >> entry.size >> entry.modified
+           >> entry.width >> entry.height >> entry.status;
+        entry.fileName = QString::fromUtf8(fileName);
+        m_entries.append(entry);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        reset(folderPath, recursive);
+        return false;
+    }
+
+    for (const Entry &entry : m_entries) {
+        if (entry.directory >= static_cast<quint32>(m_directories.size())) {
+            reset(folderPath, recursive);
+            return false;
+        }
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+bool FolderIndex::save()
+{
+    if (m_rootPath.isEmpty()) {
+        return false;
+    }
+
+    QString path = indexFilePath(m_rootPath, m_recursive);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+
+    out << IndexMagic << IndexVersion;
+    out << m_rootPath << m_recursive;
+
+    out << static_cast<quint32>(m_directories.size());
+    for (const Directory &directory : m_directories) {
+        out << directory.relativePath.toUtf8() << directory.modified;
+    }
+
+    out << static_cast<quint32>(m_entries.size());
+    for (const Entry &entry : m_entries) {
+        out << entry.directory << entry.fileName.toUtf8() << entry.size << entry.modified
+            << entry.width << entry.height << entry.status;
+    }
+
+    if (!file.commit()) {
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+QString FolderIndex::absolutePath(int row) const
+{
+    const Entry &entry = m_entries[row];
+    return absoluteDirectoryPath(static_cast<int>(entry.directory)) + "/" + entry.fileName;
+}
+
+QStringList FolderIndex::absolutePaths() const
+{
+    QStringList paths;
+    paths.reserve(m_entries.size());
+    for (int i = 0; i < m_entries.size(); ++i) {
+        paths.append(absolutePath(i));
+    }
+    return paths;
+}
+
+QStringList FolderIndex::processedPaths(Status mark) const
+{
+    QStringList paths;
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (isProcessed(i, mark)) {
+            paths.append(absolutePath(i));
+        }
+    }
+    return paths;
+}
+
+QStringList FolderIndex::directoryPaths() const
+{
+    QStringList paths;
+    for (int i = 0; i < m_directories.size(); ++i) {
+        if (m_directories[i].modified != -1) {
+            paths.append(absoluteDirectoryPath(i));
+        }
+    }
+    return paths;
+}
+
+void FolderIndex::addFile(const QString &absolutePath)
+{
+    if (rowOf(absolutePath) >= 0) {
+        return;
+    }
+
+    // Directories are keyed relative to the root, which is "" itself
+    QFileInfo info(absolutePath);
+    QString relativePath = QDir(m_rootPath).relativeFilePath(info.path());
+    if (relativePath == ".") {
+        relativePath.clear();
+    }
+
+    int directory = m_directoryRows.value(relativePath, -1);
+    if (directory < 0) {
+        // Will be picked up by refresh() on the next open
+        return;
+    }
+
+    appendEntry(directory, info.fileName());
+    if (!m_rows.isEmpty()) {
+        m_rows.insert(absolutePath, m_entries.size() - 1);
+    }
+    m_dirty = true;
+}
+
+void FolderIndex::removeFiles(const QStringList &absolutePaths)
+{
+    QSet<int> rows;
+    for (const QString &path : absolutePaths) {
+        int row = rowOf(path);
+        if (row >= 0) {
+            rows.insert(row);
+        }
+    }
+    if (rows.isEmpty()) {
+        return;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (rows.contains(i)) {
+            continue;
+        }
+        if (kept != i) {
+            m_entries[kept] = m_entries[i];
+        }
+        kept++;
+    }
+    m_entries.resize(kept);
+    m_rows.clear();
+    m_dirty = true;
+}
+
+void FolderIndex::renameFile(const QString &from, const QString &to)
+{
+    int row = rowOf(from);
+    if (row < 0) {
+        return;
+    }
+
+    m_entries[row].fileName = QFileInfo(to).fileName();
+    m_rows.remove(from);
+    m_rows.insert(to, row);
+    m_dirty = true;
+}
+
+int FolderIndex::rowOf(const QString &absolutePath)
+{
+    if (m_rows.isEmpty() && !m_entries.isEmpty()) {
+        m_rows.reserve(m_entries.size());
+        for (int i = 0; i < m_entries.size(); ++i) {
+            m_rows.insert(this->absolutePath(i), i);
+        }
+    }
+    return m_rows.value(absolutePath, -1);
+}
+
+void FolderIndex::setProcessed(const QString &absolutePath, Status mark, bool processed)
+{
+    setProcessed(rowOf(absolutePath), mark, processed);
+}
+
+void FolderIndex::setProcessed(int row, Status mark, bool processed)
+{
+    if (row < 0 || row >= m_entries.size()) {
+        return;
+    }
+    quint8 status = processed ? (m_entries[row].status | mark) : (m_entries[row].status & ~mark);
+    if (status != m_entries[row].status) {
+        m_entries[row].status = status;
+        m_dirty = true;
+    }
+}
+
+void FolderIndex::setImageInfo(const QString &absolutePath, qint64 size, qint64 modified,
+                               const QSize &dimensions)
+{
+    int row = rowOf(absolutePath);
+    if (row < 0) {
+        return;
+    }
+
+    Entry &entry = m_entries[row];
+    if (entry.size == size && entry.modified == modified &&
+        entry.width == dimensions.width() && entry.height == dimensions.height()) {
+        return;
+    }
+
+    entry.size = size;
+    entry.modified = modified;
+    entry.width = dimensions.width();
+    entry.height = dimensions.height();
+    m_dirty = true;
+}
@@ -0,0 +1,111 @@
+#ifndef FOLDERINDEX_H
+#define FOLDERINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSize>
+#include <functional>
+
+/**
+ * @brief Persistent index of the images in a source folder
+ *
+ * Stores, per image, its file name (grouped by directory), size, mtime,
+ * pixel dimensions and processing status bits in one compact binary file in the
+ * user's cache directory. On reopen the index is validated incrementally:
+ * only directories whose mtime changed are listed again, so a large,
+ * mostly unchanged dataset opens without enumerating it.
+ *
+ * Size, mtime and dimensions are filled in lazily as images are viewed,
+ * which keeps scanning free of per-file stat calls.
+ *
+ * The index is not thread-safe; it is built on the scanner thread and then
+ * handed over to the GUI thread.
+ */
+class FolderIndex
+{
+public:
+    // Status bits; each window records and restores only its own
+    enum Status {
+        Unprocessed = 0,
+        Classified = 1,     // Placed in a category by the classification window
+        Annotated = 2       // Boxes saved by the object detection window
+    };
+
+    struct Directory {
+        QString relativePath;   // Empty for the root folder
+        qint64 modified;        // mtime in ms, -1 if the directory disappeared
+    };
+
+    struct Entry {
+        quint32 directory;      // Index into the directory table
+        QString fileName;
+        qint64 size;            // -1 until known
+        qint64 modified;        // mtime in ms, -1 until known
+        qint32 width;           // 0 until known
+        qint32 height;
+        quint8 status;          // Status bits
+    };
+
+    // Called for every file found; return false to cancel
+    typedef std::function<bool(const QString &absolutePath)> FileVisitor;
+
+    FolderIndex();
+
+    // Start an empty index for folderPath
+    void reset(const QString &folderPath, bool recursive);
+
+    // Enumerate the whole folder into an empty index
+    bool scan(const FileVisitor &visitor);
+
+    // Read the saved index for folderPath; false if missing or unusable
+    bool load(const QString &folderPath, bool recursive);
+
+    // Re-list directories whose mtime changed; returns true if anything changed
+    bool refresh();
+
+    bool save();
+    bool isDirty() const { return m_dirty; }
+
+    QString rootPath() const { return m_rootPath; }
+    bool isRecursive() const { return m_recursive; }
+    int count() const { return m_entries.size(); }
+    QString absolutePath(int row) const;
+    QStringList absolutePaths() const;
+    QStringList processedPaths(Status mark) const;
+    QStringList directoryPaths() const;
+
+    // Keep the index in step with files added or removed while it is open
+    void addFile(const QString &absolutePath);
+    void removeFiles(const QStringList &absolutePaths);
+    // Renamed within its directory; status and image info are kept
+    void renameFile(const QString &from, const QString &to);
+
+    void setProcessed(const QString &absolutePath, Status mark, bool processed);
+    void setProcessed(int row, Status mark, bool processed);
+    bool isProcessed(int row, Status mark) const { return (m_entries[row].status & mark) != 0; }
+    void setImageInfo(const QString &absolutePath, qint64 size, qint64 modified,
+                      const QSize &dimensions);
+
+    // Location of the index file for a folder
+    static QString indexFilePath(const QString &folderPath, bool recursive);
+
+private:
+    QString absoluteDirectoryPath(int directory) const;
+    int addDirectory(const QString &relativePath, qint64 modified);
+    void appendEntry(int directory, const QString &fileName);
+    bool scanTree(const QString &relativePath, const FileVisitor &visitor);
+    bool listFiles(int directory, const FileVisitor &visitor);
+    int rowOf(const QString &absolutePath);
+
+    QString m_rootPath;
+    bool m_recursive;
+    QVector<Directory> m_directories;
+    QVector<Entry> m_entries;
+    QHash<QString, int> m_directoryRows;   // Relative path -> directory index
+    QHash<QString, int> m_rows;            // Absolute path -> entry, built on demand
+    bool m_dirty;
+};
+
+#endif // FOLDERINDEX_H
@@ -0,0 +1,165 @@
+#include "FolderScanner.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QMetaObject>
+
+const QStringList FolderScanner::IMAGE_NAME_FILTERS = {"*.jpg", "*.jpeg", "*.png", "*.bmp"};
+
+namespace {
+
+const int MaxBatchSize = 2048;
+const int MaxBatchIntervalMs = 100;
+
+class ScanTask : public QRunnable
+{
+public:
+    ScanTask(QObject *target, const QSharedPointer<FolderIndex> &index,
+             const QString &folderPath, bool recursive,
+             QAtomicInt *currentGeneration, int generation)
+        : m_target(target), m_index(index), m_folderPath(folderPath), m_recursive(recursive),
+          m_currentGeneration(currentGeneration), m_generation(generation), m_total(0)
+    {
+    }
+
+    void run() override
+    {
+        m_sinceLastBatch.start();
+
+        // A saved index only needs the directories that changed re-listed
+        if (m_index->load(m_folderPath, m_recursive)) {
+            m_index->refresh();
+            for (int row = 0; row < m_index->count(); ++row) {
+                if (!found(m_index->absolutePath(row))) {
+                    return;
+                }
+            }
+        } else {
+            m_index->reset(m_folderPath, m_recursive);
+            bool completed = m_index->scan([this](const QString &path) {
+                return found(path);
+            });
+            if (!completed) {
+                return;
+            }
+        }
+
+        if (cancelled()) {
+            return;
+        }
+
+        post(m_batch);
+        if (m_index->isDirty()) {
+            m_index->save();
+        }
+        QMetaObject::invokeMethod(m_target, "onScanFinished", Qt::QueuedConnection,
+                                  Q_ARG(int, m_total),
+                                  Q_ARG(int, m_generation));
+    }
+
+private:
+    bool cancelled() const
+    {
+        return m_currentGeneration->load() != m_generation;
+    }
+
+    bool found(const QString &path)
+    {
+        if (cancelled()) {
+            return false;
+        }
+
+        m_batch.append(path);
+        m_total++;
+
+        // Report the very first image right away so it can be shown
+        if (m_total == 1 || m_batch.size() >= MaxBatchSize ||
+            m_sinceLastBatch.elapsed() >= MaxBatchIntervalMs) {
+            post(m_batch);
+            m_batch.clear();
+            m_sinceLastBatch.restart();
+        }
+        return true;
+    }
+
+    void post(const QStringList &batch)
+    {
+        if (batch.isEmpty()) {
+            return;
+        }
+        QMetaObject::invokeMethod(m_target, "onBatchFound", Qt::QueuedConnection,
+                                  Q_ARG(QStringList, batch),
+                                  Q_ARG(int, m_generation));
+    }
+
+    QObject *m_target;
+    QSharedPointer<FolderIndex> m_index;
+    QString m_folderPath;
+    bool m_recursive;
+    QAtomicInt *m_currentGeneration;
+    int m_generation;
+    QStringList m_batch;
+    QElapsedTimer m_sinceLastBatch;
+    int m_total;
+};
+
+} // namespace
+
+FolderScanner::FolderScanner(QObject *parent)
+    : QObject(parent),
+      m_generation(0),
+      m_running(false)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+FolderScanner::~FolderScanner()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void FolderScanner::start(const QString &folderPath, bool recursive)
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_running = true;
+
+    // The worker owns the new index until finished() hands it over
+    m_index = QSharedPointer<FolderIndex>::create();
+    m_pool.start(new ScanTask(this, m_index, folderPath, recursive,
+                              &m_generation, m_generation.load()));
+}
+
+void FolderScanner::cancel()
+{
+    // The worker notices the new generation and stops at the next file
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_running = false;
+    m_index.clear();
+}
+
+bool FolderScanner::isImageFile(const QString &fileName)
+{
+    QString extension = QFileInfo(fileName).suffix().toLower();
+    return (extension == "jpg" || extension == "jpeg" || extension == "png" || extension == "bmp");
+}
+
+void FolderScanner::onBatchFound(const QStringList &paths, int generation)
+{
+    if (generation != m_generation.load()) {
+        return;
+    }
+    emit batchFound(paths);
+}
+
+void FolderScanner::onScanFinished(int total, int generation)
+{
+    if (generation != m_generation.load()) {
+        return;
+    }
+    m_running = false;
+    emit finished(total);
+}
@@ -0,0 +1,62 @@
+#ifndef FOLDERSCANNER_H
+#define FOLDERSCANNER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include "FolderIndex.h"
+
+/**
+ * @brief Enumerates image files of a folder on a background thread
+ *
+ * Uses QDirIterator (readdir/getdents on Unix, FindFirstFile on Windows)
+ * with case-insensitive name filters, so no per-file stat is needed. Each
+ * directory is sorted by name before its images are reported, so the queue
+ * keeps name order while results are streamed back to the GUI thread in
+ * batches: the first image found is reported immediately, later ones are
+ * grouped to keep signal traffic low.
+ *
+ * The folder is recorded in a FolderIndex. When a saved index exists only the
+ * directories that changed since are listed again, and the index is saved
+ * once a scan completes.
+ */
+class FolderScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FolderScanner(QObject *parent = nullptr);
+    ~FolderScanner();
+
+    // Start scanning folderPath, cancelling any scan in progress
+    void start(const QString &folderPath, bool recursive);
+
+    // Stop the running scan; no further signals are emitted for it
+    void cancel();
+    bool isRunning() const { return m_running; }
+
+    // Index of the last scanned folder, valid once finished() was emitted
+    QSharedPointer<FolderIndex> index() const { return m_running ? QSharedPointer<FolderIndex>() : m_index; }
+
+    // Supported image types
+    static const QStringList IMAGE_NAME_FILTERS;
+    static bool isImageFile(const QString &fileName);
+
+signals:
+    void batchFound(const QStringList &paths);
+    void finished(int total);
+
+private slots:
+    void onBatchFound(const QStringList &paths, int generation);
+    void onScanFinished(int total, int generation);
+
+private:
+    QThreadPool m_pool;
+    QAtomicInt m_generation;   // Bumped to cancel the running scan
+    bool m_running;
+    QSharedPointer<FolderIndex> m_index;
+};
+
+#endif // FOLDERSCANNER_H
@@ -0,0 +1,301 @@
+#include "FolderWatcher.h"
+#include "FolderScanner.h"
+#include <QDir>
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QMetaObject>
+#include <QDebug>
+
+namespace {
+
+const int SettleIntervalMs = 300;
+
+// Lists one directory and compares it with the names known for it
+class ListDirectoryTask : public QRunnable
+{
+public:
+    ListDirectoryTask(QObject *target, const QString &path, const QSet<QString> &known,
+                      const QSharedPointer<FolderWatcher::Signatures> &signatures,
+                      bool recursive, quint64 generation)
+        : m_target(target), m_path(path), m_known(known), m_signatures(signatures),
+          m_recursive(recursive), m_generation(generation)
+    {
+    }
+
+    void run() override
+    {
+        bool exists = QDir(m_path).exists();
+        QStringList added;
+        QStringList removed;
+        QStringList renamedFrom;
+        QStringList renamedTo;
+        QStringList subdirectories;
+
+        if (exists) {
+            QHash<QString, FolderWatcher::Signature> signatures;
+            {
+                QMutexLocker locker(&m_signatures->mutex);
+                signatures = m_signatures->directories.value(m_path);
+            }
+
+            QSet<QString> remaining = m_known;
+            QDirIterator files(m_path, FolderScanner::IMAGE_NAME_FILTERS,
+                               QDir::Files | QDir::NoDotAndDotDot);
+            while (files.hasNext()) {
+                files.next();
+                QString name = files.fileName();
+                bool known = remaining.remove(name);
+                if (!known) {
+                    added.append(name);
+                }
+                // Stat'ed once, so the next change can recognise a rename
+                if (!known || !signatures.contains(name)) {
+                    QFileInfo info = files.fileInfo();
+                    signatures.insert(name, FolderWatcher::Signature(info.size(),
+                                                                     info.lastModified().toMSecsSinceEpoch()));
+                }
+            }
+            removed = remaining.values();
+            removed.sort();
+            added.sort();
+
+            pairRenames(signatures, removed, added, renamedFrom, renamedTo);
+            for (const QString &name : removed + renamedFrom) {
+                signatures.remove(name);
+            }
+            {
+                QMutexLocker locker(&m_signatures->mutex);
+                m_signatures->directories.insert(m_path, signatures);
+            }
+
+            if (m_recursive) {
+                QDirIterator dirs(m_path, QDir::Dirs | QDir::NoDotAndDotDot);
+                while (dirs.hasNext()) {
+                    subdirectories.append(dirs.next());
+                }
+            }
+        }
+
+        QMetaObject::invokeMethod(m_target, "onDirectoryListed", Qt::QueuedConnection,
+                                  Q_ARG(QString, m_path),
+                                  Q_ARG(bool, exists),
+                                  Q_ARG(QStringList, added),
+                                  Q_ARG(QStringList, removed),
+                                  Q_ARG(QStringList, renamedFrom),
+                                  Q_ARG(QStringList, renamedTo),
+                                  Q_ARG(QStringList, subdirectories),
+                                  Q_ARG(quint64, m_generation));
+    }
+
+private:
+    // A rename keeps size and mtime. A removed file that was never stat'ed
+    // can only be paired when it is the one change in the directory.
+    static void pairRenames(const QHash<QString, FolderWatcher::Signature> &signatures,
+                            QStringList &removed, QStringList &added,
+                            QStringList &renamedFrom, QStringList &renamedTo)
+    {
+        for (int i = removed.size() - 1; i >= 0; --i) {
+            if (!signatures.contains(removed[i])) {
+                continue;
+            }
+            FolderWatcher::Signature signature = signatures.value(removed[i]);
+            for (int j = 0; j < added.size(); ++j) {
+                if (signatures.value(added[j]) == signature) {
+                    renamedFrom.append(removed.takeAt(i));
+                    renamedTo.append(added.takeAt(j));
+                    break;
+                }
+            }
+        }
+        if (removed.size() == 1 && added.size() == 1 && !signatures.contains(removed.first())) {
+            renamedFrom.append(removed.takeFirst());
+            renamedTo.append(added.takeFirst());
+        }
+    }
+
+    QObject *m_target;
+    QString m_path;
+    QSet<QString> m_known;
+    QSharedPointer<FolderWatcher::Signatures> m_signatures;
+    bool m_recursive;
+    quint64 m_generation;
+};
+
+} // namespace
+
+FolderWatcher::FolderWatcher(QObject *parent)
+    : QObject(parent),
+      m_watcher(new QFileSystemWatcher(this)),
+      m_settleTimer(new QTimer(this)),
+      m_recursive(false),
+      m_signatures(new Signatures),
+      m_generation(0)
+{
+    m_pool.setMaxThreadCount(1);
+
+    m_settleTimer->setSingleShot(true);
+    m_settleTimer->setInterval(SettleIntervalMs);
+
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &FolderWatcher::onDirectoryChanged);
+    connect(m_settleTimer, &QTimer::timeout, this, &FolderWatcher::listChangedDirectories);
+}
+
+FolderWatcher::~FolderWatcher()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void FolderWatcher::start(const QString &folderPath, bool recursive,
+                          const QStringList &directories, const QStringList &files)
+{
+    stop();
+
+    m_rootPath = QDir(folderPath).absolutePath();
+    m_recursive = recursive;
+
+    for (const QString &directory : directories) {
+        m_names.insert(directory, QSet<QString>());
+    }
+    for (const QString &path : files) {
+        int slash = path.lastIndexOf('/');
+        m_names[path.left(slash)].insert(path.mid(slash + 1));
+    }
+
+    QStringList failed = m_watcher->addPaths(m_names.keys());
+    if (!failed.isEmpty()) {
+        // Typically the inotify watch limit (fs.inotify.max_user_watches)
+        qWarning() << "Cannot watch" << failed.size() << "folders; new images there will not be picked up";
+    }
+}
+
+void FolderWatcher::stop()
+{
+    m_generation++;
+    m_pool.clear();
+    m_settleTimer->stop();
+
+    QStringList watched = m_watcher->directories();
+    if (!watched.isEmpty()) {
+        m_watcher->removePaths(watched);
+    }
+
+    m_rootPath.clear();
+    m_names.clear();
+    m_changed.clear();
+    m_listing.clear();
+    m_signatures.reset(new Signatures);
+}
+
+void FolderWatcher::onDirectoryChanged(const QString &path)
+{
+    // Copying a batch of files fires many notifications; list once it settles
+    m_changed.insert(path);
+    m_settleTimer->start();
+}
+
+void FolderWatcher::listChangedDirectories()
+{
+    QSet<QString> pending;
+    for (const QString &path : m_changed) {
+        // A directory already being listed is listed again once that is done
+        if (m_listing.contains(path)) {
+            pending.insert(path);
+            continue;
+        }
+        m_listing.insert(path);
+        m_pool.start(new ListDirectoryTask(this, path, m_names.value(path), m_signatures,
+                                           m_recursive, m_generation));
+    }
+    m_changed = pending;
+}
+
+void FolderWatcher::onDirectoryListed(const QString &path, bool exists,
+                                      const QStringList &added, const QStringList &removed,
+                                      const QStringList &renamedFrom, const QStringList &renamedTo,
+                                      const QStringList &subdirectories, quint64 generation)
+{
+    if (generation != m_generation) {
+        return;
+    }
+    m_listing.remove(path);
+
+    QStringList addedPaths;
+    QStringList removedPaths;
+    QStringList renamedFromPaths;
+    QStringList renamedToPaths;
+
+    if (!exists) {
+        forgetDirectory(path, removedPaths);
+    } else {
+        QSet<QString> &names = m_names[path];
+        for (const QString &name : removed) {
+            names.remove(name);
+            removedPaths.append(path + "/" + name);
+        }
+        for (const QString &name : added) {
+            names.insert(name);
+            addedPaths.append(path + "/" + name);
+        }
+        for (int i = 0; i < renamedFrom.size(); ++i) {
+            names.remove(renamedFrom[i]);
+            names.insert(renamedTo[i]);
+            renamedFromPaths.append(path + "/" + renamedFrom[i]);
+            renamedToPaths.append(path + "/" + renamedTo[i]);
+        }
+
+        // New subfolders are listed like any changed directory, which
+        // reports all of their images as added
+        for (const QString &subdirectory : subdirectories) {
+            if (!m_names.contains(subdirectory)) {
+                watchDirectory(subdirectory);
+                m_changed.insert(subdirectory);
+            }
+        }
+    }
+
+    if (!m_changed.isEmpty()) {
+        m_settleTimer->start();
+    }
+
+    if (!renamedFromPaths.isEmpty()) {
+        emit filesRenamed(renamedFromPaths, renamedToPaths);
+    }
+    if (!addedPaths.isEmpty() || !removedPaths.isEmpty()) {
+        emit filesChanged(addedPaths, removedPaths);
+    }
+}
+
+void FolderWatcher::watchDirectory(const QString &path)
+{
+    m_names.insert(path, QSet<QString>());
+    if (!m_watcher->addPath(path)) {
+        qWarning() << "Cannot watch folder:" << path;
+    }
+}
+
+void FolderWatcher::forgetDirectory(const QString &path, QStringList &removed)
+{
+    // A deleted or moved-away directory takes its subfolders with it
+    QString prefix = path + "/";
+    QStringList directories;
+    for (auto it = m_names.constBegin(); it != m_names.constEnd(); ++it) {
+        if (it.key() == path || it.key().startsWith(prefix)) {
+            directories.append(it.key());
+        }
+    }
+
+    QMutexLocker locker(&m_signatures->mutex);
+    for (const QString &directory : directories) {
+        for (const QString &name : m_names.value(directory)) {
+            removed.append(directory + "/" + name);
+        }
+        m_signatures->directories.remove(directory);
+        m_names.remove(directory);
+        m_changed.remove(directory);
+        m_watcher->removePath(directory);
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef FOLDERWATCHER_H
+#define FOLDERWATCHER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QThreadPool>
+#include <QStringList>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QSet>
+#include <QSharedPointer>
+#include <QTimer>
+
+/**
+ * @brief Reports images added to or removed from a folder while it is open
+ *
+ * Watches every directory of the source folder with QFileSystemWatcher
+ * (inotify on Linux, FSEvents/kqueue on macOS, ReadDirectoryChangesW on
+ * Windows). Change notifications are collected for a short moment, then only
+ * the affected directories are listed again on a worker thread and compared
+ * with the file names known so far.
+ *
+ * Renames within a directory are reported separately, so the queue can keep
+ * the entry: a removed file is paired with an added one of the same size and
+ * mtime, both taken with a stat when the directory is listed. Files of a
+ * directory that has not changed since start() have not been stat'ed yet;
+ * there a single removal and a single addition are paired.
+ *
+ * New subfolders are watched and reported when watching recursively.
+ */
+class FolderWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FolderWatcher(QObject *parent = nullptr);
+    ~FolderWatcher();
+
+    // Watch directories (absolute paths below folderPath, including itself);
+    // files are the images that are already queued
+    void start(const QString &folderPath, bool recursive,
+               const QStringList &directories, const QStringList &files);
+    void stop();
+    bool isActive() const { return !m_rootPath.isEmpty(); }
+
+    // Size and mtime of a file
+    typedef QPair<qint64, qint64> Signature;
+
+    // Signatures of the files of listed directories, shared with the worker
+    struct Signatures {
+        QMutex mutex;
+        QHash<QString, QHash<QString, Signature>> directories;   // Directory -> file name -> signature
+    };
+
+signals:
+    // renamedFrom[i] now is renamedTo[i]; emitted before filesChanged()
+    void filesRenamed(const QStringList &renamedFrom, const QStringList &renamedTo);
+    void filesChanged(const QStringList &added, const QStringList &removed);
+
+private slots:
+    void onDirectoryChanged(const QString &path);
+    void listChangedDirectories();
+    void onDirectoryListed(const QString &path, bool exists,
+                           const QStringList &added, const QStringList &removed,
+                           const QStringList &renamedFrom, const QStringList &renamedTo,
+                           const QStringList &subdirectories, quint64 generation);
+
+private:
+    void watchDirectory(const QString &path);
+    void forgetDirectory(const QString &path, QStringList &removed);
+
+    QFileSystemWatcher *m_watcher;
+    QThreadPool m_pool;
+    QTimer *m_settleTimer;                   // Collects bursts of notifications
+    QString m_rootPath;
+    bool m_recursive;
+    QHash<QString, QSet<QString>> m_names;   // Directory -> image file names in it
+    QSet<QString> m_changed;                 // Directories waiting to be listed
+    QSet<QString> m_listing;                 // Directories being listed right now
+    QSharedPointer<Signatures> m_signatures; // Replaced on stop()
+    quint64 m_generation;                    // Bumped on stop() to discard stale listings
+};
+
+#endif // FOLDERWATCHER_H
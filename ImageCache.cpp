@@ -0,0 +1,149 @@
+#include "ImageCache.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+
+ImageCache &ImageCache::instance()
+{
+    static ImageCache cache;
+    return cache;
+}
+
+ImageCache::ImageCache()
+    : m_budgetBytes(512LL * 1024 * 1024),
+      m_bytes(0),
+      m_hits(0),
+      m_misses(0),
+      m_evictions(0)
+{
+}
+
+void ImageCache::setBudgetMB(int megabytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_budgetBytes = static_cast<qint64>(qMax(0, megabytes)) * 1024 * 1024;
+    evictToBudget();
+}
+
+int ImageCache::budgetMB() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_budgetBytes / (1024 * 1024));
+}
+
+QString ImageCache::makeKey(const QString &path, const QSize &targetSize)
+{
+    QFileInfo fileInfo(path);
+    return QString("%1|%2|%3x%4")
+        .arg(fileInfo.absoluteFilePath())
+        .arg(fileInfo.lastModified().toMSecsSinceEpoch())
+        .arg(targetSize.width())
+        .arg(targetSize.height());
+}
+
+QImage ImageCache::find(const QString &path, const QSize &targetSize, QSize *sourceSize)
+{
+    QString key = makeKey(path, targetSize);
+
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, EntryList::iterator>::iterator it = m_index.find(key);
+    if (it == m_index.end()) {
+        m_misses++;
+        return QImage();
+    }
+
+    // Move to the front of the LRU list
+    m_entries.splice(m_entries.begin(), m_entries, it.value());
+    m_hits++;
+    if (sourceSize) {
+        *sourceSize = m_entries.front().sourceSize;
+    }
+    return m_entries.front().image;
+}
+
+bool ImageCache::contains(const QString &path, const QSize &targetSize) const
+{
+    QString key = makeKey(path, targetSize);
+
+    QMutexLocker locker(&m_mutex);
+    return m_index.contains(key);
+}
+
+void ImageCache::insert(const QString &path, const QSize &targetSize, const QImage &image,
+                        const QSize &sourceSize)
+{
+    if (image.isNull()) {
+        return;
+    }
+
+    QString key = makeKey(path, targetSize);
+    qint64 bytes = static_cast<qint64>(image.bytesPerLine()) * image.height();
+
+    QMutexLocker locker(&m_mutex);
+
+    // An image larger than the whole budget would just evict everything
+    if (bytes > m_budgetBytes) {
+        return;
+    }
+
+    QHash<QString, EntryList::iterator>::iterator it = m_index.find(key);
+    if (it != m_index.end()) {
+        m_bytes -= it.value()->bytes;
+        m_entries.erase(it.value());
+        m_index.erase(it);
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.image = image;
+    entry.sourceSize = sourceSize.isValid() ? sourceSize : image.size();
+    entry.bytes = bytes;
+    m_entries.push_front(entry);
+    m_index.insert(key, m_entries.begin());
+    m_bytes += bytes;
+
+    evictToBudget();
+}
+
+void ImageCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    m_index.clear();
+    m_bytes = 0;
+}
+
+void ImageCache::evictToBudget()
+{
+    while (m_bytes > m_budgetBytes && !m_entries.empty()) {
+        const Entry &oldest = m_entries.back();
+        m_bytes -= oldest.bytes;
+        m_index.remove(oldest.key);
+        m_entries.pop_back();
+        m_evictions++;
+    }
+}
+
+ImageCache::Statistics ImageCache::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    Statistics stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.evictions = m_evictions;
+    stats.bytes = m_bytes;
+    stats.entries = static_cast<int>(m_entries.size());
+    return stats;
+}
+
+QString ImageCache::statisticsText() const
+{
+    Statistics stats = statistics();
+    qint64 lookups = stats.hits + stats.misses;
+    qint64 percent = lookups > 0 ? (stats.hits * 100) / lookups : 0;
+    return QString("Cache: %1 images, %2 MB, %3% hits, %4 evicted")
+        .arg(stats.entries)
+        .arg(stats.bytes / (1024 * 1024))
+        .arg(percent)
+        .arg(stats.evictions);
+}
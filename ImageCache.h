@@ -0,0 +1,73 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <QImage>
+#include <QHash>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <list>
+
+/**
+ * @brief Process-wide, byte-budgeted LRU cache of decoded images
+ *
+ * Entries are keyed by file path, modification time and the size the image
+ * was decoded at, so an edited file or a different decode size never returns
+ * a stale image. The cache is thread-safe; prefetch workers insert into it
+ * while the GUI thread reads from it.
+ */
+class ImageCache
+{
+public:
+    struct Statistics {
+        qint64 hits;
+        qint64 misses;
+        qint64 evictions;
+        qint64 bytes;
+        int entries;
+    };
+
+    static ImageCache &instance();
+
+    // Memory budget for all cached images, in megabytes
+    void setBudgetMB(int megabytes);
+    int budgetMB() const;
+
+    // Look up an image decoded from path at targetSize (invalid = full size).
+    // sourceSize receives the full-resolution size recorded on insert.
+    QImage find(const QString &path, const QSize &targetSize = QSize(),
+                QSize *sourceSize = nullptr);
+    bool contains(const QString &path, const QSize &targetSize = QSize()) const;
+    void insert(const QString &path, const QSize &targetSize, const QImage &image,
+                const QSize &sourceSize = QSize());
+    void clear();
+
+    Statistics statistics() const;
+    QString statisticsText() const;
+
+private:
+    ImageCache();
+    Q_DISABLE_COPY(ImageCache)
+
+    struct Entry {
+        QString key;
+        QImage image;
+        QSize sourceSize;
+        qint64 bytes;
+    };
+    typedef std::list<Entry> EntryList;
+
+    static QString makeKey(const QString &path, const QSize &targetSize);
+    void evictToBudget();
+
+    mutable QMutex m_mutex;
+    EntryList m_entries;                          // Most recently used first
+    QHash<QString, EntryList::iterator> m_index;  // Key -> position in m_entries
+    qint64 m_budgetBytes;
+    qint64 m_bytes;
+    qint64 m_hits;
+    qint64 m_misses;
+    qint64 m_evictions;
+};
+
+#endif // IMAGECACHE_H
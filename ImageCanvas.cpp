@@ -2,41 +2,92 @@
 #include <QPainter>
 #include <QMouseEvent>
 #include <QKeyEvent>
+#include <QWheelEvent>
+#include <cmath>
 #include <QPen>
 #include <QFont>
 
 ImageCanvas::ImageCanvas(QWidget *parent)
     : QWidget(parent),
       m_state(Idle),
+      m_pyramid(new ImagePyramid(this)),
       m_scale(1.0),
+      m_zoom(1.0),
+      m_previewQuality(false),
+      m_refineTimer(new QTimer(this)),
       m_selectedBoxIndex(-1),
       m_resizingCorner(BoundingBox::None)
 {
     setFocusPolicy(Qt::StrongFocus);
     setMouseTracking(true);
     setMinimumSize(400, 300);
+    
+    // Repaint as soon as a better matching pyramid level becomes available
+    connect(m_pyramid, &ImagePyramid::levelReady, this, [this]() { update(); });
+    
+    m_refineTimer->setSingleShot(true);
+    m_refineTimer->setInterval(200);
+    connect(m_refineTimer, &QTimer::timeout, this, [this]() {
+        m_previewQuality = false;
+        update();
+    });
 }
 
 ImageCanvas::~ImageCanvas()
 {
 }
 
-void ImageCanvas::setImage(const QPixmap &pixmap)
+void ImageCanvas::setImage(const QImage &image, const QString &sourcePath)
 {
-    m_originalPixmap = pixmap;
+    m_pyramid->setImage(image, sourcePath);
+    m_imageSize = image.size();
+    m_zoom = 1.0;
     updateScaledImage();
     clearBoundingBoxes();
     update();
 }
 
+void ImageCanvas::setImage(const QPixmap &pixmap)
+{
+    setImage(pixmap.toImage());
+}
+
 void ImageCanvas::clearImage()
 {
-    m_originalPixmap = QPixmap();
-    m_scaledPixmap = QPixmap();
+    m_pyramid->clear();
+    m_imageSize = QSize();
+    m_zoom = 1.0;
     clearBoundingBoxes();
     update();
 }
 
+void ImageCanvas::setZoom(double zoom, const QPoint &anchor)
+{
+    if (m_imageSize.isEmpty() || m_scale <= 0) {
+        return;
+    }
+    
+    // Keep the image point under the anchor fixed while zooming
+    double imageX = (anchor.x() - m_imageRect.x()) / m_scale;
+    double imageY = (anchor.y() - m_imageRect.y()) / m_scale;
+    
+    m_zoom = qBound(1.0, zoom, 64.0);
+    updateScaledImage();
+    
+    if (m_zoom > 1.0) {
+        m_imageRect.moveTo(static_cast<int>(anchor.x() - imageX * m_scale),
+                           static_cast<int>(anchor.y() - imageY * m_scale));
+    }
+    update();
+}
+
+void ImageCanvas::resetZoom()
+{
+    m_zoom = 1.0;
+    updateScaledImage();
+    update();
+}
+
 void ImageCanvas::addBoundingBox(const BoundingBox &box)
 {
     m_boundingBoxes.append(box);
@@ -89,7 +140,7 @@ void ImageCanvas::clearSelection()
 
 void ImageCanvas::updateScaledImage()
 {
-    if (m_originalPixmap.isNull()) {
+    if (m_imageSize.isEmpty()) {
         return;
     }
     
@@ -97,16 +148,18 @@ void ImageCanvas::updateScaledImage()
     int availableWidth = width() - 20;
     int availableHeight = height() - 20;
     
-    double scaleX = static_cast<double>(availableWidth) / m_originalPixmap.width();
-    double scaleY = static_cast<double>(availableHeight) / m_originalPixmap.height();
-    m_scale = qMin(scaleX, scaleY);
+    double scaleX = static_cast<double>(availableWidth) / m_imageSize.width();
+    double scaleY = static_cast<double>(availableHeight) / m_imageSize.height();
+    m_scale = qMin(scaleX, scaleY) * m_zoom;
     
-    int scaledWidth = static_cast<int>(m_originalPixmap.width() * m_scale);
-    int scaledHeight = static_cast<int>(m_originalPixmap.height() * m_scale);
+    int scaledWidth = static_cast<int>(m_imageSize.width() * m_scale);
+    int scaledHeight = static_cast<int>(m_imageSize.height() * m_scale);
     
-    m_scaledPixmap = m_originalPixmap.scaled(scaledWidth, scaledHeight,
-                                             Qt::KeepAspectRatio,
-                                             Qt::SmoothTransformation);
+    if (m_zoom > 1.0) {
+        // Zoomed in: keep the current pan position
+        m_imageRect = QRect(m_imageRect.topLeft(), QSize(scaledWidth, scaledHeight));
+        return;
+    }
     
     // Center the image
     int x = (width() - scaledWidth) / 2;
@@ -186,14 +239,14 @@ void ImageCanvas::paintEvent(QPaintEvent *event)
     QPainter painter(this);
     painter.fillRect(rect(), QColor(240, 240, 240));
     
-    if (m_scaledPixmap.isNull()) {
+    if (m_pyramid->isNull()) {
         painter.setPen(Qt::gray);
         painter.drawText(rect(), Qt::AlignCenter, "No image loaded");
         return;
     }
     
-    // Draw the image
-    painter.drawPixmap(m_imageRect, m_scaledPixmap);
+    // Draw the visible part of the image
+    drawImageTiles(painter);
     
     // Draw existing bounding boxes
     drawBoundingBoxes(painter);
@@ -206,6 +259,56 @@ void ImageCanvas::paintEvent(QPaintEvent *event)
     }
 }
 
+void ImageCanvas::drawImageTiles(QPainter &painter)
+{
+    int levelIndex = m_pyramid->levelForScale(m_scale);
+    if (levelIndex < 0) {
+        painter.setPen(Qt::gray);
+        painter.drawText(rect(), Qt::AlignCenter, "Preparing image...");
+        return;
+    }
+    
+    QRect visible = m_imageRect.intersected(rect());
+    if (visible.isEmpty()) {
+        return;
+    }
+    
+    // Screen pixels per pixel of the chosen level
+    QImage level = m_pyramid->level(levelIndex);
+    double drawScale = m_scale / m_pyramid->levelScale(levelIndex);
+    const int tileSize = ImagePyramid::TileSize;
+    
+    // Visible area in level coordinates, expanded to whole tiles
+    int left = static_cast<int>(std::floor((visible.left() - m_imageRect.x()) / drawScale));
+    int top = static_cast<int>(std::floor((visible.top() - m_imageRect.y()) / drawScale));
+    int right = static_cast<int>(std::ceil((visible.right() + 1 - m_imageRect.x()) / drawScale));
+    int bottom = static_cast<int>(std::ceil((visible.bottom() + 1 - m_imageRect.y()) / drawScale));
+    
+    int firstTileX = qMax(0, left / tileSize);
+    int firstTileY = qMax(0, top / tileSize);
+    int lastTileX = qMin((level.width() - 1) / tileSize, (right - 1) / tileSize);
+    int lastTileY = qMin((level.height() - 1) / tileSize, (bottom - 1) / tileSize);
+    
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, drawScale < 1.0 && !m_previewQuality);
+    
+    for (int ty = firstTileY; ty <= lastTileY; ++ty) {
+        for (int tx = firstTileX; tx <= lastTileX; ++tx) {
+            QPixmap tile = m_pyramid->tile(levelIndex, tx, ty);
+            if (tile.isNull()) {
+                continue;
+            }
+            
+            QRectF target(m_imageRect.x() + tx * tileSize * drawScale,
+                          m_imageRect.y() + ty * tileSize * drawScale,
+                          tile.width() * drawScale,
+                          tile.height() * drawScale);
+            painter.drawPixmap(target, tile, QRectF(tile.rect()));
+        }
+    }
+    
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+}
+
 void ImageCanvas::drawBoundingBoxes(QPainter &painter)
 {
     for (int i = 0; i < m_boundingBoxes.size(); ++i) {
@@ -261,7 +364,15 @@ void ImageCanvas::drawBoundingBoxes(QPainter &painter)
 
 void ImageCanvas::mousePressEvent(QMouseEvent *event)
 {
-    if (m_originalPixmap.isNull()) {
+    if (m_imageSize.isEmpty()) {
+        return;
+    }
+    
+    // Middle or right drag pans the zoomed image
+    if (event->button() == Qt::MiddleButton || event->button() == Qt::RightButton) {
+        m_state = Panning;
+        m_panStart = event->pos();
+        setCursor(Qt::ClosedHandCursor);
         return;
     }
     
@@ -309,12 +420,19 @@ void ImageCanvas::mousePressEvent(QMouseEvent *event)
 
 void ImageCanvas::mouseMoveEvent(QMouseEvent *event)
 {
-    if (m_originalPixmap.isNull()) {
+    if (m_imageSize.isEmpty()) {
         return;
     }
     
     QPoint currentPos = event->pos();
     
+    if (m_state == Panning) {
+        m_imageRect.translate(currentPos - m_panStart);
+        m_panStart = currentPos;
+        update();
+        return;
+    }
+    
     if (!m_imageRect.contains(currentPos)) {
         return;
     }
@@ -363,6 +481,13 @@ void ImageCanvas::mouseMoveEvent(QMouseEvent *event)
 
 void ImageCanvas::mouseReleaseEvent(QMouseEvent *event)
 {
+    if (m_state == Panning &&
+        (event->button() == Qt::MiddleButton || event->button() == Qt::RightButton)) {
+        m_state = Idle;
+        unsetCursor();
+        return;
+    }
+    
     if (event->button() != Qt::LeftButton) {
         return;
     }
@@ -386,14 +511,37 @@ void ImageCanvas::keyPressEvent(QKeyEvent *event)
         if (m_selectedBoxIndex >= 0) {
             removeBoundingBox(m_selectedBoxIndex);
         }
+    } else if (event->key() == Qt::Key_Plus || event->key() == Qt::Key_Equal) {
+        setZoom(m_zoom * 1.25, rect().center());
+    } else if (event->key() == Qt::Key_Minus) {
+        setZoom(m_zoom / 1.25, rect().center());
+    } else if (event->key() == Qt::Key_0) {
+        resetZoom();
     }
     
     QWidget::keyPressEvent(event);
 }
 
+void ImageCanvas::wheelEvent(QWheelEvent *event)
+{
+    if (m_imageSize.isEmpty()) {
+        QWidget::wheelEvent(event);
+        return;
+    }
+    
+    double factor = event->angleDelta().y() > 0 ? 1.25 : 1.0 / 1.25;
+    setZoom(m_zoom * factor, event->pos());
+    event->accept();
+}
+
 void ImageCanvas::resizeEvent(QResizeEvent *event)
 {
     Q_UNUSED(event);
+    
+    // Cheap unfiltered rendering while resizing, smooth once it settles
+    m_previewQuality = true;
+    m_refineTimer->start();
+    
     updateScaledImage();
     update();
 }
@@ -2,10 +2,13 @@
 #define IMAGECANVAS_H
 
 #include "BoundingBox.h"
+#include "ImagePyramid.h"
 #include <QWidget>
+#include <QImage>
 #include <QPixmap>
 #include <QList>
 #include <QPoint>
+#include <QTimer>
 
 /**
  * @brief Custom widget for displaying images and drawing bounding boxes
@@ -15,6 +18,11 @@
  * - Selecting existing bounding boxes (click)
  * - Resizing bounding boxes (drag corners)
  * - Deleting bounding boxes (delete key)
+ * - Zooming (mouse wheel, +/-, 0 to fit) and panning (middle/right drag)
+ *
+ * The image is rendered from an ImagePyramid, so only the tiles visible in
+ * the viewport are uploaded. Bounding boxes are always kept in
+ * full-resolution image coordinates.
  */
 class ImageCanvas : public QWidget
 {
@@ -25,10 +33,16 @@ public:
     ~ImageCanvas();
     
     // Image management
+    void setImage(const QImage &image, const QString &sourcePath = QString());
     void setImage(const QPixmap &pixmap);
-    QPixmap image() const { return m_originalPixmap; }
+    QImage image() const { return m_pyramid->level(0); }
     void clearImage();
     
+    // View management
+    double zoom() const { return m_zoom; }
+    void setZoom(double zoom, const QPoint &anchor);
+    void resetZoom();
+    
     // Bounding box management
     void addBoundingBox(const BoundingBox &box);
     void removeBoundingBox(int index);
@@ -42,8 +56,8 @@ public:
     void clearSelection();
     
     // Get image dimensions (original, not scaled)
-    int imageWidth() const { return m_originalPixmap.width(); }
-    int imageHeight() const { return m_originalPixmap.height(); }
+    int imageWidth() const { return m_imageSize.width(); }
+    int imageHeight() const { return m_imageSize.height(); }
 
 signals:
     void boundingBoxCreated(const QRect &rect);
@@ -57,6 +71,7 @@ protected:
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
 
 private:
@@ -65,7 +80,8 @@ private:
         Idle,
         Drawing,
         Resizing,
-        Moving
+        Moving,
+        Panning
     };
     
     DrawingState m_state;
@@ -74,10 +90,14 @@ private:
     QRect m_currentRect;
     
     // Image data
-    QPixmap m_originalPixmap;
-    QPixmap m_scaledPixmap;
+    ImagePyramid *m_pyramid;
+    QSize m_imageSize;  // Full-resolution image size
     QRect m_imageRect;  // Rectangle where the scaled image is drawn
     double m_scale;     // Scale factor from original to displayed image
+    double m_zoom;      // Zoom relative to fit-to-window (1.0 = fit)
+    QPoint m_panStart;  // Last mouse position while panning
+    bool m_previewQuality;   // Skip smooth filtering while the widget is resizing
+    QTimer *m_refineTimer;   // Switches back to smooth filtering after a resize
     
     // Bounding boxes
     QList<BoundingBox> m_boundingBoxes;
@@ -86,6 +106,7 @@ private:
     
     // Helper methods
     void updateScaledImage();
+    void drawImageTiles(QPainter &painter);
     QPoint screenToImage(const QPoint &screenPoint) const;
     QPoint imageToScreen(const QPoint &imagePoint) const;
     QRect imageToScreen(const QRect &imageRect) const;
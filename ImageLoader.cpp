@@ -0,0 +1,60 @@
+#include "ImageLoader.h"
+#include "ImageCache.h"
+#include <QImageReader>
+
+QImage ImageLoader::read(const QString &path, const QSize &boundingSize, QSize *sourceSize)
+{
+    QImageReader reader(path);
+    QSize fullSize = reader.size();
+
+    if (sourceSize) {
+        *sourceSize = fullSize;
+    }
+
+    // Only ask the codec to scale when it actually reduces the image; the
+    // JPEG plugin then picks the largest DCT scale factor that still covers
+    // the requested size and smooth-scales the (much smaller) remainder.
+    if (boundingSize.isValid() && fullSize.isValid() &&
+        (fullSize.width() > boundingSize.width() || fullSize.height() > boundingSize.height())) {
+        QSize targetSize = fullSize.scaled(boundingSize, Qt::KeepAspectRatio);
+        reader.setScaledSize(targetSize.expandedTo(QSize(1, 1)));
+    }
+
+    QImage image = reader.read();
+
+    // Some formats don't report a size until the image is read
+    if (sourceSize && !sourceSize->isValid() && !image.isNull()) {
+        *sourceSize = image.size();
+    }
+
+    return image;
+}
+
+QImage ImageLoader::readCached(const QString &path, const QSize &boundingSize, QSize *sourceSize,
+                               bool *cached)
+{
+    ImageCache &cache = ImageCache::instance();
+
+    QImage image = cache.find(path, boundingSize, sourceSize);
+    if (cached) {
+        *cached = !image.isNull();
+    }
+    if (!image.isNull()) {
+        return image;
+    }
+
+    QSize fullSize;
+    image = read(path, boundingSize, &fullSize);
+    cache.insert(path, boundingSize, image, fullSize);
+
+    if (sourceSize) {
+        *sourceSize = fullSize;
+    }
+    return image;
+}
+
+QSize ImageLoader::imageSize(const QString &path)
+{
+    QImageReader reader(path);
+    return reader.size();
+}
@@ -0,0 +1,37 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+/**
+ * @brief Image decoding helpers shared by both annotation modes
+ *
+ * Wraps QImageReader so that images can be decoded directly at the size
+ * they will be displayed at. For JPEG this lets libjpeg downscale in the
+ * DCT domain (1/2, 1/4, 1/8), which avoids materializing the full
+ * resolution bitmap at all.
+ */
+class ImageLoader
+{
+public:
+    // Decode an image. If boundingSize is valid and smaller than the image,
+    // the image is decoded scaled to fit inside it (keeping aspect ratio).
+    // sourceSize receives the full-resolution dimensions from the header.
+    static QImage read(const QString &path,
+                       const QSize &boundingSize = QSize(),
+                       QSize *sourceSize = nullptr);
+
+    // Same as read(), but served from and stored into the shared ImageCache.
+    // cached (if given) tells whether the image came from the cache.
+    static QImage readCached(const QString &path,
+                             const QSize &boundingSize = QSize(),
+                             QSize *sourceSize = nullptr,
+                             bool *cached = nullptr);
+
+    // Read the pixel dimensions from the image header without decoding
+    static QSize imageSize(const QString &path);
+};
+
+#endif // IMAGELOADER_H
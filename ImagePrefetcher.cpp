@@ -0,0 +1,141 @@
+#include "ImagePrefetcher.h"
+#include "ImageLoader.h"
+#include "ImageCache.h"
+#include <QRunnable>
+#include <QThread>
+#include <QMetaObject>
+
+namespace {
+
+// Decodes a single image into the shared cache on a pool thread
+class PrefetchTask : public QRunnable
+{
+public:
+    PrefetchTask(QObject *target, const QString &path, const QSize &targetSize, quint64 generation)
+        : m_target(target), m_path(path), m_targetSize(targetSize), m_generation(generation)
+    {
+    }
+
+    void run() override
+    {
+        ImageLoader::readCached(m_path, m_targetSize);
+
+        QMetaObject::invokeMethod(m_target, "onImageDecoded", Qt::QueuedConnection,
+                                  Q_ARG(QString, m_path),
+                                  Q_ARG(quint64, m_generation));
+    }
+
+private:
+    QObject *m_target;
+    QString m_path;
+    QSize m_targetSize;
+    quint64 m_generation;
+};
+
+} // namespace
+
+ImagePrefetcher::ImagePrefetcher(QObject *parent)
+    : QObject(parent),
+      m_generation(0),
+      m_ahead(3),
+      m_behind(1),
+      m_hits(0),
+      m_misses(0)
+{
+    // Decoding is memory-bound; a couple of threads is enough to stay ahead
+    // of the user without starving the GUI thread.
+    m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 3));
+}
+
+ImagePrefetcher::~ImagePrefetcher()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void ImagePrefetcher::setLookahead(int ahead, int behind)
+{
+    m_ahead = qMax(0, ahead);
+    m_behind = qMax(0, behind);
+}
+
+void ImagePrefetcher::setTargetSize(const QSize &size)
+{
+    if (size == m_targetSize) {
+        return;
+    }
+
+    // Queued decodes are for the old size
+    m_targetSize = size;
+    clear();
+}
+
+void ImagePrefetcher::prefetchAround(const QStringList &files, int index)
+{
+    if (index < 0 || index >= files.size()) {
+        return;
+    }
+
+    // Build the window nearest-first so the next image gets decoded before
+    // the ones further away.
+    QStringList order;
+    for (int step = 1; step <= qMax(m_ahead, m_behind); ++step) {
+        if (step <= m_ahead && index + step < files.size()) {
+            order.append(files[index + step]);
+        }
+        if (step <= m_behind && index - step >= 0) {
+            order.append(files[index - step]);
+        }
+    }
+
+    // Forget queued work for images the user has moved away from
+    m_pool.clear();
+    m_pending.clear();
+
+    ImageCache &cache = ImageCache::instance();
+    int priority = order.size();
+    for (const QString &path : order) {
+        if (!cache.contains(path, m_targetSize)) {
+            m_pending.insert(path);
+            m_pool.start(new PrefetchTask(this, path, m_targetSize, m_generation), priority);
+        }
+        --priority;
+    }
+}
+
+QImage ImagePrefetcher::load(const QString &path, QSize *sourceSize)
+{
+    // One cache lookup, so the shared cache counts each miss only once
+    bool cached = false;
+    QImage image = ImageLoader::readCached(path, m_targetSize, sourceSize, &cached);
+    if (cached) {
+        m_hits++;
+    } else {
+        m_misses++;
+    }
+    return image;
+}
+
+void ImagePrefetcher::clear()
+{
+    m_pool.clear();
+    m_generation++;
+    m_pending.clear();
+}
+
+QString ImagePrefetcher::statisticsText() const
+{
+    int total = m_hits + m_misses;
+    int percent = total > 0 ? (m_hits * 100) / total : 0;
+    return QString("Prefetch hits: %1/%2 (%3%)").arg(m_hits).arg(total).arg(percent);
+}
+
+void ImagePrefetcher::onImageDecoded(const QString &path, quint64 generation)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    m_pending.remove(path);
+    emit imageReady(path);
+}
@@ -0,0 +1,67 @@
+#ifndef IMAGEPREFETCHER_H
+#define IMAGEPREFETCHER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QStringList>
+#include <QSet>
+#include <QImage>
+#include <QSize>
+
+/**
+ * @brief Decodes the images around the current queue position in the background
+ *
+ * A small worker pool decodes the next N and previous M entries of the image
+ * queue into the shared ImageCache. The GUI thread is notified as each image
+ * becomes ready and picks it up from the cache, so navigation can show it
+ * without touching the disk. Images can optionally be decoded at display
+ * size via ImageLoader.
+ */
+class ImagePrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImagePrefetcher(QObject *parent = nullptr);
+    ~ImagePrefetcher();
+
+    // Number of images to keep decoded ahead of and behind the current one
+    void setLookahead(int ahead, int behind);
+
+    // Decode images scaled to fit inside size (invalid size = full resolution)
+    void setTargetSize(const QSize &size);
+    QSize targetSize() const { return m_targetSize; }
+
+    // Schedule decoding of the neighbours of index
+    void prefetchAround(const QStringList &files, int index);
+
+    // Return the image for path at the target size. Prefetched images come
+    // from the cache; on a miss the image is decoded synchronously.
+    QImage load(const QString &path, QSize *sourceSize = nullptr);
+
+    // Ignore results still in flight
+    void clear();
+
+    // Hit/miss statistics of load()
+    int hits() const { return m_hits; }
+    int misses() const { return m_misses; }
+    QString statisticsText() const;
+
+signals:
+    void imageReady(const QString &path);
+
+private slots:
+    void onImageDecoded(const QString &path, quint64 generation);
+
+private:
+    QThreadPool m_pool;
+    QSet<QString> m_pending;           // Paths currently queued or decoding
+    QSize m_targetSize;                // Decode size passed to ImageLoader
+    quint64 m_generation;              // Bumped on clear() to discard stale results
+    int m_ahead;
+    int m_behind;
+    int m_hits;
+    int m_misses;
+};
+
+#endif // IMAGEPREFETCHER_H
@@ -0,0 +1,200 @@
+#include "ImagePyramid.h"
+#include "ImageCache.h"
+#include "ImageResampler.h"
+#include <QRunnable>
+#include <QMetaObject>
+
+namespace {
+
+int countLevels(const QSize &size)
+{
+    int levels = 1;
+    int width = size.width();
+    int height = size.height();
+    while (qMax(width, height) > ImagePyramid::TileSize) {
+        width = qMax(1, width / 2);
+        height = qMax(1, height / 2);
+        levels++;
+    }
+    return levels;
+}
+
+// Builds levels 1..n from level 0, posting each one back as soon as it exists
+class PyramidBuildTask : public QRunnable
+{
+public:
+    PyramidBuildTask(QObject *target, const QImage &source, const QString &sourcePath,
+                     QAtomicInt *currentGeneration, int generation)
+        : m_target(target), m_source(source), m_sourcePath(sourcePath),
+          m_currentGeneration(currentGeneration), m_generation(generation)
+    {
+    }
+
+    void run() override
+    {
+        QImage current = m_source;
+        int index = 0;
+
+        while (qMax(current.width(), current.height()) > ImagePyramid::TileSize) {
+            if (m_currentGeneration->load() != m_generation) {
+                return;
+            }
+
+            QSize levelSize(qMax(1, current.width() / 2), qMax(1, current.height() / 2));
+            QImage cached;
+            if (!m_sourcePath.isEmpty()) {
+                cached = ImageCache::instance().find(m_sourcePath, levelSize);
+            }
+
+            if (!cached.isNull()) {
+                current = cached;
+            } else {
+                current = ImageResampler::halve(current);
+                if (!m_sourcePath.isEmpty()) {
+                    ImageCache::instance().insert(m_sourcePath, levelSize, current, m_source.size());
+                }
+            }
+            index++;
+
+            QMetaObject::invokeMethod(m_target, "onLevelBuilt", Qt::QueuedConnection,
+                                      Q_ARG(int, index),
+                                      Q_ARG(QImage, current),
+                                      Q_ARG(int, m_generation));
+        }
+    }
+
+private:
+    QObject *m_target;
+    QImage m_source;
+    QString m_sourcePath;
+    QAtomicInt *m_currentGeneration;
+    int m_generation;
+};
+
+} // namespace
+
+ImagePyramid::ImagePyramid(QObject *parent)
+    : QObject(parent),
+      m_levelsTotal(0),
+      m_generation(0)
+{
+    m_pool.setMaxThreadCount(1);
+    setTileCacheSize(128);
+}
+
+ImagePyramid::~ImagePyramid()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void ImagePyramid::setImage(const QImage &image, const QString &sourcePath)
+{
+    clear();
+
+    if (image.isNull()) {
+        return;
+    }
+
+    m_levels.append(image);
+    m_imageSize = image.size();
+    m_levelsTotal = countLevels(m_imageSize);
+
+    if (m_levelsTotal > 1) {
+        m_pool.start(new PyramidBuildTask(this, image, sourcePath, &m_generation, m_generation.load()));
+    }
+}
+
+void ImagePyramid::clear()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_levels.clear();
+    m_tiles.clear();
+    m_imageSize = QSize();
+    m_levelsTotal = 0;
+}
+
+QImage ImagePyramid::level(int index) const
+{
+    if (index < 0 || index >= m_levels.size()) {
+        return QImage();
+    }
+    return m_levels[index];
+}
+
+double ImagePyramid::levelScale(int index) const
+{
+    if (index < 0 || index >= m_levels.size() || m_imageSize.width() <= 0) {
+        return 1.0;
+    }
+    return static_cast<double>(m_levels[index].width()) / m_imageSize.width();
+}
+
+int ImagePyramid::levelForScale(double scale) const
+{
+    if (m_levels.isEmpty()) {
+        return -1;
+    }
+
+    // Coarsest level that still has at least one source pixel per screen pixel
+    int wanted = 0;
+    double levelFactor = 0.5;
+    while (wanted + 1 < m_levelsTotal && levelFactor >= scale) {
+        wanted++;
+        levelFactor /= 2.0;
+    }
+
+    if (wanted < m_levels.size()) {
+        return wanted;
+    }
+
+    // Not built yet. A level up to 4x finer per axis is still cheap enough to
+    // draw; anything finer would upload far too many tiles, so wait instead.
+    int available = m_levels.size() - 1;
+    return (wanted - available <= 2) ? available : -1;
+}
+
+QPixmap ImagePyramid::tile(int levelIndex, int tx, int ty)
+{
+    if (levelIndex < 0 || levelIndex >= m_levels.size()) {
+        return QPixmap();
+    }
+
+    quint64 key = (static_cast<quint64>(levelIndex) << 48) |
+                  (static_cast<quint64>(ty) << 24) |
+                  static_cast<quint64>(tx);
+
+    QPixmap *cached = m_tiles.object(key);
+    if (cached) {
+        return *cached;
+    }
+
+    const QImage &source = m_levels[levelIndex];
+    QRect tileRect = QRect(tx * TileSize, ty * TileSize, TileSize, TileSize).intersected(source.rect());
+    if (tileRect.isEmpty()) {
+        return QPixmap();
+    }
+
+    QPixmap pixmap = QPixmap::fromImage(source.copy(tileRect));
+    int costKB = qMax(1, tileRect.width() * tileRect.height() * 4 / 1024);
+    m_tiles.insert(key, new QPixmap(pixmap), costKB);
+    return pixmap;
+}
+
+void ImagePyramid::setTileCacheSize(int megabytes)
+{
+    m_tiles.setMaxCost(qMax(1, megabytes) * 1024);
+}
+
+void ImagePyramid::onLevelBuilt(int index, const QImage &image, int generation)
+{
+    // Results of a previous image, or out of order after a clear()
+    if (generation != m_generation.load() || index != m_levels.size()) {
+        return;
+    }
+
+    m_levels.append(image);
+    emit levelReady(index);
+}
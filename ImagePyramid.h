@@ -0,0 +1,74 @@
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include <QObject>
+#include <QImage>
+#include <QPixmap>
+#include <QVector>
+#include <QCache>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+/**
+ * @brief Multi-resolution tile pyramid used by ImageCanvas for rendering
+ *
+ * Level 0 is the full-resolution image; every further level halves both
+ * dimensions until the image fits in a single tile. Coarser levels are
+ * built lazily on a background thread. Rendering only converts the tiles
+ * that intersect the viewport to QPixmap, and keeps them in a bounded
+ * cache, so the cost of a repaint depends on the widget size rather than
+ * on the size of the source image.
+ */
+class ImagePyramid : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int TileSize = 256;
+
+    explicit ImagePyramid(QObject *parent = nullptr);
+    ~ImagePyramid();
+
+    // Replace the source image and start building the coarser levels. When
+    // sourcePath is given, levels are shared through the ImageCache so that
+    // revisiting an image does not rebuild its pyramid.
+    void setImage(const QImage &image, const QString &sourcePath = QString());
+    void clear();
+
+    bool isNull() const { return m_levels.isEmpty(); }
+    QSize imageSize() const { return m_imageSize; }
+
+    // Levels that have been built so far (level 0 is always available)
+    int levelCount() const { return m_levels.size(); }
+    QImage level(int index) const;
+
+    // Level whose resolution best matches the given display scale, where
+    // scale is screen pixels per full-resolution image pixel. Returns -1 if
+    // only levels much finer than needed are ready yet.
+    int levelForScale(double scale) const;
+
+    // Scale of a level relative to level 0
+    double levelScale(int index) const;
+
+    // Tile (tx, ty) of a level as an uploaded pixmap
+    QPixmap tile(int levelIndex, int tx, int ty);
+
+    // Limit for the uploaded tile cache, in megabytes
+    void setTileCacheSize(int megabytes);
+
+signals:
+    void levelReady(int index);
+
+private slots:
+    void onLevelBuilt(int index, const QImage &image, int generation);
+
+private:
+    QVector<QImage> m_levels;
+    QSize m_imageSize;
+    int m_levelsTotal;                  // Number of levels once fully built
+    QCache<quint64, QPixmap> m_tiles;   // Uploaded tiles, cost in KB
+    QThreadPool m_pool;
+    QAtomicInt m_generation;            // Bumped on setImage() to cancel old builds
+};
+
+#endif // IMAGEPYRAMID_H
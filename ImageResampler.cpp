@@ -0,0 +1,303 @@
+#include "ImageResampler.h"
+#include <QVector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define IMAGERESAMPLER_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGERESAMPLER_SSE2
+#endif
+
+namespace {
+
+// Averages two source rows into one destination row of dstWidth pixels.
+// Each output channel is (a + b + c + d + 2) >> 2 over a 2x2 block.
+void halveRowScalar(const quint32 *row0, const quint32 *row1, quint32 *dst, int from, int dstWidth)
+{
+    for (int x = from; x < dstWidth; ++x) {
+        quint32 a = row0[2 * x];
+        quint32 b = row0[2 * x + 1];
+        quint32 c = row1[2 * x];
+        quint32 d = row1[2 * x + 1];
+
+        quint32 out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            quint32 sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff) +
+                          ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+            out |= ((sum + 2) >> 2) << shift;
+        }
+        dst[x] = out;
+    }
+}
+
+#ifdef IMAGERESAMPLER_SSE2
+// Sums the two pixels held in the 64-bit halves of a 16-bit-per-channel vector
+inline __m128i pairSum(__m128i v)
+{
+    return _mm_add_epi16(v, _mm_srli_si128(v, 8));
+}
+
+int halveRowSSE2(const quint32 *row0, const quint32 *row1, quint32 *dst, int from, int dstWidth)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+
+    int x = from;
+    for (; x + 2 <= dstWidth; x += 2) {
+        __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 2 * x));
+        __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 2 * x));
+
+        // Vertical sums of source pixels 0,1 (lo) and 2,3 (hi) at 16 bits
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+        // Horizontal pair sums give the two output pixels
+        __m128i sum = _mm_unpacklo_epi64(pairSum(lo), pairSum(hi));
+        __m128i avg = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(avg, avg));
+    }
+    return x;
+}
+#endif
+
+#ifdef IMAGERESAMPLER_AVX2
+int halveRowAVX2(const quint32 *row0, const quint32 *row1, quint32 *dst, int dstWidth)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i two = _mm256_set1_epi16(2);
+
+    int x = 0;
+    for (; x + 4 <= dstWidth; x += 4) {
+        __m256i top = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row0 + 2 * x));
+        __m256i bottom = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row1 + 2 * x));
+
+        // Same as the SSE2 path, independently in each 128-bit lane
+        __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(top, zero), _mm256_unpacklo_epi8(bottom, zero));
+        __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(top, zero), _mm256_unpackhi_epi8(bottom, zero));
+        lo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+        hi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+
+        __m256i sum = _mm256_unpacklo_epi64(lo, hi);
+        __m256i avg = _mm256_srli_epi16(_mm256_add_epi16(sum, two), 2);
+        __m256i packed = _mm256_packus_epi16(avg, avg);
+
+        // Each lane holds two output pixels in its low 64 bits
+        packed = _mm256_permute4x64_epi64(packed, 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm256_castsi256_si128(packed));
+    }
+    return x;
+}
+#endif
+
+void halveRow(const quint32 *row0, const quint32 *row1, quint32 *dst, int dstWidth)
+{
+    int done = 0;
+#if defined(IMAGERESAMPLER_AVX2)
+    done = halveRowAVX2(row0, row1, dst, dstWidth);
+#endif
+#if defined(IMAGERESAMPLER_SSE2)
+    done = halveRowSSE2(row0, row1, dst, done, dstWidth);
+#endif
+    halveRowScalar(row0, row1, dst, done, dstWidth);
+}
+
+// First source pixel and the 14-bit fixed-point weights of the source pixels
+// that cover one destination pixel of an area-average reduction
+struct Contribution {
+    int first;
+    QVector<int> weights;
+};
+
+QVector<Contribution> computeContributions(int srcSize, int dstSize)
+{
+    const int one = 1 << 14;
+    const double ratio = static_cast<double>(srcSize) / dstSize;
+
+    QVector<Contribution> contributions(dstSize);
+    for (int i = 0; i < dstSize; ++i) {
+        double begin = i * ratio;
+        double end = qMin(static_cast<double>(srcSize), (i + 1) * ratio);
+        int first = static_cast<int>(begin);
+        int last = qMin(srcSize - 1, static_cast<int>(end - 1e-9));
+
+        Contribution &c = contributions[i];
+        c.first = first;
+
+        int total = 0;
+        for (int s = first; s <= last; ++s) {
+            double covered = qMin(end, s + 1.0) - qMax(begin, static_cast<double>(s));
+            int weight = static_cast<int>(covered / ratio * one + 0.5);
+            c.weights.append(weight);
+            total += weight;
+        }
+
+        // Put the rounding error on the largest tap so weights sum to one
+        if (!c.weights.isEmpty()) {
+            int largest = 0;
+            for (int k = 1; k < c.weights.size(); ++k) {
+                if (c.weights[k] > c.weights[largest]) {
+                    largest = k;
+                }
+            }
+            c.weights[largest] += one - total;
+        }
+    }
+    return contributions;
+}
+
+inline quint32 weightedPixel(const quint32 *const *pixels, const int *weights, int count)
+{
+    quint32 sum0 = 1 << 13, sum1 = 1 << 13, sum2 = 1 << 13, sum3 = 1 << 13;
+    for (int k = 0; k < count; ++k) {
+        quint32 p = *pixels[k];
+        quint32 w = static_cast<quint32>(weights[k]);
+        sum0 += (p & 0xff) * w;
+        sum1 += ((p >> 8) & 0xff) * w;
+        sum2 += ((p >> 16) & 0xff) * w;
+        sum3 += (p >> 24) * w;
+    }
+    return (qMin(sum0 >> 14, 255u)) |
+           (qMin(sum1 >> 14, 255u) << 8) |
+           (qMin(sum2 >> 14, 255u) << 16) |
+           (qMin(sum3 >> 14, 255u) << 24);
+}
+
+} // namespace
+
+const char *ImageResampler::simdPath()
+{
+#if defined(IMAGERESAMPLER_AVX2)
+    return "AVX2";
+#elif defined(IMAGERESAMPLER_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+QImage ImageResampler::toScanlineFormat(const QImage &image)
+{
+    switch (image.format()) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        return image;
+    default:
+        // Averaging is only correct on premultiplied alpha
+        return image.convertToFormat(image.hasAlphaChannel()
+                                     ? QImage::Format_ARGB32_Premultiplied
+                                     : QImage::Format_RGB32);
+    }
+}
+
+QImage ImageResampler::halve(const QImage &image)
+{
+    QImage source = toScanlineFormat(image);
+    int dstWidth = qMax(1, source.width() / 2);
+    int dstHeight = qMax(1, source.height() / 2);
+
+    // Nothing to average along a 1-pixel dimension
+    if (source.width() < 2 || source.height() < 2) {
+        return source.scaled(dstWidth, dstHeight, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    QImage result(dstWidth, dstHeight, source.format());
+    for (int y = 0; y < dstHeight; ++y) {
+        const quint32 *row0 = reinterpret_cast<const quint32 *>(source.constScanLine(2 * y));
+        const quint32 *row1 = reinterpret_cast<const quint32 *>(source.constScanLine(2 * y + 1));
+        quint32 *dst = reinterpret_cast<quint32 *>(result.scanLine(y));
+        halveRow(row0, row1, dst, dstWidth);
+    }
+    return result;
+}
+
+QImage ImageResampler::areaAverage(const QImage &image, const QSize &targetSize)
+{
+    const int srcWidth = image.width();
+    const int srcHeight = image.height();
+    const int dstWidth = targetSize.width();
+    const int dstHeight = targetSize.height();
+
+    QVector<Contribution> columns = computeContributions(srcWidth, dstWidth);
+    QVector<Contribution> rows = computeContributions(srcHeight, dstHeight);
+
+    // Horizontal pass into an intermediate of dstWidth x srcHeight
+    QImage horizontal(dstWidth, srcHeight, image.format());
+    QVector<const quint32 *> taps;
+    for (int y = 0; y < srcHeight; ++y) {
+        const quint32 *src = reinterpret_cast<const quint32 *>(image.constScanLine(y));
+        quint32 *dst = reinterpret_cast<quint32 *>(horizontal.scanLine(y));
+        for (int x = 0; x < dstWidth; ++x) {
+            const Contribution &c = columns[x];
+            taps.resize(c.weights.size());
+            for (int k = 0; k < c.weights.size(); ++k) {
+                taps[k] = src + c.first + k;
+            }
+            dst[x] = weightedPixel(taps.constData(), c.weights.constData(), c.weights.size());
+        }
+    }
+
+    // Vertical pass
+    QImage result(dstWidth, dstHeight, image.format());
+    for (int y = 0; y < dstHeight; ++y) {
+        const Contribution &c = rows[y];
+        QVector<const quint32 *> rowPointers(c.weights.size());
+        for (int k = 0; k < c.weights.size(); ++k) {
+            rowPointers[k] = reinterpret_cast<const quint32 *>(horizontal.constScanLine(c.first + k));
+        }
+
+        quint32 *dst = reinterpret_cast<quint32 *>(result.scanLine(y));
+        taps.resize(c.weights.size());
+        for (int x = 0; x < dstWidth; ++x) {
+            for (int k = 0; k < c.weights.size(); ++k) {
+                taps[k] = rowPointers[k] + x;
+            }
+            dst[x] = weightedPixel(taps.constData(), c.weights.constData(), c.weights.size());
+        }
+    }
+    return result;
+}
+
+QImage ImageResampler::scale(const QImage &image, const QSize &targetSize, Quality quality)
+{
+    if (image.isNull() || targetSize.isEmpty()) {
+        return QImage();
+    }
+
+    if (targetSize == image.size()) {
+        return image;
+    }
+
+    // Upscaling (in either direction) is not what this engine is for
+    if (targetSize.width() > image.width() || targetSize.height() > image.height()) {
+        return image.scaled(targetSize, Qt::IgnoreAspectRatio,
+                            quality == Preview ? Qt::FastTransformation : Qt::SmoothTransformation);
+    }
+
+    QImage current = toScanlineFormat(image);
+    while (current.width() >= 2 * targetSize.width() && current.height() >= 2 * targetSize.height()) {
+        current = halve(current);
+    }
+
+    if (current.size() == targetSize) {
+        return current;
+    }
+
+    if (quality == Preview) {
+        return current.scaled(targetSize, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+    }
+    return areaAverage(current, targetSize);
+}
+
+QImage ImageResampler::scaleToFit(const QImage &image, const QSize &boundingSize, Quality quality)
+{
+    if (image.isNull() || boundingSize.isEmpty()) {
+        return QImage();
+    }
+
+    QSize targetSize = image.size().scaled(boundingSize, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+    return scale(image, targetSize, quality);
+}
@@ -0,0 +1,45 @@
+#ifndef IMAGERESAMPLER_H
+#define IMAGERESAMPLER_H
+
+#include <QImage>
+#include <QSize>
+
+/**
+ * @brief Fast area-averaging downscaler for display scaling
+ *
+ * Large reductions are done by repeated exact 2x2 box averaging (SSE2, or
+ * AVX2 when the compiler targets it) until the image is within a factor of
+ * two of the target, followed by a single fractional area-average pass on
+ * the much smaller intermediate. All work is done on 32-bit scanlines
+ * (RGB32 or premultiplied ARGB32).
+ *
+ * Upscaling is left to QImage::scaled(), which is cheap for small sources.
+ */
+class ImageResampler
+{
+public:
+    enum Quality {
+        Preview,   // Box halving plus nearest-neighbour finish, for live resizing
+        Refined    // Box halving plus exact area-average finish
+    };
+
+    // Scale image to fit inside boundingSize, keeping the aspect ratio
+    static QImage scaleToFit(const QImage &image, const QSize &boundingSize,
+                             Quality quality = Refined);
+
+    // Scale image to exactly targetSize
+    static QImage scale(const QImage &image, const QSize &targetSize,
+                        Quality quality = Refined);
+
+    // Exact 2x2 box average; odd trailing rows/columns are dropped
+    static QImage halve(const QImage &image);
+
+    // Name of the SIMD code path compiled in ("AVX2", "SSE2" or "scalar")
+    static const char *simdPath();
+
+private:
+    static QImage toScanlineFormat(const QImage &image);
+    static QImage areaAverage(const QImage &image, const QSize &targetSize);
+};
+
+#endif // IMAGERESAMPLER_H
@@ -1,15 +1,42 @@
 #include "MainWindow.h"
+#include "ImageCache.h"
 #include <QFileInfo>
+#include <QStatusBar>
 #include <QDateTime>
 #include <QStandardPaths>
-
-const QStringList MainWindow::IMAGE_EXTENSIONS = {"*.jpg", "*.jpeg", "*.png", "*.bmp", "*.JPG", "*.JPEG", "*.PNG", "*.BMP"};
+#include <QSettings>
+#include <QSplitter>
+#include <QAction>
+#include <QItemSelectionModel>
+#include <QKeySequence>
+#include <QSignalBlocker>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       currentImageIndex(-1),
-      outputFolder("classified_images")
+      outputFolder("classified_images"),
+      fullResolution(false),
+      resizeTimer(new QTimer(this)),
+      prefetcher(new ImagePrefetcher(this)),
+      folderScanner(new FolderScanner(this)),
+      folderWatcher(new FolderWatcher(this)),
+      nearDuplicates(new NearDuplicateIndex(this)),
+      indexSaveTimer(new QTimer(this)),
+      commitQueue(new FileCommitQueue(this)),
+      manifest(new ClassificationManifest(this))
 {
+    commitQueue->setStrategy(FilePlacement::savedStrategy());
+    manifest->setFilePath(QSettings().value("classification/manifestPath",
+                                            outputFolder + "/labels.csv").toString());
+    
+    resizeTimer->setSingleShot(true);
+    resizeTimer->setInterval(250);
+    connect(resizeTimer, &QTimer::timeout, this, &MainWindow::onResizeSettled);
+    
+    indexSaveTimer->setSingleShot(true);
+    indexSaveTimer->setInterval(5000);
+    connect(indexSaveTimer, &QTimer::timeout, this, &MainWindow::saveFolderIndex);
+    
     setupUI();
     setWindowTitle("Image Classification Tool");
     resize(1200, 800);
@@ -17,6 +44,7 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    saveFolderIndex();
 }
 
 void MainWindow::setupUI()
@@ -38,8 +66,10 @@ void MainWindow::setupUI()
     QHBoxLayout *fileButtonsLayout = new QHBoxLayout();
     openImageButton = new QPushButton("Open Single Image", this);
     openFolderButton = new QPushButton("Open Folder", this);
+    includeSubfoldersCheckBox = new QCheckBox("Include subfolders", this);
     fileButtonsLayout->addWidget(openImageButton);
     fileButtonsLayout->addWidget(openFolderButton);
+    fileButtonsLayout->addWidget(includeSubfoldersCheckBox);
     mainLayout->addLayout(fileButtonsLayout);
     
     // Progress information
@@ -51,7 +81,12 @@ void MainWindow::setupUI()
     progressBar->setMinimum(0);
     progressBar->setMaximum(100);
     progressBar->setValue(0);
-    mainLayout->addWidget(progressBar);
+    cancelScanButton = new QPushButton("Cancel Scan", this);
+    cancelScanButton->setVisible(false);
+    QHBoxLayout *progressLayout = new QHBoxLayout();
+    progressLayout->addWidget(progressBar, 1);
+    progressLayout->addWidget(cancelScanButton);
+    mainLayout->addLayout(progressLayout);
     
     // Image display area
     QGroupBox *imageGroup = new QGroupBox("Current Image", this);
@@ -70,11 +105,34 @@ void MainWindow::setupUI()
     scrollArea->setWidget(imageLabel);
     imageLayout->addWidget(scrollArea);
     
+    QHBoxLayout *imageInfoLayout = new QHBoxLayout();
     imageInfoLabel = new QLabel("", this);
     imageInfoLabel->setAlignment(Qt::AlignCenter);
-    imageLayout->addWidget(imageInfoLabel);
+    fullResolutionButton = new QPushButton("Full Resolution (1:1)", this);
+    fullResolutionButton->setCheckable(true);
+    fullResolutionButton->setToolTip("Images are decoded at display size; check to load and view full resolution");
+    imageInfoLayout->addWidget(imageInfoLabel, 1);
+    imageInfoLayout->addWidget(fullResolutionButton);
+    imageLayout->addLayout(imageInfoLayout);
     
-    mainLayout->addWidget(imageGroup);
+    // Grid of the whole queue next to the current image
+    thumbnailModel = new ThumbnailModel(this);
+    thumbnailView = new ThumbnailView(this);
+    thumbnailView->setThumbnailModel(thumbnailModel);
+    thumbnailView->setMinimumWidth(160);
+    QAction *compactThumbnailsAction = new QAction("Compact Thumbnail Cache", thumbnailView);
+    compactThumbnailsAction->setToolTip("Rewrite this folder's thumbnail cache without outdated thumbnails");
+    QAction *selectNearDuplicatesAction = new QAction("Select Near-Duplicates", thumbnailView);
+    selectNearDuplicatesAction->setToolTip("Select every image that looks the same as the current one");
+    thumbnailView->addAction(selectNearDuplicatesAction);
+    thumbnailView->addAction(compactThumbnailsAction);
+    thumbnailView->setContextMenuPolicy(Qt::ActionsContextMenu);
+    QSplitter *imageSplitter = new QSplitter(Qt::Horizontal, this);
+    imageSplitter->addWidget(thumbnailView);
+    imageSplitter->addWidget(imageGroup);
+    imageSplitter->setStretchFactor(0, 1);
+    imageSplitter->setStretchFactor(1, 2);
+    mainLayout->addWidget(imageSplitter);
     
     // Classification controls
     classificationGroup = new QGroupBox("Classification", this);
@@ -98,12 +156,63 @@ void MainWindow::setupUI()
     newCategoryLayout->addWidget(addCategoryButton);
     classificationLayout->addLayout(newCategoryLayout);
     
+    QHBoxLayout *placementLayout = new QHBoxLayout();
+    QLabel *placementLabel = new QLabel("Place files by:", this);
+    placementComboBox = new QComboBox(this);
+    placementComboBox->addItems(FilePlacement::strategyNames());
+    placementComboBox->setCurrentText(FilePlacement::strategyName(commitQueue->strategy()));
+    placementComboBox->setToolTip("Copy duplicates the file; Reflink and Hardlink share its data on the same filesystem; "
+                                  "Move removes the original. Unsupported methods fall back to copying.");
+    deduplicateCheckBox = new QCheckBox("Skip duplicates", this);
+    deduplicateCheckBox->setChecked(commitQueue->deduplicate());
+    deduplicateCheckBox->setToolTip("Images whose content is already in the category are not placed again; "
+                                    "content placed in another category is hardlinked from there");
+    placementLayout->addWidget(placementLabel);
+    placementLayout->addWidget(placementComboBox, 1);
+    placementLayout->addWidget(deduplicateCheckBox);
+    classificationLayout->addLayout(placementLayout);
+    
+    QHBoxLayout *manifestLayout = new QHBoxLayout();
+    manifestOnlyCheckBox = new QCheckBox("Manifest only (record labels without placing files)", this);
+    manifestOnlyCheckBox->setToolTip(QString("Appends path, category and timestamp to %1").arg(manifest->filePath()));
+    compactManifestButton = new QPushButton("Compact Manifest", this);
+    compactManifestButton->setToolTip("Rewrite the manifest keeping only the latest label of each image");
+    manifestLayout->addWidget(manifestOnlyCheckBox, 1);
+    manifestLayout->addWidget(compactManifestButton);
+    classificationLayout->addLayout(manifestLayout);
+    
+    QHBoxLayout *nearDuplicateLayout = new QHBoxLayout();
+    skipNearDuplicatesCheckBox = new QCheckBox("Skip near-duplicates", this);
+    skipNearDuplicatesCheckBox->setToolTip("Next and Skip pass over images that look the same as an earlier one, "
+                                           "such as burst frames");
+    applyToNearDuplicatesCheckBox = new QCheckBox("Classify near-duplicates together", this);
+    applyToNearDuplicatesCheckBox->setToolTip("Put the unprocessed near-duplicates of an image into the same category");
+    nearDuplicateLayout->addWidget(skipNearDuplicatesCheckBox);
+    nearDuplicateLayout->addWidget(applyToNearDuplicatesCheckBox);
+    nearDuplicateLayout->addStretch();
+    classificationLayout->addLayout(nearDuplicateLayout);
+    
     classifyButton = new QPushButton("Classify and Move Image", this);
     classifyButton->setEnabled(false);
     classifyButton->setMinimumHeight(45);
     classifyButton->setStyleSheet("QPushButton:enabled { background-color: #4CAF50; color: white; font-weight: bold; padding: 10px; } QPushButton:disabled { padding: 10px; }");
     classificationLayout->addWidget(classifyButton);
     
+    classifySelectedButton = new QPushButton("Classify Selected", this);
+    classifySelectedButton->setEnabled(false);
+    classifySelectedButton->setToolTip("Put every image selected in the thumbnail grid into the selected category "
+                                       "(Shift/Ctrl-click to select several)");
+    classificationLayout->addWidget(classifySelectedButton);
+    
+    rapidModeCheckBox = new QCheckBox("Rapid mode: keys 1-9, 0, A-Z classify into the categories in order", this);
+    rapidModeCheckBox->setToolTip("Classify with one key press and advance without any dialog; "
+                                  "Backspace or Ctrl+Z undoes the last classifications");
+    hotkeyLabel = new QLabel(this);
+    hotkeyLabel->setWordWrap(true);
+    hotkeyLabel->setVisible(false);
+    classificationLayout->addWidget(rapidModeCheckBox);
+    classificationLayout->addWidget(hotkeyLabel);
+    
     mainLayout->addWidget(classificationGroup);
     
     // Navigation buttons
@@ -119,6 +228,11 @@ void MainWindow::setupUI()
     navigationLayout->addWidget(previousButton);
     navigationLayout->addWidget(skipButton);
     navigationLayout->addWidget(nextButton);
+    undoButton = new QPushButton("Undo", this);
+    undoButton->setEnabled(false);
+    undoButton->setShortcut(QKeySequence::Undo);
+    undoButton->setToolTip(QString("Take back the last classification (Ctrl+Z); up to %1 can be undone").arg(MaxUndo));
+    navigationLayout->addWidget(undoButton);
     mainLayout->addLayout(navigationLayout);
     
     // Set central widget
@@ -127,13 +241,67 @@ void MainWindow::setupUI()
     // Connect signals and slots
     connect(openImageButton, &QPushButton::clicked, this, &MainWindow::openImage);
     connect(openFolderButton, &QPushButton::clicked, this, &MainWindow::openFolder);
+    connect(cancelScanButton, &QPushButton::clicked, this, &MainWindow::cancelScan);
+    connect(folderScanner, &FolderScanner::batchFound, this, &MainWindow::onScanBatch);
+    connect(folderScanner, &FolderScanner::finished, this, &MainWindow::onScanFinished);
+    connect(folderWatcher, &FolderWatcher::filesRenamed, this, &MainWindow::onFilesRenamed);
+    connect(folderWatcher, &FolderWatcher::filesChanged, this, &MainWindow::onFolderChanged);
+    connect(thumbnailView, &ThumbnailView::currentRowChanged, this, &MainWindow::onThumbnailActivated);
+    connect(thumbnailView->selectionModel(), &QItemSelectionModel::selectionChanged,
+            this, &MainWindow::onThumbnailSelectionChanged);
+    connect(selectNearDuplicatesAction, &QAction::triggered, this, &MainWindow::selectNearDuplicates);
+    connect(compactThumbnailsAction, &QAction::triggered, this, &MainWindow::compactThumbnailCache);
+    connect(thumbnailModel->loader(), &ThumbnailLoader::storeCompacted, this, &MainWindow::onThumbnailCacheCompacted);
+    connect(imageSplitter, &QSplitter::splitterMoved, resizeTimer, QOverload<>::of(&QTimer::start));
+    connect(nearDuplicates, &NearDuplicateIndex::clustersChanged, this, &MainWindow::updateNearDuplicateStatus);
+    connect(nearDuplicates, &NearDuplicateIndex::progress, this, &MainWindow::updateNearDuplicateStatus);
+    connect(skipNearDuplicatesCheckBox, &QCheckBox::toggled, this, &MainWindow::onNearDuplicateOptionsChanged);
+    connect(applyToNearDuplicatesCheckBox, &QCheckBox::toggled, this, &MainWindow::onNearDuplicateOptionsChanged);
     connect(classifyButton, &QPushButton::clicked, this, &MainWindow::classifyImage);
+    connect(classifySelectedButton, &QPushButton::clicked, this, &MainWindow::classifySelectedImages);
+    connect(rapidModeCheckBox, &QCheckBox::toggled, this, &MainWindow::setRapidMode);
+    connect(undoButton, &QPushButton::clicked, this, &MainWindow::undoClassification);
     connect(addCategoryButton, &QPushButton::clicked, this, &MainWindow::addNewCategory);
     connect(categoryComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onCategorySelected);
     connect(nextButton, &QPushButton::clicked, this, &MainWindow::nextImage);
     connect(previousButton, &QPushButton::clicked, this, &MainWindow::previousImage);
     connect(skipButton, &QPushButton::clicked, this, &MainWindow::skipImage);
     connect(newCategoryInput, &QLineEdit::returnPressed, this, &MainWindow::addNewCategory);
+    connect(fullResolutionButton, &QPushButton::toggled, this, &MainWindow::setFullResolution);
+    connect(placementComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onPlacementChanged);
+    connect(deduplicateCheckBox, &QCheckBox::toggled, commitQueue, &FileCommitQueue::setDeduplicate);
+    connect(manifestOnlyCheckBox, &QCheckBox::toggled, this, &MainWindow::setManifestOnly);
+    connect(compactManifestButton, &QPushButton::clicked, this, &MainWindow::compactManifest);
+    connect(manifest, &ClassificationManifest::compacted, this, &MainWindow::onManifestCompacted);
+    connect(manifest, &ClassificationManifest::writeFailed, this, &MainWindow::onManifestWriteFailed);
+    
+    // Background copy status
+    nearDuplicateLabel = new QLabel(this);
+    nearDuplicateLabel->setVisible(false);
+    statusBar()->addPermanentWidget(nearDuplicateLabel);
+    commitStatusLabel = new QLabel(this);
+    commitFailuresButton = new QPushButton("Show Failed Copies", this);
+    commitFailuresButton->setVisible(false);
+    statusBar()->addPermanentWidget(commitStatusLabel);
+    statusBar()->addPermanentWidget(commitFailuresButton);
+    batchProgressBar = new QProgressBar(this);
+    batchProgressBar->setMaximumWidth(160);
+    batchProgressBar->setFormat("Placing %v/%m");
+    batchProgressBar->setVisible(false);
+    statusBar()->addPermanentWidget(batchProgressBar);
+    connect(commitQueue, &FileCommitQueue::batchProgress, this, &MainWindow::onBatchProgress);
+    connect(commitQueue, &FileCommitQueue::batchFinished, this, &MainWindow::onBatchFinished);
+    connect(commitFailuresButton, &QPushButton::clicked, this, &MainWindow::showCommitFailures);
+    connect(commitQueue, &FileCommitQueue::statusChanged, this, &MainWindow::updateCommitStatus);
+    connect(commitQueue, &FileCommitQueue::failed, this, &MainWindow::onCommitFailed);
+    connect(commitQueue, &FileCommitQueue::reverted, this, &MainWindow::onReverted);
+    connect(commitQueue, &FileCommitQueue::revertFailed, this, &MainWindow::onRevertFailed);
+    
+    manifestOnlyCheckBox->setChecked(QSettings().value("classification/manifestOnly", false).toBool());
+    skipNearDuplicatesCheckBox->setChecked(QSettings().value("nearDuplicates/skip", false).toBool());
+    applyToNearDuplicatesCheckBox->setChecked(QSettings().value("nearDuplicates/propagate", false).toBool());
+    rapidModeCheckBox->setChecked(QSettings().value("classification/rapidMode", false).toBool());
+    updateCommitStatus();
 }
 
 void MainWindow::openImage()
@@ -146,6 +314,8 @@ void MainWindow::openImage()
     if (!fileName.isEmpty()) {
         clearCurrentSession();
         imageFiles.append(fileName);
+        session.resize(imageFiles.size());
+        thumbnailModel->appendPaths(QStringList() << fileName);
         currentImageIndex = 0;
         currentImagePath = fileName;
         updateImageDisplay();
@@ -165,37 +335,247 @@ void MainWindow::openFolder()
         clearCurrentSession();
         sourceFolder = folderPath;
         loadImagesFromFolder(folderPath);
-        
-        if (imageFiles.isEmpty()) {
-            QMessageBox::warning(this, "No Images Found",
-                "No supported image files (JPG, PNG, BMP) were found in the selected folder.");
-            return;
-        }
-        
+    }
+}
+
+void MainWindow::loadImagesFromFolder(const QString &folderPath)
+{
+    // Thumbnails seen in an earlier session come from the folder's pack
+    QSharedPointer<ThumbnailStore> store(new ThumbnailStore(ThumbnailStore::packFilePath(folderPath)));
+    if (store->open()) {
+        thumbnailModel->loader()->setStore(store);
+    }
+    
+    // Images arrive in batches through onScanBatch(); the first one is shown
+    // as soon as it is found.
+    folderScanner->start(folderPath, includeSubfoldersCheckBox->isChecked());
+    cancelScanButton->setVisible(true);
+    updateProgress();
+}
+
+void MainWindow::onScanBatch(const QStringList &paths)
+{
+    imageFiles.append(paths);
+    session.resize(imageFiles.size());
+    nearDuplicates->add(paths);
+    thumbnailModel->appendPaths(paths);
+    
+    if (currentImageIndex < 0) {
         currentImageIndex = 0;
         currentImagePath = imageFiles[0];
         updateImageDisplay();
-        updateProgress();
-        updateNavigationButtons();
+    } else {
+        // Neighbours of the current image may only exist now
+        prefetcher->prefetchAround(imageFiles, currentImageIndex);
     }
+    
+    updateProgress();
+    updateNavigationButtons();
 }
 
-void MainWindow::loadImagesFromFolder(const QString &folderPath)
+void MainWindow::onScanFinished(int total)
 {
-    QDir dir(folderPath);
-    QFileInfoList fileList = dir.entryInfoList(IMAGE_EXTENSIONS, QDir::Files | QDir::NoDotAndDotDot);
+    Q_UNUSED(total);
+    cancelScanButton->setVisible(false);
     
-    for (const QFileInfo &fileInfo : fileList) {
-        if (isImageFile(fileInfo.absoluteFilePath())) {
-            imageFiles.append(fileInfo.absoluteFilePath());
+    // Restore the processed state of the last session, keeping anything
+    // classified while the scan was still running
+    folderIndex = folderScanner->index();
+    if (folderIndex) {
+        // Rows of a freshly scanned index are queue indexes. The session file
+        // restores statuses and position exactly; when it is missing or the
+        // folder changed since, the statuses saved in the index are used.
+        bool resumed = session.open(folderIndex->rootPath(), folderIndex->isRecursive(), "classification",
+                                    SessionStore::fingerprint(imageFiles));
+        int rows = qMin(folderIndex->count(), session.count());
+        for (int row = 0; row < rows; ++row) {
+            if (!resumed && folderIndex->isProcessed(row, FolderIndex::Classified)) {
+                session.setStatus(row, SessionStore::Processed);
+            }
+            if (session.isProcessed(row)) {
+                folderIndex->setProcessed(row, FolderIndex::Classified, true);
+            }
+        }
+        if (folderIndex->isDirty()) {
+            indexSaveTimer->start();
+        }
+        
+        // From now on new and deleted files are merged into the queue
+        folderWatcher->start(folderIndex->rootPath(), folderIndex->isRecursive(),
+                             folderIndex->directoryPaths(), imageFiles);
+        
+        // Continue where the previous session stopped, unless the user
+        // already moved on while the folder was scanned
+        int resumeIndex = session.currentIndex();
+        if (resumed && currentImageIndex == 0 && resumeIndex > 0 && resumeIndex < imageFiles.size()) {
+            currentImageIndex = resumeIndex;
+            updateImageDisplay();
+            updateNavigationButtons();
+            statusBar()->showMessage(QString("Resumed at image %1 of %2")
+                .arg(resumeIndex + 1).arg(imageFiles.size()), 5000);
         }
     }
+    
+    updateProgress();
+    
+    if (imageFiles.isEmpty()) {
+        QMessageBox::warning(this, "No Images Found",
+            "No supported image files (JPG, PNG, BMP) were found in the selected folder.");
+    }
+}
+
+void MainWindow::cancelScan()
+{
+    if (!folderScanner->isRunning()) {
+        return;
+    }
+    
+    folderScanner->cancel();
+    cancelScanButton->setVisible(false);
+    updateProgress();
+    statusBar()->showMessage(QString("Folder scan cancelled after %1 images").arg(imageFiles.size()), 5000);
+}
+
+void MainWindow::onFolderChanged(const QStringList &reportedAdded, const QStringList &reportedRemoved)
+{
+    // Images the commit queue moved into a category folder stay queued, so
+    // they still count as processed and undo can show them again; moving
+    // them back does not make them new files either
+    QStringList removed;
+    for (const QString &path : reportedRemoved) {
+        if (!movedFromQueue.contains(path)) {
+            removed.append(path);
+        }
+    }
+    QStringList added;
+    for (const QString &path : reportedAdded) {
+        if (movedFromQueue.remove(path) && queueIndexOf(path) >= 0) {
+            continue;
+        }
+        added.append(path);
+    }
+    if (added.isEmpty() && removed.isEmpty()) {
+        return;
+    }
+    
+    // Entries before the current image shift it down; the current image
+    // itself stays on screen unless it was removed.
+    bool currentRemoved = false;
+    if (!removed.isEmpty()) {
+        QSet<QString> removedSet;
+        for (const QString &path : removed) {
+            removedSet.insert(path);
+        }
+        
+        QStringList remaining;
+        remaining.reserve(imageFiles.size());
+        QVector<int> removedIndexes;
+        int removedBefore = 0;
+        for (int i = 0; i < imageFiles.size(); ++i) {
+            if (removedSet.contains(imageFiles[i])) {
+                removedIndexes.append(i);
+                if (i < currentImageIndex) {
+                    removedBefore++;
+                } else if (i == currentImageIndex) {
+                    currentRemoved = true;
+                }
+                continue;
+            }
+            remaining.append(imageFiles[i]);
+        }
+        imageFiles = remaining;
+        queueIndexes.clear();
+        currentImageIndex -= removedBefore;
+        
+        session.removeIndexes(removedIndexes);
+        nearDuplicates->remove(removed);
+        
+        // Removing rows moves the grid's current row; that is not a
+        // navigation request
+        QSignalBlocker blocker(thumbnailView);
+        thumbnailModel->removePaths(removed);
+        
+        if (folderIndex) {
+            folderIndex->removeFiles(removed);
+        }
+    }
+    
+    // New files join the end of the queue
+    imageFiles.append(added);
+    session.resize(imageFiles.size());
+    session.setFingerprint(SessionStore::fingerprint(imageFiles));
+    nearDuplicates->add(added);
+    thumbnailModel->appendPaths(added);
+    if (folderIndex) {
+        for (const QString &path : added) {
+            folderIndex->addFile(path);
+        }
+        if (folderIndex->isDirty()) {
+            indexSaveTimer->start();
+        }
+    }
+    
+    if (imageFiles.isEmpty()) {
+        currentImageIndex = -1;
+        currentImagePath.clear();
+        imageLabel->clear();
+        imageLabel->setText("No image loaded");
+        imageInfoLabel->setText("");
+    } else if (currentImageIndex < 0 || currentRemoved) {
+        // Show the image that followed the removed one
+        currentImageIndex = qBound(0, currentImageIndex, imageFiles.size() - 1);
+        updateImageDisplay();
+    } else {
+        thumbnailView->setCurrentRow(currentImageIndex);
+        prefetcher->prefetchAround(imageFiles, currentImageIndex);
+    }
+    
+    updateProgress();
+    updateNavigationButtons();
+    statusBar()->showMessage(QString("Folder changed: %1 images added, %2 removed")
+        .arg(added.size()).arg(removed.size()), 5000);
 }
 
-bool MainWindow::isImageFile(const QString &filePath)
+void MainWindow::onFilesRenamed(const QStringList &renamedFrom, const QStringList &renamedTo)
 {
-    QString extension = QFileInfo(filePath).suffix().toLower();
-    return (extension == "jpg" || extension == "jpeg" || extension == "png" || extension == "bmp");
+    // A renamed image keeps its queue position and status; the current
+    // image stays where it is
+    int renamed = 0;
+    for (int i = 0; i < renamedFrom.size(); ++i) {
+        const QString &from = renamedFrom[i];
+        const QString &to = renamedTo[i];
+        int index = queueIndexOf(from);
+        if (index < 0 || movedFromQueue.contains(from)) {
+            onFolderChanged(QStringList() << to, QStringList() << from);
+            continue;
+        }
+        
+        imageFiles[index] = to;
+        queueIndexes.remove(from);
+        queueIndexes.insert(to, index);
+        if (index == currentImageIndex) {
+            currentImagePath = to;
+        }
+        
+        thumbnailModel->renamePath(from, to);
+        nearDuplicates->rename(from, to);
+        if (folderIndex) {
+            folderIndex->renameFile(from, to);
+        }
+        renamed++;
+    }
+    if (renamed == 0) {
+        return;
+    }
+    
+    session.setFingerprint(SessionStore::fingerprint(imageFiles));
+    if (folderIndex && folderIndex->isDirty()) {
+        indexSaveTimer->start();
+    }
+    if (currentImageIndex >= 0) {
+        prefetcher->prefetchAround(imageFiles, currentImageIndex);
+    }
+    statusBar()->showMessage(QString("Folder changed: %1 images renamed").arg(renamed), 5000);
 }
 
 void MainWindow::updateImageDisplay()
@@ -207,9 +587,17 @@ void MainWindow::updateImageDisplay()
     }
     
     currentImagePath = imageFiles[currentImageIndex];
-    currentPixmap = QPixmap(currentImagePath);
+    session.setCurrentIndex(currentImageIndex);
+    thumbnailView->setCurrentRow(currentImageIndex);
+    updateDecodeSize();
     
-    if (currentPixmap.isNull()) {
+    // Decode straight at display size unless the user zoomed in
+    currentImage = prefetcher->load(currentImagePath, &sourceImageSize);
+    if (!sourceImageSize.isValid()) {
+        sourceImageSize = currentImage.size();
+    }
+    
+    if (currentImage.isNull()) {
         imageLabel->setText("Failed to load image");
         imageInfoLabel->setText("");
         QMessageBox::warning(this, "Error", "Failed to load image: " + currentImagePath);
@@ -220,41 +608,179 @@ void MainWindow::updateImageDisplay()
     
     // Update image info
     QFileInfo fileInfo(currentImagePath);
-    QString info = QString("File: %1 | Size: %2x%3 | %4 KB")
+    if (folderIndex) {
+        // Cached metadata is saved with the next index write
+        folderIndex->setImageInfo(currentImagePath, fileInfo.size(),
+                                  fileInfo.lastModified().toMSecsSinceEpoch(), sourceImageSize);
+    }
+    
+    QString info = QString("File: %1 | Size: %2x%3 | %4 KB | %5 | %6")
         .arg(fileInfo.fileName())
-        .arg(currentPixmap.width())
-        .arg(currentPixmap.height())
-        .arg(fileInfo.size() / 1024);
+        .arg(sourceImageSize.width())
+        .arg(sourceImageSize.height())
+        .arg(fileInfo.size() / 1024)
+        .arg(prefetcher->statisticsText())
+        .arg(ImageCache::instance().statisticsText());
     imageInfoLabel->setText(info);
     
     skipButton->setEnabled(true);
+    
+    // Start decoding the neighbours while the user looks at this one
+    prefetcher->prefetchAround(imageFiles, currentImageIndex);
+}
+
+void MainWindow::onThumbnailActivated(int row)
+{
+    // Also called back when updateImageDisplay() syncs the grid
+    if (row == currentImageIndex || row < 0 || row >= imageFiles.size()) {
+        return;
+    }
+    currentImageIndex = row;
+    updateImageDisplay();
+    updateProgress();
+    updateNavigationButtons();
+}
+
+void MainWindow::onThumbnailSelectionChanged()
+{
+    int count = thumbnailView->selectedRows().size();
+    classifySelectedButton->setText(count > 1 ? QString("Classify %1 Selected").arg(count)
+                                              : QString("Classify Selected"));
+    classifySelectedButton->setEnabled(count > 0 && categoryComboBox->currentIndex() > 0);
 }
 
-void MainWindow::scaleImageToFit()
+void MainWindow::selectNearDuplicates()
 {
-    if (currentPixmap.isNull()) {
+    if (currentImagePath.isEmpty()) {
         return;
     }
     
-    // Scale image to fit the scroll area while maintaining aspect ratio
-    int maxWidth = scrollArea->viewport()->width() - 20;
-    int maxHeight = scrollArea->viewport()->height() - 20;
+    QItemSelection selection;
+    for (const QString &path : nearDuplicates->cluster(currentImagePath)) {
+        int row = thumbnailModel->row(path);
+        if (row >= 0) {
+            QModelIndex index = thumbnailModel->index(row);
+            selection.select(index, index);
+        }
+    }
+    if (selection.isEmpty()) {
+        statusBar()->showMessage("No near-duplicates of this image found (yet)", 3000);
+        return;
+    }
+    thumbnailView->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect);
+}
+
+void MainWindow::compactThumbnailCache()
+{
+    if (!thumbnailModel->loader()->store()) {
+        statusBar()->showMessage("No folder open", 3000);
+        return;
+    }
+    thumbnailModel->loader()->compactStore();
+    statusBar()->showMessage("Compacting thumbnail cache...");
+}
+
+void MainWindow::onThumbnailCacheCompacted(qint64 bytesBefore, qint64 bytesAfter)
+{
+    statusBar()->showMessage(QString("Thumbnail cache compacted: %1 KB, %2 KB kept")
+        .arg(bytesBefore / 1024).arg(bytesAfter / 1024), 5000);
+}
+
+void MainWindow::scaleImageToFit(ImageResampler::Quality quality)
+{
+    if (currentImage.isNull()) {
+        return;
+    }
     
-    QPixmap scaledPixmap = currentPixmap.scaled(maxWidth, maxHeight, 
-        Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    // Full resolution is shown 1:1 and scrolled instead of scaled
+    if (fullResolution) {
+        imageLabel->setPixmap(QPixmap::fromImage(currentImage));
+        imageLabel->adjustSize();
+        return;
+    }
+    
+    // Scale image to fit the scroll area while maintaining aspect ratio
+    QImage scaledImage = ImageResampler::scaleToFit(currentImage, displaySize(), quality);
     
-    imageLabel->setPixmap(scaledPixmap);
+    imageLabel->setPixmap(QPixmap::fromImage(scaledImage));
     imageLabel->adjustSize();
 }
 
+QSize MainWindow::displaySize() const
+{
+    return QSize(qMax(1, scrollArea->viewport()->width() - 20),
+                 qMax(1, scrollArea->viewport()->height() - 20));
+}
+
+bool MainWindow::updateDecodeSize()
+{
+    QSize newSize;
+    
+    if (!fullResolution) {
+        // Re-decode only when the viewport outgrew the decoded image or
+        // shrank to less than half of it; small resizes just rescale.
+        QSize viewSize = displaySize();
+        bool tooSmall = !decodeSize.isValid() ||
+            viewSize.width() > decodeSize.width() || viewSize.height() > decodeSize.height();
+        bool tooLarge = decodeSize.isValid() &&
+            viewSize.width() * 2 < decodeSize.width() && viewSize.height() * 2 < decodeSize.height();
+        newSize = (tooSmall || tooLarge) ? viewSize : decodeSize;
+    }
+    
+    if (newSize == decodeSize && prefetcher->targetSize() == decodeSize) {
+        return false;
+    }
+    
+    decodeSize = newSize;
+    prefetcher->setTargetSize(decodeSize);
+    return true;
+}
+
+void MainWindow::setFullResolution(bool enabled)
+{
+    fullResolution = enabled;
+    if (currentImageIndex >= 0) {
+        updateImageDisplay();
+    }
+}
+
+void MainWindow::onResizeSettled()
+{
+    if (currentImageIndex < 0 || fullResolution) {
+        return;
+    }
+    
+    // A larger window needs a larger decode; the current image was only
+    // rescaled while the resize was in progress.
+    if (currentImage.size() != sourceImageSize && updateDecodeSize()) {
+        updateImageDisplay();
+    } else {
+        scaleImageToFit(ImageResampler::Refined);
+    }
+}
+
 void MainWindow::resizeEvent(QResizeEvent *event)
 {
     QMainWindow::resizeEvent(event);
-    scaleImageToFit();
+    
+    // Cheap preview while the window is being dragged; onResizeSettled()
+    // does the refined pass once it stops.
+    scaleImageToFit(ImageResampler::Preview);
+    resizeTimer->start();
 }
 
 void MainWindow::updateProgress()
 {
+    if (folderScanner->isRunning()) {
+        progressLabel->setText(QString("Scanning folder... %1 images found | Image %2 | Processed: %3")
+            .arg(imageFiles.size())
+            .arg(currentImageIndex + 1)
+            .arg(session.processedCount()));
+        progressBar->setRange(0, 0);
+        return;
+    }
+    progressBar->setRange(0, 100);
+    
     if (imageFiles.isEmpty()) {
         progressLabel->setText("No images loaded");
         progressBar->setValue(0);
@@ -262,7 +788,7 @@ void MainWindow::updateProgress()
     }
     
     int total = imageFiles.size();
-    int processed = processedImages.size();
+    int processed = session.processedCount();
     int current = currentImageIndex + 1;
     
     progressLabel->setText(QString("Image %1 of %2 | Processed: %3")
@@ -277,7 +803,43 @@ void MainWindow::updateProgress()
 void MainWindow::updateNavigationButtons()
 {
     previousButton->setEnabled(currentImageIndex > 0);
-    nextButton->setEnabled(currentImageIndex < imageFiles.size() - 1);
+    nextButton->setEnabled(nextQueueIndex() >= 0);
+}
+
+int MainWindow::queueIndexOf(const QString &path)
+{
+    // The queue only grows between removals, so new entries are added on use
+    for (int i = queueIndexes.size(); i < imageFiles.size(); ++i) {
+        queueIndexes.insert(imageFiles[i], i);
+    }
+    return queueIndexes.value(path, -1);
+}
+
+int MainWindow::nextQueueIndex() const
+{
+    // Near-duplicates of an earlier image are passed over when collapsed
+    bool skipNearDuplicates = skipNearDuplicatesCheckBox->isChecked();
+    for (int i = currentImageIndex + 1; i < imageFiles.size(); ++i) {
+        if (!skipNearDuplicates || !nearDuplicates->isNearDuplicate(imageFiles[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void MainWindow::onNearDuplicateOptionsChanged()
+{
+    QSettings settings;
+    settings.setValue("nearDuplicates/skip", skipNearDuplicatesCheckBox->isChecked());
+    settings.setValue("nearDuplicates/propagate", applyToNearDuplicatesCheckBox->isChecked());
+    updateNavigationButtons();
+}
+
+void MainWindow::updateNearDuplicateStatus()
+{
+    nearDuplicateLabel->setVisible(nearDuplicates->count() > 0);
+    nearDuplicateLabel->setText(nearDuplicates->statusText());
+    updateNavigationButtons();
 }
 
 void MainWindow::addNewCategory()
@@ -302,6 +864,7 @@ void MainWindow::addNewCategory()
     categoryComboBox->addItem(newCategory);
     categoryComboBox->setCurrentText(newCategory);
     newCategoryInput->clear();
+    updateCategoryHotkeys();
     
     // Create the category folder
     createCategoryFolder(newCategory);
@@ -312,6 +875,7 @@ void MainWindow::onCategorySelected(int index)
     // Enable classify button only if a valid category is selected and an image is loaded
     bool validSelection = (index > 0) && (currentImageIndex >= 0);
     classifyButton->setEnabled(validSelection);
+    onThumbnailSelectionChanged();
 }
 
 void MainWindow::classifyImage()
@@ -325,56 +889,370 @@ void MainWindow::classifyImage()
         QMessageBox::warning(this, "No Category Selected", "Please select a category first.");
         return;
     }
+    
+    classifyCurrentImage(selectedCategory);
+}
 
-    // Move the image to the category folder
-    if (moveImageToCategory(currentImagePath, selectedCategory)) {
-        processedImages.append(currentImagePath);
+void MainWindow::classifyCurrentImage(const QString &selectedCategory)
+{
+    if (currentImageIndex < 0 || currentImageIndex >= imageFiles.size()) {
+        return;
+    }
+    
+    // The copy is queued; the next image is shown without waiting for it
+    Classification classification;
+    classification.category = selectedCategory;
+    classification.manifestOnly = manifestOnlyCheckBox->isChecked();
+    classification.paths.append(currentImagePath);
+    moveImageToCategory(currentImagePath, selectedCategory);
+    session.setStatus(currentImageIndex, SessionStore::Processed);
+    if (folderIndex) {
+        folderIndex->setProcessed(currentImagePath, FolderIndex::Classified, true);
+        indexSaveTimer->start();
+    }
+    
+    // Burst frames of the same scene go along with it
+    int propagated = 0;
+    if (applyToNearDuplicatesCheckBox->isChecked()) {
+        for (const QString &path : nearDuplicates->cluster(currentImagePath)) {
+            int index = queueIndexOf(path);
+            if (path == currentImagePath || index < 0 || session.isProcessed(index)) {
+                continue;
+            }
+            moveImageToCategory(path, selectedCategory);
+            classification.paths.append(path);
+            session.setStatus(index, SessionStore::Processed);
+            if (folderIndex) {
+                folderIndex->setProcessed(path, FolderIndex::Classified, true);
+            }
+            propagated++;
+        }
+    }
+    pushUndo(classification);
+    
+    QString message = QString("%1 classified as '%2'")
+        .arg(QFileInfo(currentImagePath).fileName()).arg(selectedCategory);
+    if (propagated > 0) {
+        message += QString(" with %1 near-duplicates").arg(propagated);
+    }
+    statusBar()->showMessage(message, 3000);
 
-        QMessageBox::information(this, "Success",
-            QString("Image classified as '%1' and moved successfully!").arg(selectedCategory));
+    // Move to next image
+    if (nextQueueIndex() >= 0) {
+        nextImage();
+    } else if (rapidModeCheckBox->isChecked()) {
+        // Stay on the last image so the classification can still be undone
+        statusBar()->showMessage(message + " | All images have been processed", 5000);
+        updateProgress();
+    } else {
+        // All images processed
+        QMessageBox::information(this, "Complete",
+            "All images have been processed!");
+        clearCurrentSession();
+    }
+}
 
-        // Move to next image
-        if (currentImageIndex < imageFiles.size() - 1) {
+void MainWindow::classifySelectedImages()
+{
+    QString selectedCategory = categoryComboBox->currentText();
+    if (categoryComboBox->currentIndex() <= 0 || selectedCategory.isEmpty()) {
+        return;
+    }
+    
+    QStringList paths;
+    for (int row : thumbnailView->selectedRows()) {
+        if (row < imageFiles.size()) {
+            paths.append(imageFiles[row]);
+            session.setStatus(row, SessionStore::Processed);
+            if (folderIndex) {
+                folderIndex->setProcessed(imageFiles[row], FolderIndex::Classified, true);
+            }
+        }
+    }
+    if (paths.isEmpty()) {
+        return;
+    }
+    if (folderIndex) {
+        indexSaveTimer->start();
+    }
+    Classification classification;
+    classification.category = selectedCategory;
+    classification.manifestOnly = manifestOnlyCheckBox->isChecked();
+    classification.paths = paths;
+    pushUndo(classification);
+    
+    // One request for the whole selection; the queue spreads it over its
+    // workers and reports progress for all of it
+    if (manifestOnlyCheckBox->isChecked()) {
+        for (const QString &path : paths) {
+            manifest->append(path, selectedCategory);
+        }
+        updateCommitStatus();
+        statusBar()->showMessage(QString("%1 images labelled '%2'").arg(paths.size()).arg(selectedCategory), 5000);
+    } else {
+        commitQueue->enqueueBatch(paths, outputFolder + "/" + selectedCategory);
+        statusBar()->showMessage(QString("Placing %1 images in '%2'...").arg(paths.size()).arg(selectedCategory));
+    }
+    
+    thumbnailView->clearSelection();
+    updateProgress();
+    
+    // Continue with the first image that is still open
+    if (session.isProcessed(currentImageIndex)) {
+        if (nextQueueIndex() >= 0) {
             nextImage();
         } else {
-            // All images processed
-            QMessageBox::information(this, "Complete",
-                "All images have been processed!");
-            clearCurrentSession();
+            statusBar()->showMessage("All images have been processed", 5000);
         }
     }
 }
 
-bool MainWindow::moveImageToCategory(const QString &imagePath, const QString &category)
+void MainWindow::pushUndo(const Classification &classification)
 {
-    QFileInfo fileInfo(imagePath);
-    QString categoryPath = outputFolder + "/" + category;
+    undoStack.append(classification);
+    while (undoStack.size() > MaxUndo) {
+        undoStack.removeFirst();
+    }
+    undoButton->setEnabled(true);
+}
 
-    // Create category folder if it doesn't exist
-    createCategoryFolder(category);
+void MainWindow::undoClassification()
+{
+    if (undoStack.isEmpty()) {
+        statusBar()->showMessage("Nothing to undo", 2000);
+        return;
+    }
+    
+    Classification last = undoStack.takeLast();
+    undoButton->setEnabled(!undoStack.isEmpty());
+    
+    int firstIndex = -1;
+    for (const QString &path : last.paths) {
+        // Queued copies are dropped, placed files removed again
+        if (last.manifestOnly) {
+            manifest->append(path, QString());
+        } else {
+            commitQueue->revert(path);
+        }
+        int index = queueIndexOf(path);
+        if (index >= 0) {
+            session.setStatus(index, SessionStore::Unprocessed);
+            if (firstIndex < 0 || index < firstIndex) {
+                firstIndex = index;
+            }
+        }
+        if (folderIndex) {
+            folderIndex->setProcessed(path, FolderIndex::Classified, false);
+        }
+    }
+    if (folderIndex) {
+        indexSaveTimer->start();
+    }
+    updateCommitStatus();
+    
+    // Back to the image so it can be classified again
+    if (firstIndex >= 0) {
+        currentImageIndex = firstIndex;
+        updateImageDisplay();
+    }
+    updateProgress();
+    updateNavigationButtons();
+    
+    QString what = last.paths.size() == 1 ? QFileInfo(last.paths.first()).fileName()
+                                          : QString("%1 images").arg(last.paths.size());
+    statusBar()->showMessage(QString("Undone: %1 no longer in '%2'").arg(what).arg(last.category), 3000);
+}
 
-    // Destination path
-    QString destPath = categoryPath + "/" + fileInfo.fileName();
+void MainWindow::onReverted(const QString &imagePath)
+{
+    // With the Move strategy the undone image was shown before it was back
+    if (imagePath == currentImagePath) {
+        updateImageDisplay();
+    }
+}
+
+void MainWindow::onRevertFailed(const QString &imagePath, const QString &error)
+{
+    statusBar()->showMessage(QString("Could not undo %1: %2")
+        .arg(QFileInfo(imagePath).fileName()).arg(error), 5000);
+}
+
+void MainWindow::setRapidMode(bool enabled)
+{
+    QSettings().setValue("classification/rapidMode", enabled);
+    updateCategoryHotkeys();
+}
 
-    // Check if file already exists at destination
-    if (QFile::exists(destPath)) {
-        // Add timestamp to make filename unique
-        QString baseName = fileInfo.baseName();
-        QString extension = fileInfo.suffix();
-        QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
-        destPath = categoryPath + "/" + baseName + "_" + timestamp + "." + extension;
+void MainWindow::updateCategoryHotkeys()
+{
+    qDeleteAll(categoryShortcuts);
+    categoryShortcuts.clear();
+    
+    bool enabled = rapidModeCheckBox->isChecked();
+    hotkeyLabel->setVisible(enabled);
+    if (!enabled) {
+        return;
     }
+    
+    // 1-9, 0, then A-Z, in the order the categories were added
+    QStringList hints;
+    for (int item = 1; item < categoryComboBox->count(); ++item) {
+        int n = item - 1;
+        QString key;
+        if (n < 9) {
+            key = QString::number(n + 1);
+        } else if (n == 9) {
+            key = "0";
+        } else if (n < 36) {
+            key = QString(QChar('A' + n - 10));
+        } else {
+            break;
+        }
+        
+        QString category = categoryComboBox->itemText(item);
+        QShortcut *shortcut = new QShortcut(QKeySequence(key), this);
+        connect(shortcut, &QShortcut::activated, this, [this, category]() {
+            classifyCurrentImage(category);
+        });
+        categoryShortcuts.append(shortcut);
+        hints.append(QString("[%1] %2").arg(key).arg(category));
+    }
+    
+    QShortcut *undoShortcut = new QShortcut(QKeySequence(Qt::Key_Backspace), this);
+    connect(undoShortcut, &QShortcut::activated, this, &MainWindow::undoClassification);
+    categoryShortcuts.append(undoShortcut);
+    
+    hotkeyLabel->setText(hints.isEmpty() ? QString("Add categories to get hotkeys")
+                                         : hints.join("   ") + "   [Backspace] undo");
+}
 
-    // Copy the file (safer than move in case of errors)
-    if (QFile::copy(imagePath, destPath)) {
-        // Optionally delete the original file
-        // QFile::remove(imagePath);
-        return true;
-    } else {
-        QMessageBox::critical(this, "Error",
-            QString("Failed to move image to category folder.\nSource: %1\nDestination: %2")
-            .arg(imagePath).arg(destPath));
-        return false;
+void MainWindow::onBatchProgress(int done, int total)
+{
+    batchProgressBar->setRange(0, total);
+    batchProgressBar->setValue(done);
+    batchProgressBar->setVisible(done < total);
+}
+
+void MainWindow::onBatchFinished(int placed, int failed)
+{
+    batchProgressBar->setVisible(false);
+    QString message = QString("Batch placed: %1 images").arg(placed);
+    if (failed > 0) {
+        message += QString(", %1 failed (see Show Failed Copies)").arg(failed);
+    }
+    statusBar()->showMessage(message, 8000);
+}
+
+void MainWindow::moveImageToCategory(const QString &imagePath, const QString &category)
+{
+    // Manifest mode only records the label; no file is touched
+    if (manifestOnlyCheckBox->isChecked()) {
+        manifest->append(imagePath, category);
+        updateCommitStatus();
+        return;
+    }
+    
+    // FileCommitQueue creates the folder and places the file on a worker thread
+    // with the strategy selected in placementComboBox
+    if (commitQueue->strategy() == FilePlacement::Move) {
+        movedFromQueue.insert(imagePath);
+    }
+    commitQueue->enqueue(imagePath, outputFolder + "/" + category);
+}
+
+void MainWindow::onCommitFailed(const QString &imagePath, const QString &error)
+{
+    statusBar()->showMessage(QString("Failed to copy %1: %2")
+        .arg(QFileInfo(imagePath).fileName()).arg(error), 5000);
+    
+    // Only a successful copy counts as processed
+    movedFromQueue.remove(imagePath);
+    session.setStatus(queueIndexOf(imagePath), SessionStore::Unprocessed);
+    if (folderIndex) {
+        folderIndex->setProcessed(imagePath, FolderIndex::Classified, false);
+        indexSaveTimer->start();
+    }
+    updateProgress();
+}
+
+void MainWindow::onPlacementChanged(int index)
+{
+    FilePlacement::Strategy strategy = FilePlacement::strategyFromName(placementComboBox->itemText(index));
+    commitQueue->setStrategy(strategy);
+    FilePlacement::saveStrategy(strategy);
+}
+
+void MainWindow::setManifestOnly(bool enabled)
+{
+    placementComboBox->setEnabled(!enabled);
+    deduplicateCheckBox->setEnabled(!enabled);
+    QSettings().setValue("classification/manifestOnly", enabled);
+    updateCommitStatus();
+}
+
+void MainWindow::compactManifest()
+{
+    manifest->compact();
+    statusBar()->showMessage("Compacting manifest...");
+}
+
+void MainWindow::onManifestCompacted(int recordsBefore, int recordsAfter)
+{
+    statusBar()->showMessage(QString("Manifest compacted: %1 records, %2 kept")
+        .arg(recordsBefore).arg(recordsAfter), 5000);
+}
+
+void MainWindow::onManifestWriteFailed(const QString &error)
+{
+    QMessageBox::warning(this, "Manifest Error",
+        QString("Failed to write the label manifest %1:\n%2").arg(manifest->filePath()).arg(error));
+}
+
+void MainWindow::updateCommitStatus()
+{
+    QString status = commitQueue->statusText();
+    if (manifestOnlyCheckBox->isChecked() || manifest->recordCount() > 0) {
+        status = manifest->statusText() + " | " + status;
+    }
+    commitStatusLabel->setText(status);
+    commitFailuresButton->setVisible(!commitQueue->failures().isEmpty());
+}
+
+void MainWindow::showCommitFailures()
+{
+    QList<FileCommitQueue::Failure> failures = commitQueue->failures();
+    if (failures.isEmpty()) {
+        return;
+    }
+    
+    QStringList lines;
+    for (const FileCommitQueue::Failure &failure : failures) {
+        lines.append(QString("%1 -> %2: %3")
+            .arg(failure.sourcePath).arg(failure.destinationFolder).arg(failure.error));
+    }
+    
+    QMessageBox box(QMessageBox::Warning, "Failed Copies",
+        QString("%1 images could not be copied to their category folders.").arg(failures.size()),
+        QMessageBox::Retry | QMessageBox::Discard | QMessageBox::Close, this);
+    box.setDetailedText(lines.join("\n"));
+    
+    int reply = box.exec();
+    if (reply == QMessageBox::Retry) {
+        // Counted as processed again, as when they were first classified
+        for (const FileCommitQueue::Failure &failure : failures) {
+            int index = queueIndexOf(failure.sourcePath);
+            if (index >= 0 && !session.isProcessed(index)) {
+                session.setStatus(index, SessionStore::Processed);
+                if (folderIndex) {
+                    folderIndex->setProcessed(failure.sourcePath, FolderIndex::Classified, true);
+                }
+            }
+        }
+        indexSaveTimer->start();
+        updateProgress();
+        commitQueue->retryFailures();
+    } else if (reply == QMessageBox::Discard) {
+        commitQueue->clearFailures();
     }
 }
 
@@ -393,8 +1271,9 @@ void MainWindow::createCategoryFolder(const QString &category)
 
 void MainWindow::nextImage()
 {
-    if (currentImageIndex < imageFiles.size() - 1) {
-        currentImageIndex++;
+    int next = nextQueueIndex();
+    if (next >= 0) {
+        currentImageIndex = next;
         updateImageDisplay();
         updateProgress();
         updateNavigationButtons();
@@ -417,10 +1296,33 @@ void MainWindow::skipImage()
     nextImage();
 }
 
+void MainWindow::saveFolderIndex()
+{
+    indexSaveTimer->stop();
+    if (folderIndex && folderIndex->isDirty()) {
+        folderIndex->save();
+    }
+}
+
 void MainWindow::clearCurrentSession()
 {
+    folderWatcher->stop();
+    saveFolderIndex();
+    folderIndex.clear();
+    folderScanner->cancel();
+    cancelScanButton->setVisible(false);
+    progressBar->setRange(0, 100);
+    prefetcher->clear();
     imageFiles.clear();
-    processedImages.clear();
+    queueIndexes.clear();
+    movedFromQueue.clear();
+    session.reset(0);
+    nearDuplicates->clear();
+    updateNearDuplicateStatus();
+    thumbnailModel->clear();
+    thumbnailModel->loader()->setStore(QSharedPointer<ThumbnailStore>());
+    undoStack.clear();
+    undoButton->setEnabled(false);
     currentImageIndex = -1;
     currentImagePath.clear();
     imageLabel->clear();
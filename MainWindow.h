@@ -1,6 +1,15 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include "ImagePrefetcher.h"
+#include "FolderScanner.h"
+#include "FolderWatcher.h"
+#include "SessionStore.h"
+#include "NearDuplicateIndex.h"
+#include "FileCommitQueue.h"
+#include "ClassificationManifest.h"
+#include "ThumbnailView.h"
+#include "ImageResampler.h"
 #include <QMainWindow>
 #include <QLabel>
 #include <QPushButton>
@@ -8,6 +17,8 @@
 #include <QComboBox>
 #include <QListWidget>
 #include <QProgressBar>
+#include <QCheckBox>
+#include <QShortcut>
 #include <QStringList>
 #include <QFileInfoList>
 #include <QVBoxLayout>
@@ -19,9 +30,12 @@
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QDir>
+#include <QImage>
 #include <QPixmap>
 #include <QResizeEvent>
 #include <QSet>
+#include <QHash>
+#include <QTimer>
 
 class MainWindow : public QMainWindow
 {
@@ -41,6 +55,9 @@ private slots:
     
     // Classification operations
     void classifyImage();
+    void classifySelectedImages();
+    void undoClassification();
+    void setRapidMode(bool enabled);
     void addNewCategory();
     void onCategorySelected(int index);
     
@@ -49,20 +66,73 @@ private slots:
     void previousImage();
     void skipImage();
     
+    // Folder scanning
+    void onScanBatch(const QStringList &paths);
+    void onScanFinished(int total);
+    void cancelScan();
+    void onFolderChanged(const QStringList &reportedAdded, const QStringList &reportedRemoved);
+    void onFilesRenamed(const QStringList &renamedFrom, const QStringList &renamedTo);
+    
+    // Near-duplicate handling
+    void onNearDuplicateOptionsChanged();
+    void updateNearDuplicateStatus();
+    
+    // Background copies
+    void onCommitFailed(const QString &imagePath, const QString &error);
+    void updateCommitStatus();
+    void showCommitFailures();
+    void onPlacementChanged(int index);
+    void onBatchProgress(int done, int total);
+    void onBatchFinished(int placed, int failed);
+    void onReverted(const QString &imagePath);
+    void onRevertFailed(const QString &imagePath, const QString &error);
+    
+    // Manifest-only mode
+    void setManifestOnly(bool enabled);
+    void compactManifest();
+    void onManifestCompacted(int recordsBefore, int recordsAfter);
+    void onManifestWriteFailed(const QString &error);
+    
+    // Thumbnail grid
+    void onThumbnailActivated(int row);
+    void onThumbnailSelectionChanged();
+    void selectNearDuplicates();
+    void compactThumbnailCache();
+    void onThumbnailCacheCompacted(qint64 bytesBefore, qint64 bytesAfter);
+    
+    // Display resolution
+    void setFullResolution(bool enabled);
+    void onResizeSettled();
+    
     // UI updates
     void updateImageDisplay();
     void updateProgress();
     void updateNavigationButtons();
 
 private:
+    // One classification action, for undo
+    struct Classification {
+        QStringList paths;            // The image plus near-duplicates or selection classified with it
+        QString category;
+        bool manifestOnly;
+    };
+    static const int MaxUndo = 20;
+    
     // Helper methods
     void setupUI();
+    void classifyCurrentImage(const QString &category);
+    void pushUndo(const Classification &classification);
+    void updateCategoryHotkeys();
     void loadImagesFromFolder(const QString &folderPath);
-    bool moveImageToCategory(const QString &imagePath, const QString &category);
+    void moveImageToCategory(const QString &imagePath, const QString &category);
     void createCategoryFolder(const QString &category);
-    bool isImageFile(const QString &filePath);
     void clearCurrentSession();
-    void scaleImageToFit();
+    void scaleImageToFit(ImageResampler::Quality quality = ImageResampler::Refined);
+    QSize displaySize() const;
+    bool updateDecodeSize();
+    void saveFolderIndex();
+    int queueIndexOf(const QString &path);
+    int nextQueueIndex() const;
     
     // UI Components
     QWidget *centralWidget;
@@ -72,36 +142,68 @@ private:
     QScrollArea *scrollArea;
     QLabel *imageLabel;
     QLabel *imageInfoLabel;
+    QPushButton *fullResolutionButton;
+    ThumbnailModel *thumbnailModel;
+    ThumbnailView *thumbnailView;
     QLabel *progressLabel;
     QProgressBar *progressBar;
+    QPushButton *cancelScanButton;
+    QLabel *commitStatusLabel;
+    QPushButton *commitFailuresButton;
+    QProgressBar *batchProgressBar;
     
     // Classification controls
     QGroupBox *classificationGroup;
     QComboBox *categoryComboBox;
     QLineEdit *newCategoryInput;
     QPushButton *addCategoryButton;
+    QComboBox *placementComboBox;
+    QCheckBox *deduplicateCheckBox;
+    QCheckBox *manifestOnlyCheckBox;
+    QPushButton *compactManifestButton;
     QListWidget *categoriesListWidget;
     
     // Action buttons
     QPushButton *openImageButton;
     QPushButton *openFolderButton;
+    QCheckBox *includeSubfoldersCheckBox;
     QPushButton *classifyButton;
+    QPushButton *classifySelectedButton;
+    QCheckBox *rapidModeCheckBox;
+    QLabel *hotkeyLabel;
+    QList<QShortcut *> categoryShortcuts;
+    QPushButton *undoButton;
     QPushButton *nextButton;
     QPushButton *previousButton;
     QPushButton *skipButton;
+    QCheckBox *skipNearDuplicatesCheckBox;
+    QCheckBox *applyToNearDuplicatesCheckBox;
+    QLabel *nearDuplicateLabel;
     
     // Data members
     QStringList imageFiles;           // List of all image file paths
-    QStringList processedImages;      // List of processed image paths
+    SessionStore session;             // Status of each entry of imageFiles, persisted per folder
+    QHash<QString, int> queueIndexes; // Path -> index in imageFiles; grows with it, cleared on removals
+    QSet<QString> movedFromQueue;     // Moved out of sourceFolder by commitQueue; stay queued for undo
     QSet<QString> categories;         // Set of available categories
     int currentImageIndex;            // Current image index
     QString currentImagePath;         // Current image file path
     QString sourceFolder;             // Source folder for batch processing
     QString outputFolder;             // Output folder for classified images
-    QPixmap currentPixmap;            // Current image pixmap
-    
-    // Constants
-    static const QStringList IMAGE_EXTENSIONS;
+    QImage currentImage;              // Current image (decoded at decodeSize)
+    QSize sourceImageSize;            // Full-resolution size of the current image
+    QSize decodeSize;                 // Decode target, invalid when loading full resolution
+    bool fullResolution;              // User asked to zoom in to 1:1
+    QTimer *resizeTimer;              // Debounces re-decoding after window resizes
+    ImagePrefetcher *prefetcher;      // Background decoder for neighbouring images
+    FolderScanner *folderScanner;     // Background enumerator for openFolder()
+    QSharedPointer<FolderIndex> folderIndex;  // Persistent index of sourceFolder, set once scanned
+    FolderWatcher *folderWatcher;     // Merges files added/removed while the folder is open
+    NearDuplicateIndex *nearDuplicates;  // Perceptual clusters of imageFiles, built in the background
+    QTimer *indexSaveTimer;           // Batches index writes after classifications
+    FileCommitQueue *commitQueue;     // Copies classified images off the GUI thread
+    ClassificationManifest *manifest; // Label records for manifest-only mode
+    QList<Classification> undoStack;  // Latest last, at most MaxUndo
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,304 @@
+#include "NearDuplicateIndex.h"
+#include "PerceptualHash.h"
+#include <QMetaObject>
+#include <QRunnable>
+#include <QSettings>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+
+const int BatchSize = 32;
+const int DefaultMaxDistance = 8;
+
+// Hashes a batch of images; unreadable files are reported separately
+class HashBatchTask : public QRunnable
+{
+public:
+    HashBatchTask(QObject *target, const QStringList &paths, quint64 generation)
+        : m_target(target), m_paths(paths), m_generation(generation)
+    {
+    }
+
+    void run() override
+    {
+        QStringList hashedPaths;
+        QByteArray hashes;
+        QStringList failedPaths;
+        for (const QString &path : m_paths) {
+            quint64 hash[2];
+            if (!PerceptualHash::compute(path, &hash[0], &hash[1])) {
+                failedPaths.append(path);
+                continue;
+            }
+            hashedPaths.append(path);
+            hashes.append(reinterpret_cast<const char *>(hash), sizeof(hash));
+        }
+
+        QMetaObject::invokeMethod(m_target, "onBatchHashed", Qt::QueuedConnection,
+                                  Q_ARG(QStringList, hashedPaths),
+                                  Q_ARG(QByteArray, hashes),
+                                  Q_ARG(QStringList, failedPaths),
+                                  Q_ARG(quint64, m_generation));
+    }
+
+private:
+    QObject *m_target;
+    QStringList m_paths;
+    quint64 m_generation;
+};
+
+} // namespace
+
+NearDuplicateIndex::NearDuplicateIndex(QObject *parent)
+    : QObject(parent),
+      m_maxDistance(QSettings().value("nearDuplicates/maxDistance", DefaultMaxDistance).toInt()),
+      m_hashed(0),
+      m_failed(0),
+      m_duplicates(0),
+      m_generation(0)
+{
+    // Leave a core for the GUI and the prefetcher
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+NearDuplicateIndex::~NearDuplicateIndex()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void NearDuplicateIndex::setMaxDistance(int distance)
+{
+    distance = qBound(0, distance, 32);
+    if (distance == m_maxDistance) {
+        return;
+    }
+    m_maxDistance = distance;
+    QSettings().setValue("nearDuplicates/maxDistance", distance);
+    recluster();
+    emit clustersChanged();
+}
+
+void NearDuplicateIndex::add(const QStringList &paths)
+{
+    QStringList batch;
+    for (const QString &path : paths) {
+        if (m_ids.contains(path)) {
+            continue;
+        }
+        int id = m_paths.size();
+        m_ids.insert(path, id);
+        m_paths.append(path);
+        m_dHashes.append(0);
+        m_pHashes.append(0);
+        m_states.append(Pending);
+        m_parent.append(id);
+
+        batch.append(path);
+        if (batch.size() == BatchSize) {
+            m_pool.start(new HashBatchTask(this, batch, m_generation), QThread::LowPriority);
+            batch.clear();
+        }
+    }
+    if (!batch.isEmpty()) {
+        m_pool.start(new HashBatchTask(this, batch, m_generation), QThread::LowPriority);
+    }
+}
+
+void NearDuplicateIndex::rename(const QString &from, const QString &to)
+{
+    int id = m_ids.value(from, -1);
+    if (id < 0 || m_ids.contains(to)) {
+        return;
+    }
+    m_ids.remove(from);
+    m_ids.insert(to, id);
+    m_paths[id] = to;
+
+    // A batch still hashing the old name drops its result, so hash it again
+    if (m_states[id] == Pending) {
+        m_pool.start(new HashBatchTask(this, QStringList() << to, m_generation), QThread::LowPriority);
+    }
+}
+
+void NearDuplicateIndex::remove(const QStringList &paths)
+{
+    bool changed = false;
+    for (const QString &path : paths) {
+        int id = m_ids.value(path, -1);
+        if (id < 0) {
+            continue;
+        }
+        m_ids.remove(path);
+        m_paths[id].clear();
+        if (m_states[id] == Hashed) {
+            m_hashed--;
+            changed = true;
+        } else if (m_states[id] == Failed) {
+            m_failed--;
+        }
+    }
+    if (changed) {
+        // The tree keeps the dead ids; link() skips them
+        recluster();
+        emit clustersChanged();
+    }
+}
+
+void NearDuplicateIndex::clear()
+{
+    m_pool.clear();
+    m_generation++;
+    m_tree.clear();
+    m_ids.clear();
+    m_paths.clear();
+    m_dHashes.clear();
+    m_pHashes.clear();
+    m_states.clear();
+    m_parent.clear();
+    m_members.clear();
+    m_hashed = 0;
+    m_failed = 0;
+    m_duplicates = 0;
+}
+
+void NearDuplicateIndex::onBatchHashed(const QStringList &paths, const QByteArray &hashes,
+                                       const QStringList &failedPaths, quint64 generation)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    for (const QString &path : failedPaths) {
+        int id = m_ids.value(path, -1);
+        if (id >= 0) {
+            m_states[id] = Failed;
+            m_failed++;
+        }
+    }
+    const quint64 *values = reinterpret_cast<const quint64 *>(hashes.constData());
+    bool changed = false;
+    for (int i = 0; i < paths.size(); ++i) {
+        int id = m_ids.value(paths[i], -1);
+        if (id < 0) {
+            // Removed while it was being hashed
+            continue;
+        }
+        m_dHashes[id] = values[2 * i];
+        m_pHashes[id] = values[2 * i + 1];
+        m_states[id] = Hashed;
+        m_hashed++;
+
+        int duplicatesBefore = m_duplicates;
+        link(id);
+        m_tree.insert(m_pHashes[id], id);
+        changed = changed || m_duplicates != duplicatesBefore;
+    }
+
+    emit progress(m_hashed, m_ids.size());
+    if (changed || !isRunning()) {
+        emit clustersChanged();
+    }
+}
+
+void NearDuplicateIndex::link(int id)
+{
+    const QVector<int> matches = m_tree.find(m_pHashes[id], m_maxDistance);
+    for (int match : matches) {
+        if (match != id && !m_paths[match].isEmpty() &&
+            PerceptualHash::distance(m_dHashes[match], m_dHashes[id]) <= m_maxDistance) {
+            unite(id, match);
+        }
+    }
+}
+
+int NearDuplicateIndex::find(int id) const
+{
+    while (m_parent[id] != id) {
+        m_parent[id] = m_parent[m_parent[id]];
+        id = m_parent[id];
+    }
+    return id;
+}
+
+void NearDuplicateIndex::unite(int a, int b)
+{
+    int rootA = find(a);
+    int rootB = find(b);
+    if (rootA == rootB) {
+        return;
+    }
+    if (rootB < rootA) {
+        std::swap(rootA, rootB);
+    }
+
+    // Merge the member lists into the smaller (earlier) root
+    QVector<int> membersA = m_members.take(rootA);
+    QVector<int> membersB = m_members.take(rootB);
+    if (membersA.isEmpty()) {
+        membersA.append(rootA);
+    }
+    if (membersB.isEmpty()) {
+        membersB.append(rootB);
+    }
+    QVector<int> merged;
+    merged.reserve(membersA.size() + membersB.size());
+    std::merge(membersA.constBegin(), membersA.constEnd(), membersB.constBegin(), membersB.constEnd(),
+               std::back_inserter(merged));
+    m_members.insert(rootA, merged);
+    m_parent[rootB] = rootA;
+    m_duplicates++;
+}
+
+void NearDuplicateIndex::recluster()
+{
+    m_tree.clear();
+    m_members.clear();
+    m_duplicates = 0;
+    for (int id = 0; id < m_parent.size(); ++id) {
+        m_parent[id] = id;
+    }
+    for (int id = 0; id < m_paths.size(); ++id) {
+        if (m_states[id] == Hashed && !m_paths[id].isEmpty()) {
+            link(id);
+            m_tree.insert(m_pHashes[id], id);
+        }
+    }
+}
+
+QString NearDuplicateIndex::representative(const QString &path) const
+{
+    int id = m_ids.value(path, -1);
+    if (id < 0) {
+        return path;
+    }
+    return m_paths[find(id)];
+}
+
+QStringList NearDuplicateIndex::cluster(const QString &path) const
+{
+    int id = m_ids.value(path, -1);
+    if (id < 0) {
+        return QStringList() << path;
+    }
+
+    const QVector<int> members = m_members.value(find(id));
+    if (members.isEmpty()) {
+        return QStringList() << path;
+    }
+    QStringList paths;
+    for (int member : members) {
+        paths.append(m_paths[member]);
+    }
+    return paths;
+}
+
+QString NearDuplicateIndex::statusText() const
+{
+    QString text = QString("Near-duplicates: %1").arg(m_duplicates);
+    if (isRunning()) {
+        text += QString(" (%1 of %2 images compared)").arg(m_hashed + m_failed).arg(m_ids.size());
+    }
+    return text;
+}
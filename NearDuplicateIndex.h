@@ -0,0 +1,94 @@
+#ifndef NEARDUPLICATEINDEX_H
+#define NEARDUPLICATEINDEX_H
+
+#include "BkTree.h"
+#include <QObject>
+#include <QThreadPool>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+
+/**
+ * @brief Groups near-identical images of the queue in the background
+ *
+ * Paths added to the index are hashed (PerceptualHash) by a low-priority
+ * worker pool. Each result is looked up in a BK-tree of the pHashes seen so
+ * far; images within maxDistance bits on both pHash and dHash join the same
+ * cluster (union-find, so clusters merge as hashes arrive in any order).
+ *
+ * The representative of a cluster is its member added first, i.e. the
+ * earliest in the queue; every other member is a near-duplicate of it.
+ */
+class NearDuplicateIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NearDuplicateIndex(QObject *parent = nullptr);
+    ~NearDuplicateIndex();
+
+    // Maximum Hamming distance (out of 64 bits) for two images to match;
+    // stored in "nearDuplicates/maxDistance"
+    void setMaxDistance(int distance);
+    int maxDistance() const { return m_maxDistance; }
+
+    // Start hashing paths; they are appended in queue order
+    void add(const QStringList &paths);
+    void remove(const QStringList &paths);
+    // Same file under a new name; keeps its hashes and cluster
+    void rename(const QString &from, const QString &to);
+    void clear();
+
+    int count() const { return m_ids.size(); }
+    int hashedCount() const { return m_hashed; }
+    bool isRunning() const { return m_hashed + m_failed < m_ids.size(); }
+
+    // Earliest member of the cluster of path (path itself if it has none)
+    QString representative(const QString &path) const;
+    bool isNearDuplicate(const QString &path) const { return representative(path) != path; }
+
+    // All members of the cluster of path in queue order, path included
+    QStringList cluster(const QString &path) const;
+
+    // Images that are near-duplicates of an earlier one
+    int duplicateCount() const { return m_duplicates; }
+    QString statusText() const;
+
+signals:
+    void progress(int hashed, int total);
+    void clustersChanged();
+
+private slots:
+    void onBatchHashed(const QStringList &paths, const QByteArray &hashes,
+                       const QStringList &failedPaths, quint64 generation);
+
+private:
+    enum State : quint8 {
+        Pending,
+        Hashed,
+        Failed
+    };
+
+    int find(int id) const;
+    void unite(int a, int b);
+    void recluster();
+    void link(int id);
+
+    QThreadPool m_pool;
+    BkTree m_tree;                     // pHash -> id
+    QHash<QString, int> m_ids;         // Live paths
+    QStringList m_paths;               // id -> path, empty once removed
+    QVector<quint64> m_dHashes;
+    QVector<quint64> m_pHashes;
+    QVector<quint8> m_states;
+    mutable QVector<int> m_parent;     // Union-find; roots are the smallest id
+    QHash<int, QVector<int>> m_members;   // Root -> ids of its cluster (only clusters > 1)
+    int m_maxDistance;
+    int m_hashed;                      // Live paths per state
+    int m_failed;
+    int m_duplicates;
+    quint64 m_generation;
+};
+
+#endif // NEARDUPLICATEINDEX_H
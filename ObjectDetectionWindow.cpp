@@ -1,29 +1,61 @@
 #include "ObjectDetectionWindow.h"
+#include "ImageCache.h"
+#include "ImageLoader.h"
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QFileInfo>
+#include <QDateTime>
+#include <QStatusBar>
 #include <QDir>
 #include <QCloseEvent>
 #include <QSplitter>
 #include <QScrollArea>
-
-const QStringList ObjectDetectionWindow::IMAGE_EXTENSIONS = {"*.jpg", "*.jpeg", "*.png", "*.bmp", "*.JPG", "*.JPEG", "*.PNG", "*.BMP"};
+#include <QSet>
+#include <QSettings>
+#include <QDebug>
 
 ObjectDetectionWindow::ObjectDetectionWindow(QWidget *parent)
     : QMainWindow(parent),
-      currentImageIndex(-1)
+      currentImageIndex(-1),
+      prefetcher(new ImagePrefetcher(this)),
+      folderScanner(new FolderScanner(this)),
+      folderWatcher(new FolderWatcher(this)),
+      nearDuplicates(new NearDuplicateIndex(this)),
+      indexSaveTimer(new QTimer(this)),
+      reportedLinkedCount(0),
+      annotationExporter(new AnnotationExporter(this)),
+      cocoExporter(new CocoExporter(this)),
+      vocImporter(new VocImporter(this)),
+      annotationIndex(new AnnotationIndex(this)),
+      vocSaveBatches(0),
+      vocDocuments(-1),
+      vocImported(0),
+      vocDuplicates(0),
+      vocFailed(0)
 {
+    indexSaveTimer->setSingleShot(true);
+    indexSaveTimer->setInterval(5000);
+    connect(indexSaveTimer, &QTimer::timeout, this, &ObjectDetectionWindow::saveFolderIndex);
+    
+    // Own setting: the classification window may use Move, which would take
+    // annotated images out of the source folder
+    FilePlacement::Strategy placement = FilePlacement::savedStrategy("annotations/placement");
+    annotationManager.setPlacementStrategy(placement == FilePlacement::Move ? FilePlacement::Copy : placement);
+    annotationManager.setDeduplicate(QSettings().value("placement/deduplicate", true).toBool());
+    annotationManager.setStorageBackend(AnnotationManager::savedStorageBackend());
     setupUI();
     setWindowTitle("Object Detection Annotation Tool");
     resize(1400, 900);
     
     // Initialize annotation manager
     annotationManager.setOutputDirectory("annotated_images");
+    annotationIndex->setSource(annotationManager.outputDirectory() + "/labels", annotationManager.store());
 }
 
 ObjectDetectionWindow::~ObjectDetectionWindow()
 {
+    saveFolderIndex();
 }
 
 void ObjectDetectionWindow::setupUI()
@@ -49,8 +81,14 @@ void ObjectDetectionWindow::setupUI()
     QHBoxLayout *fileButtonsLayout = new QHBoxLayout();
     openImageButton = new QPushButton("Open Single Image", this);
     openFolderButton = new QPushButton("Open Folder", this);
+    includeSubfoldersCheckBox = new QCheckBox("Include subfolders", this);
     fileButtonsLayout->addWidget(openImageButton);
     fileButtonsLayout->addWidget(openFolderButton);
+    fileButtonsLayout->addWidget(includeSubfoldersCheckBox);
+    importVocButton = new QPushButton("Import Pascal VOC", this);
+    importVocButton->setToolTip("Read the boxes of a folder of Pascal VOC XML files into the output folder; "
+                                "images of the open folder are marked as annotated");
+    fileButtonsLayout->addWidget(importVocButton);
     leftLayout->addLayout(fileButtonsLayout);
     
     // Progress information
@@ -62,7 +100,12 @@ void ObjectDetectionWindow::setupUI()
     progressBar->setMinimum(0);
     progressBar->setMaximum(100);
     progressBar->setValue(0);
-    leftLayout->addWidget(progressBar);
+    cancelScanButton = new QPushButton("Cancel Scan", this);
+    cancelScanButton->setVisible(false);
+    QHBoxLayout *progressLayout = new QHBoxLayout();
+    progressLayout->addWidget(progressBar, 1);
+    progressLayout->addWidget(cancelScanButton);
+    leftLayout->addLayout(progressLayout);
     
     // Image canvas
     QGroupBox *imageGroup = new QGroupBox("Image Canvas - Draw bounding boxes by clicking and dragging", this);
@@ -87,10 +130,58 @@ void ObjectDetectionWindow::setupUI()
     saveAndNextButton->setEnabled(false);
     saveAndNextButton->setStyleSheet("QPushButton:enabled { background-color: #4CAF50; color: white; font-weight: bold; }");
     
+    QLabel *placementLabel = new QLabel("Place images by:", this);
+    placementComboBox = new QComboBox(this);
+    QStringList placementNames = FilePlacement::strategyNames();
+    placementNames.removeOne(FilePlacement::strategyName(FilePlacement::Move));
+    placementComboBox->addItems(placementNames);
+    placementComboBox->setCurrentText(FilePlacement::strategyName(annotationManager.placementStrategy()));
+    placementComboBox->setToolTip("How images are put into the output folder. Reflink and Hardlink share data "
+                                  "with the original on the same filesystem; unsupported methods fall back to copying.");
+    
     saveButtonsLayout->addWidget(saveButton);
     saveButtonsLayout->addWidget(saveAndNextButton);
+    saveButtonsLayout->addWidget(placementLabel);
+    saveButtonsLayout->addWidget(placementComboBox);
     leftLayout->addLayout(saveButtonsLayout);
     
+    QHBoxLayout *storageLayout = new QHBoxLayout();
+    QLabel *storageLabel = new QLabel("Store annotations in:", this);
+    storageComboBox = new QComboBox(this);
+    storageComboBox->addItem("Text files per image", AnnotationManager::LabelFiles);
+    storageComboBox->addItem("Single packed file", AnnotationManager::PackedStore);
+    storageComboBox->setCurrentIndex(storageComboBox->findData(annotationManager.storageBackend()));
+    storageComboBox->setToolTip("A single packed file (annotations.pack) avoids one small file per image on "
+                                "large datasets; use Export YOLO Labels to write the labels folder from it.");
+    exportLabelsButton = new QPushButton("Export YOLO Labels", this);
+    exportLabelsButton->setEnabled(annotationManager.storageBackend() == AnnotationManager::PackedStore);
+    storageLayout->addWidget(storageLabel);
+    storageLayout->addWidget(storageComboBox);
+    storageLayout->addWidget(exportLabelsButton);
+    exportCocoButton = new QPushButton("Export COCO JSON", this);
+    exportCocoButton->setToolTip("Write all images in the output folder and their boxes to a single COCO file");
+    storageLayout->addWidget(exportCocoButton);
+    storageLayout->addStretch();
+    leftLayout->addLayout(storageLayout);
+    
+    QHBoxLayout *nearDuplicateLayout = new QHBoxLayout();
+    skipNearDuplicatesCheckBox = new QCheckBox("Skip near-duplicates", this);
+    skipNearDuplicatesCheckBox->setToolTip("Next and Skip pass over images that look the same as an earlier one, "
+                                           "such as burst frames");
+    applyToNearDuplicatesCheckBox = new QCheckBox("Copy boxes to near-duplicates", this);
+    applyToNearDuplicatesCheckBox->setToolTip("Saving also annotates the unprocessed near-duplicates of the image "
+                                              "with the same boxes, scaled to their size");
+    nearDuplicateLayout->addWidget(skipNearDuplicatesCheckBox);
+    nearDuplicateLayout->addWidget(applyToNearDuplicatesCheckBox);
+    nearDuplicateLayout->addStretch();
+    QLabel *classFilterLabel = new QLabel("Navigate:", this);
+    classFilterComboBox = new QComboBox(this);
+    classFilterComboBox->addItem("All images", -1);
+    classFilterComboBox->setToolTip("Previous and Next only stop at images containing the selected label");
+    nearDuplicateLayout->addWidget(classFilterLabel);
+    nearDuplicateLayout->addWidget(classFilterComboBox);
+    leftLayout->addLayout(nearDuplicateLayout);
+    
     QHBoxLayout *navigationLayout = new QHBoxLayout();
     previousButton = new QPushButton("← Previous", this);
     skipButton = new QPushButton("Skip", this);
@@ -154,7 +245,9 @@ void ObjectDetectionWindow::setupUI()
         "• Click and drag to draw bounding box<br>"
         "• Click box to select it<br>"
         "• Press Delete to remove selected box<br>"
-        "• Drag corners to resize box", this);
+        "• Drag corners to resize box<br>"
+        "• Mouse wheel or +/- to zoom, 0 to fit<br>"
+        "• Right or middle drag to pan", this);
     instructionLabel->setWordWrap(true);
     instructionLabel->setStyleSheet("QLabel { background-color: #f0f0f0; padding: 10px; border-radius: 5px; }");
     boxListLayout->addWidget(instructionLabel);
@@ -172,6 +265,28 @@ void ObjectDetectionWindow::setupUI()
     // Connect signals and slots
     connect(openImageButton, &QPushButton::clicked, this, &ObjectDetectionWindow::openImage);
     connect(openFolderButton, &QPushButton::clicked, this, &ObjectDetectionWindow::openFolder);
+    connect(cancelScanButton, &QPushButton::clicked, this, &ObjectDetectionWindow::cancelScan);
+    connect(importVocButton, &QPushButton::clicked, this, &ObjectDetectionWindow::importVoc);
+    connect(vocImporter, &VocImporter::documentsParsed, this, &ObjectDetectionWindow::onVocDocumentsParsed);
+    connect(vocImporter, &VocImporter::finished, this, &ObjectDetectionWindow::onVocImportFinished);
+    connect(folderScanner, &FolderScanner::batchFound, this, &ObjectDetectionWindow::onScanBatch);
+    connect(folderScanner, &FolderScanner::finished, this, &ObjectDetectionWindow::onScanFinished);
+    connect(folderWatcher, &FolderWatcher::filesRenamed, this, &ObjectDetectionWindow::onFilesRenamed);
+    connect(folderWatcher, &FolderWatcher::filesChanged, this, &ObjectDetectionWindow::onFolderChanged);
+    connect(placementComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ObjectDetectionWindow::onPlacementChanged);
+    connect(storageComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ObjectDetectionWindow::onStorageBackendChanged);
+    connect(exportLabelsButton, &QPushButton::clicked, this, &ObjectDetectionWindow::exportYoloLabels);
+    connect(annotationExporter, &AnnotationExporter::progress, this, &ObjectDetectionWindow::onExportProgress);
+    connect(annotationExporter, &AnnotationExporter::finished, this, &ObjectDetectionWindow::onExportFinished);
+    connect(exportCocoButton, &QPushButton::clicked, this, &ObjectDetectionWindow::exportCocoJson);
+    connect(cocoExporter, &CocoExporter::progress, this, &ObjectDetectionWindow::onCocoExportProgress);
+    connect(cocoExporter, &CocoExporter::finished, this, &ObjectDetectionWindow::onCocoExportFinished);
+    connect(nearDuplicates, &NearDuplicateIndex::clustersChanged, this, &ObjectDetectionWindow::updateNearDuplicateStatus);
+    connect(nearDuplicates, &NearDuplicateIndex::progress, this, &ObjectDetectionWindow::updateNearDuplicateStatus);
+    connect(skipNearDuplicatesCheckBox, &QCheckBox::toggled, this, &ObjectDetectionWindow::onNearDuplicateOptionsChanged);
+    connect(classFilterComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ObjectDetectionWindow::onClassFilterChanged);
+    connect(annotationIndex, &AnnotationIndex::changed, this, &ObjectDetectionWindow::updateDatasetStatistics);
+    connect(applyToNearDuplicatesCheckBox, &QCheckBox::toggled, this, &ObjectDetectionWindow::onNearDuplicateOptionsChanged);
     connect(addLabelButton, &QPushButton::clicked, this, &ObjectDetectionWindow::addNewLabel);
     connect(newLabelInput, &QLineEdit::returnPressed, this, &ObjectDetectionWindow::addNewLabel);
     connect(labelsListWidget, &QListWidget::itemClicked, this, &ObjectDetectionWindow::onLabelListItemClicked);
@@ -188,6 +303,19 @@ void ObjectDetectionWindow::setupUI()
     connect(nextButton, &QPushButton::clicked, this, &ObjectDetectionWindow::nextImage);
     connect(previousButton, &QPushButton::clicked, this, &ObjectDetectionWindow::previousImage);
     connect(skipButton, &QPushButton::clicked, this, &ObjectDetectionWindow::skipImage);
+    
+    nearDuplicateLabel = new QLabel(this);
+    nearDuplicateLabel->setVisible(false);
+    statusBar()->addPermanentWidget(nearDuplicateLabel);
+    datasetStatsLabel = new QLabel(this);
+    datasetStatsLabel->setVisible(false);
+    statusBar()->addPermanentWidget(datasetStatsLabel);
+    exportProgressBar = new QProgressBar(this);
+    exportProgressBar->setMaximumWidth(160);
+    exportProgressBar->setVisible(false);
+    statusBar()->addPermanentWidget(exportProgressBar);
+    skipNearDuplicatesCheckBox->setChecked(QSettings().value("nearDuplicates/skip", false).toBool());
+    applyToNearDuplicatesCheckBox->setChecked(QSettings().value("nearDuplicates/propagate", false).toBool());
 }
 
 void ObjectDetectionWindow::openImage()
@@ -200,6 +328,8 @@ void ObjectDetectionWindow::openImage()
     if (!fileName.isEmpty()) {
         clearCurrentSession();
         imageFiles.append(fileName);
+        session.resize(imageFiles.size());
+        annotationIndex->append(imageFiles);
         currentImageIndex = 0;
         currentImagePath = fileName;
         updateImageDisplay();
@@ -219,37 +349,451 @@ void ObjectDetectionWindow::openFolder()
         clearCurrentSession();
         sourceFolder = folderPath;
         loadImagesFromFolder(folderPath);
+    }
+}
+
+void ObjectDetectionWindow::loadImagesFromFolder(const QString &folderPath)
+{
+    // Images arrive in batches through onScanBatch(); the first one is shown
+    // as soon as it is found.
+    folderScanner->start(folderPath, includeSubfoldersCheckBox->isChecked());
+    cancelScanButton->setVisible(true);
+    updateProgress();
+}
+
+void ObjectDetectionWindow::onScanBatch(const QStringList &paths)
+{
+    imageFiles.append(paths);
+    session.resize(imageFiles.size());
+    nearDuplicates->add(paths);
+    annotationIndex->append(paths);
+    
+    if (currentImageIndex < 0) {
+        currentImageIndex = 0;
+        currentImagePath = imageFiles[0];
+        updateImageDisplay();
+    } else {
+        // Neighbours of the current image may only exist now
+        prefetcher->prefetchAround(imageFiles, currentImageIndex);
+    }
+    
+    updateProgress();
+    updateNavigationButtons();
+}
+
+void ObjectDetectionWindow::onScanFinished(int total)
+{
+    Q_UNUSED(total);
+    cancelScanButton->setVisible(false);
+    
+    // Restore the annotated state saved with the index, keeping anything
+    // saved while the scan was still running
+    folderIndex = folderScanner->index();
+    if (folderIndex) {
+        // Rows of a freshly scanned index are queue indexes. The session file
+        // restores statuses and position exactly; when it is missing or the
+        // folder changed since, the statuses saved in the index are used.
+        bool resumed = session.open(folderIndex->rootPath(), folderIndex->isRecursive(), "detection",
+                                    SessionStore::fingerprint(imageFiles));
+        int rows = qMin(folderIndex->count(), session.count());
+        for (int row = 0; row < rows; ++row) {
+            if (!resumed && folderIndex->isProcessed(row, FolderIndex::Annotated)) {
+                session.setStatus(row, SessionStore::Processed);
+            }
+            if (session.isProcessed(row)) {
+                folderIndex->setProcessed(row, FolderIndex::Annotated, true);
+            }
+        }
+        if (folderIndex->isDirty()) {
+            indexSaveTimer->start();
+        }
+        
+        // From now on new and deleted files are merged into the queue
+        folderWatcher->start(folderIndex->rootPath(), folderIndex->isRecursive(),
+                             folderIndex->directoryPaths(), imageFiles);
         
-        if (imageFiles.isEmpty()) {
-            QMessageBox::warning(this, "No Images Found",
-                "No supported image files (JPG, PNG, BMP) were found in the selected folder.");
-            return;
+        // Continue where the previous session stopped, unless the user
+        // already moved on while the folder was scanned
+        int resumeIndex = session.currentIndex();
+        if (resumed && currentImageIndex == 0 && resumeIndex > 0 && resumeIndex < imageFiles.size()) {
+            currentImageIndex = resumeIndex;
+            updateImageDisplay();
+            updateNavigationButtons();
+            statusBar()->showMessage(QString("Resumed at image %1 of %2")
+                .arg(resumeIndex + 1).arg(imageFiles.size()), 5000);
+        }
+    }
+    
+    updateProgress();
+    
+    if (imageFiles.isEmpty()) {
+        QMessageBox::warning(this, "No Images Found",
+            "No supported image files (JPG, PNG, BMP) were found in the selected folder.");
+    }
+}
+
+void ObjectDetectionWindow::cancelScan()
+{
+    if (!folderScanner->isRunning()) {
+        return;
+    }
+    
+    folderScanner->cancel();
+    cancelScanButton->setVisible(false);
+    updateProgress();
+    statusBar()->showMessage(QString("Folder scan cancelled after %1 images").arg(imageFiles.size()), 5000);
+}
+
+void ObjectDetectionWindow::onFolderChanged(const QStringList &added, const QStringList &removed)
+{
+    // Entries before the current image shift it down; the current image
+    // itself stays on screen unless it was removed.
+    bool currentRemoved = false;
+    if (!removed.isEmpty()) {
+        QSet<QString> removedSet;
+        for (const QString &path : removed) {
+            removedSet.insert(path);
         }
         
-        currentImageIndex = 0;
-        currentImagePath = imageFiles[0];
+        QStringList remaining;
+        remaining.reserve(imageFiles.size());
+        QVector<int> removedIndexes;
+        int removedBefore = 0;
+        for (int i = 0; i < imageFiles.size(); ++i) {
+            if (removedSet.contains(imageFiles[i])) {
+                removedIndexes.append(i);
+                if (i < currentImageIndex) {
+                    removedBefore++;
+                } else if (i == currentImageIndex) {
+                    currentRemoved = true;
+                }
+                continue;
+            }
+            remaining.append(imageFiles[i]);
+        }
+        imageFiles = remaining;
+        queueIndexes.clear();
+        currentImageIndex -= removedBefore;
+        
+        session.removeIndexes(removedIndexes);
+        annotationIndex->removeIndexes(removedIndexes);
+        nearDuplicates->remove(removed);
+        
+        if (folderIndex) {
+            folderIndex->removeFiles(removed);
+        }
+    }
+    
+    // New files join the end of the queue
+    imageFiles.append(added);
+    session.resize(imageFiles.size());
+    annotationIndex->append(added);
+    session.setFingerprint(SessionStore::fingerprint(imageFiles));
+    nearDuplicates->add(added);
+    if (folderIndex) {
+        for (const QString &path : added) {
+            folderIndex->addFile(path);
+        }
+        if (folderIndex->isDirty()) {
+            indexSaveTimer->start();
+        }
+    }
+    
+    if (imageFiles.isEmpty()) {
+        currentImageIndex = -1;
+        currentImagePath.clear();
+        imageCanvas->clearImage();
+        imageInfoLabel->setText("");
+        boxListWidget->clear();
+    } else if (currentImageIndex < 0 || currentRemoved) {
+        // Show the image that followed the removed one
+        currentImageIndex = qBound(0, currentImageIndex, imageFiles.size() - 1);
         updateImageDisplay();
-        updateProgress();
-        updateNavigationButtons();
+    } else {
+        prefetcher->prefetchAround(imageFiles, currentImageIndex);
     }
+    
+    updateProgress();
+    updateNavigationButtons();
+    statusBar()->showMessage(QString("Folder changed: %1 images added, %2 removed")
+        .arg(added.size()).arg(removed.size()), 5000);
 }
 
-void ObjectDetectionWindow::loadImagesFromFolder(const QString &folderPath)
+void ObjectDetectionWindow::onFilesRenamed(const QStringList &renamedFrom, const QStringList &renamedTo)
 {
-    QDir dir(folderPath);
-    QFileInfoList fileList = dir.entryInfoList(IMAGE_EXTENSIONS, QDir::Files | QDir::NoDotAndDotDot);
+    // A renamed image keeps its queue position and status; the current
+    // image stays where it is. Its labels follow the image name, so they
+    // are looked up again.
+    int renamed = 0;
+    for (int i = 0; i < renamedFrom.size(); ++i) {
+        const QString &from = renamedFrom[i];
+        const QString &to = renamedTo[i];
+        int index = queueIndexOf(from);
+        if (index < 0) {
+            onFolderChanged(QStringList() << to, QStringList() << from);
+            continue;
+        }
+        
+        imageFiles[index] = to;
+        queueIndexes.remove(from);
+        queueIndexes.insert(to, index);
+        if (index == currentImageIndex) {
+            currentImagePath = to;
+        }
+        
+        annotationIndex->renameImage(index, to);
+        nearDuplicates->rename(from, to);
+        if (folderIndex) {
+            folderIndex->renameFile(from, to);
+        }
+        renamed++;
+    }
+    if (renamed == 0) {
+        return;
+    }
+    
+    session.setFingerprint(SessionStore::fingerprint(imageFiles));
+    if (folderIndex && folderIndex->isDirty()) {
+        indexSaveTimer->start();
+    }
+    if (currentImageIndex >= 0) {
+        prefetcher->prefetchAround(imageFiles, currentImageIndex);
+    }
+    statusBar()->showMessage(QString("Folder changed: %1 images renamed").arg(renamed), 5000);
+}
+
+void ObjectDetectionWindow::onPlacementChanged(int index)
+{
+    FilePlacement::Strategy strategy = FilePlacement::strategyFromName(placementComboBox->itemText(index));
+    annotationManager.setPlacementStrategy(strategy);
+    FilePlacement::saveStrategy(strategy, "annotations/placement");
+}
+
+void ObjectDetectionWindow::onStorageBackendChanged(int index)
+{
+    AnnotationManager::StorageBackend backend =
+        static_cast<AnnotationManager::StorageBackend>(storageComboBox->itemData(index).toInt());
+    if (!annotationManager.setStorageBackend(backend)) {
+        QMessageBox::warning(this, "Annotation Storage",
+            "Could not open " + annotationManager.outputDirectory() + "/annotations.pack");
+    }
+    AnnotationManager::saveStorageBackend(backend);
+    exportLabelsButton->setEnabled(backend == AnnotationManager::PackedStore && !annotationExporter->isRunning());
     
-    for (const QFileInfo &fileInfo : fileList) {
-        if (isImageFile(fileInfo.absoluteFilePath())) {
-            imageFiles.append(fileInfo.absoluteFilePath());
+    // Boxes now come from the other backend
+    annotationIndex->setSource(annotationManager.outputDirectory() + "/labels", annotationManager.store());
+    annotationIndex->append(imageFiles);
+    if (!currentImagePath.isEmpty()) {
+        loadAnnotationsForCurrentImage();
+    }
+}
+
+void ObjectDetectionWindow::exportYoloLabels()
+{
+    QSharedPointer<AnnotationStore> store = annotationManager.store();
+    if (!store || annotationExporter->isRunning()) {
+        return;
+    }
+    if (annotationManager.labelsDirty()) {
+        annotationManager.saveClassesFile();
+    }
+    exportLabelsButton->setEnabled(false);
+    annotationExporter->start(store, annotationManager.outputDirectory() + "/labels");
+}
+
+void ObjectDetectionWindow::onExportProgress(int done, int total)
+{
+    exportProgressBar->setMaximum(total);
+    exportProgressBar->setValue(done);
+    exportProgressBar->setVisible(true);
+}
+
+void ObjectDetectionWindow::onExportFinished(int written, int failed)
+{
+    exportProgressBar->setVisible(false);
+    exportLabelsButton->setEnabled(annotationManager.storageBackend() == AnnotationManager::PackedStore);
+    
+    QString message = QString("Exported %1 label files").arg(written);
+    if (failed > 0) {
+        message += QString(", %1 failed").arg(failed);
+    }
+    statusBar()->showMessage(message, 5000);
+}
+
+void ObjectDetectionWindow::importVoc()
+{
+    if (vocImporter->isRunning() || vocSaveBatches > 0) {
+        return;
+    }
+    QString folderPath = QFileDialog::getExistingDirectory(this,
+        "Open Folder Containing Pascal VOC XML Files",
+        sourceFolder.isEmpty() ? QDir::homePath() : sourceFolder,
+        QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
+    if (folderPath.isEmpty()) {
+        return;
+    }
+    
+    vocDocuments = -1;
+    vocImported = 0;
+    vocDuplicates = 0;
+    vocFailed = 0;
+    
+    importVocButton->setEnabled(false);
+    statusBar()->showMessage("Importing Pascal VOC annotations...");
+    vocImporter->start(folderPath, imageFiles);
+}
+
+void ObjectDetectionWindow::onVocDocumentsParsed()
+{
+    // The workers already found and probed the images; only the label
+    // table, which is not thread-safe, is touched here
+    bool labelsAdded = false;
+    QVector<AnnotationManager::PendingAnnotation> annotations;
+    for (const VocImporter::Document &document : vocImporter->takeParsed()) {
+        if (!document.error.isEmpty()) {
+            vocFailed++;
+            continue;
+        }
+        // Saves of one image could finish in any order, so only the first
+        // document naming it is used
+        if (vocImages.contains(document.imagePath)) {
+            vocDuplicates++;
+            continue;
         }
+        vocImages.insert(document.imagePath);
+        
+        AnnotationManager::PendingAnnotation annotation;
+        annotation.imagePath = document.imagePath;
+        annotation.imageSize = document.imageSize;
+        for (const VocImporter::Object &object : document.objects) {
+            if (!annotationManager.hasLabel(object.name)) {
+                annotationManager.addLabel(object.name);
+                labelsListWidget->addItem(object.name);
+                labelsAdded = true;
+            }
+            annotation.boxes.append(BoundingBox(object.rect, object.name, annotationManager.getClassId(object.name)));
+        }
+        vocPendingSaves.insert(annotation.imagePath, annotation);
+        annotations.append(annotation);
+    }
+    
+    if (labelsAdded) {
+        updateDatasetStatistics();
+    }
+    if (!annotations.isEmpty()) {
+        // Label files and image placement run on the annotation manager's pool
+        vocSaveBatches++;
+        annotationManager.saveAnnotationsInBackground(annotations, this, "onVocAnnotationsSaved");
     }
 }
 
-bool ObjectDetectionWindow::isImageFile(const QString &filePath)
+void ObjectDetectionWindow::onVocAnnotationsSaved(const QStringList &saved, const QStringList &failed)
 {
-    QString extension = QFileInfo(filePath).suffix().toLower();
-    return (extension == "jpg" || extension == "jpeg" || extension == "png" || extension == "bmp");
+    vocSaveBatches--;
+    vocFailed += failed.size();
+    for (const QString &imagePath : failed) {
+        vocPendingSaves.remove(imagePath);
+    }
+    
+    bool currentChanged = false;
+    for (const QString &imagePath : saved) {
+        vocImported++;
+        AnnotationManager::PendingAnnotation annotation = vocPendingSaves.take(imagePath);
+        int index = queueIndexOf(imagePath);
+        if (annotation.imagePath.isEmpty() || index < 0) {
+            continue;
+        }
+        annotationIndex->setBoxes(index, annotation.boxes, annotation.imageSize.width(), annotation.imageSize.height());
+        session.setStatus(index, SessionStore::Processed);
+        if (folderIndex) {
+            folderIndex->setProcessed(imagePath, FolderIndex::Annotated, true);
+        }
+        currentChanged = currentChanged || index == currentImageIndex;
+    }
+    
+    indexSaveTimer->start();
+    if (currentChanged) {
+        loadAnnotationsForCurrentImage();
+        updateBoxList();
+    }
+    updateProgress();
+    if (vocDocuments < 0 || vocSaveBatches > 0) {
+        statusBar()->showMessage(QString("Importing Pascal VOC annotations... %1 images").arg(vocImported));
+    }
+    finishVocImportIfDone();
+}
+
+void ObjectDetectionWindow::onVocImportFinished(int documents, int failed)
+{
+    Q_UNUSED(failed);   // Already counted in vocFailed as the documents arrived
+    vocDocuments = documents;
+    finishVocImportIfDone();
+}
+
+void ObjectDetectionWindow::finishVocImportIfDone()
+{
+    if (vocDocuments < 0 || vocSaveBatches > 0) {
+        return;
+    }
+    importVocButton->setEnabled(true);
+    vocImages.clear();
+    vocPendingSaves.clear();
+    
+    QString message = QString("Imported %1 of %2 Pascal VOC files").arg(vocImported).arg(vocDocuments);
+    if (vocFailed > 0) {
+        message += QString(", %1 skipped (unreadable or image not found)").arg(vocFailed);
+    }
+    if (vocDuplicates > 0) {
+        message += QString(", %1 skipped (image already imported from another file)").arg(vocDuplicates);
+    }
+    statusBar()->showMessage(message, 5000);
+    vocDocuments = -1;
+}
+
+void ObjectDetectionWindow::exportCocoJson()
+{
+    if (cocoExporter->isRunning()) {
+        return;
+    }
+    QString outputDirectory = annotationManager.outputDirectory();
+    QString fileName = QFileDialog::getSaveFileName(this,
+        "Export COCO JSON",
+        outputDirectory + "/annotations.json",
+        "JSON Files (*.json);;All Files (*)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    
+    QMap<int, QString> categories;
+    for (const QString &label : annotationManager.labels()) {
+        categories.insert(annotationManager.getClassId(label), label);
+    }
+    
+    exportCocoButton->setEnabled(false);
+    cocoExporter->start(fileName, outputDirectory + "/images", outputDirectory + "/labels",
+                        annotationManager.store(), categories);
+    statusBar()->showMessage("Exporting COCO JSON...");
+}
+
+void ObjectDetectionWindow::onCocoExportProgress(int images)
+{
+    statusBar()->showMessage(QString("Exporting COCO JSON... %1 images").arg(images));
+}
+
+void ObjectDetectionWindow::onCocoExportFinished(bool success, int images, int annotations, int failed)
+{
+    exportCocoButton->setEnabled(true);
+    if (!success) {
+        statusBar()->clearMessage();
+        QMessageBox::warning(this, "Export COCO JSON", "The COCO file could not be written.");
+        return;
+    }
+    
+    QString message = QString("Exported %1 images and %2 boxes to COCO JSON").arg(images).arg(annotations);
+    if (failed > 0) {
+        message += QString(", %1 unreadable images skipped").arg(failed);
+    }
+    statusBar()->showMessage(message, 5000);
 }
 
 void ObjectDetectionWindow::addNewLabel()
@@ -272,6 +816,7 @@ void ObjectDetectionWindow::addNewLabel()
     annotationManager.addLabel(newLabel);
     labelsListWidget->addItem(newLabel);
     newLabelInput->clear();
+    updateDatasetStatistics();
 
     QMessageBox::information(this, "Label Added",
         QString("Label '%1' has been added successfully.").arg(newLabel));
@@ -368,21 +913,78 @@ void ObjectDetectionWindow::saveCurrentAnnotations()
         imageCanvas->imageWidth(), imageCanvas->imageHeight());
 
     if (success) {
-        // Copy image to output directory
+        // Copy image to output directory (in the background)
         annotationManager.copyImageToOutput(currentImagePath);
 
         // Mark as processed
-        if (!processedImages.contains(currentImagePath)) {
-            processedImages.append(currentImagePath);
+        annotationIndex->setBoxes(currentImageIndex, boxes,
+                                  imageCanvas->imageWidth(), imageCanvas->imageHeight());
+        session.setStatus(currentImageIndex, SessionStore::Processed);
+        if (folderIndex) {
+            folderIndex->setProcessed(currentImagePath, FolderIndex::Annotated, true);
+        }
+        indexSaveTimer->start();
+
+        int propagated = 0;
+        if (applyToNearDuplicatesCheckBox->isChecked()) {
+            propagated = annotateNearDuplicates(boxes);
         }
 
         updateProgress();
-        QMessageBox::information(this, "Success", "Annotations saved successfully!");
+        QString message = "Annotations saved successfully!";
+        if (propagated > 0) {
+            message += QString("\nThe boxes were also saved for %1 near-duplicates.").arg(propagated);
+        }
+        QMessageBox::information(this, "Success", message);
     } else {
         QMessageBox::critical(this, "Error", "Failed to save annotations.");
     }
 }
 
+int ObjectDetectionWindow::annotateNearDuplicates(const QList<BoundingBox> &boxes)
+{
+    int width = imageCanvas->imageWidth();
+    int height = imageCanvas->imageHeight();
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+
+    int annotated = 0;
+    for (const QString &path : nearDuplicates->cluster(currentImagePath)) {
+        int index = queueIndexOf(path);
+        if (path == currentImagePath || index < 0 || session.isProcessed(index)) {
+            continue;
+        }
+
+        // Burst frames may be stored at a different resolution
+        QSize size = ImageLoader::imageSize(path);
+        if (!size.isValid()) {
+            continue;
+        }
+        double scaleX = static_cast<double>(size.width()) / width;
+        double scaleY = static_cast<double>(size.height()) / height;
+        QList<BoundingBox> scaled;
+        for (BoundingBox box : boxes) {
+            QRect rect = box.rect();
+            box.setRect(QRect(qRound(rect.x() * scaleX), qRound(rect.y() * scaleY),
+                              qRound(rect.width() * scaleX), qRound(rect.height() * scaleY)));
+            box.setSelected(false);
+            scaled.append(box);
+        }
+
+        if (annotationManager.saveAnnotations(path, scaled, size.width(), size.height())) {
+            annotationManager.copyImageToOutput(path);
+            annotationIndex->setBoxes(index, scaled, size.width(), size.height());
+            session.setStatus(index, SessionStore::Processed);
+            if (folderIndex) {
+                folderIndex->setProcessed(path, FolderIndex::Annotated, true);
+            }
+            annotated++;
+        }
+    }
+    return annotated;
+}
+
 void ObjectDetectionWindow::saveAndNext()
 {
     saveCurrentAnnotations();
@@ -391,8 +993,9 @@ void ObjectDetectionWindow::saveAndNext()
 
 void ObjectDetectionWindow::nextImage()
 {
-    if (currentImageIndex < imageFiles.size() - 1) {
-        currentImageIndex++;
+    int next = nextQueueIndex();
+    if (next >= 0) {
+        currentImageIndex = next;
         updateImageDisplay();
         updateProgress();
         updateNavigationButtons();
@@ -401,8 +1004,9 @@ void ObjectDetectionWindow::nextImage()
 
 void ObjectDetectionWindow::previousImage()
 {
-    if (currentImageIndex > 0) {
-        currentImageIndex--;
+    int previous = previousQueueIndex();
+    if (previous >= 0) {
+        currentImageIndex = previous;
         updateImageDisplay();
         updateProgress();
         updateNavigationButtons();
@@ -423,27 +1027,36 @@ void ObjectDetectionWindow::updateImageDisplay()
     }
 
     currentImagePath = imageFiles[currentImageIndex];
-    QPixmap pixmap(currentImagePath);
+    session.setCurrentIndex(currentImageIndex);
+    QImage image = prefetcher->load(currentImagePath);
 
-    if (pixmap.isNull()) {
+    if (image.isNull()) {
         imageCanvas->clearImage();
         imageInfoLabel->setText("");
         QMessageBox::warning(this, "Error", "Failed to load image: " + currentImagePath);
         return;
     }
 
-    imageCanvas->setImage(pixmap);
+    imageCanvas->setImage(image, currentImagePath);
 
     // Load existing annotations if any
     loadAnnotationsForCurrentImage();
 
     // Update image info
     QFileInfo fileInfo(currentImagePath);
-    QString info = QString("File: %1 | Size: %2x%3 | %4 KB")
+    if (folderIndex) {
+        // Cached metadata is saved with the next index write
+        folderIndex->setImageInfo(currentImagePath, fileInfo.size(),
+                                  fileInfo.lastModified().toMSecsSinceEpoch(), image.size());
+    }
+    
+    QString info = QString("File: %1 | Size: %2x%3 | %4 KB | %5 | %6")
         .arg(fileInfo.fileName())
-        .arg(pixmap.width())
-        .arg(pixmap.height())
-        .arg(fileInfo.size() / 1024);
+        .arg(image.width())
+        .arg(image.height())
+        .arg(fileInfo.size() / 1024)
+        .arg(prefetcher->statisticsText())
+        .arg(ImageCache::instance().statisticsText());
     imageInfoLabel->setText(info);
 
     skipButton->setEnabled(true);
@@ -451,19 +1064,44 @@ void ObjectDetectionWindow::updateImageDisplay()
     saveAndNextButton->setEnabled(true);
 
     updateBoxList();
+
+    // Start decoding the neighbours while the user annotates this one
+    prefetcher->prefetchAround(imageFiles, currentImageIndex);
 }
 
 void ObjectDetectionWindow::loadAnnotationsForCurrentImage()
 {
     QList<BoundingBox> boxes;
-    annotationManager.loadAnnotations(currentImagePath, boxes,
-        imageCanvas->imageWidth(), imageCanvas->imageHeight());
+    int width = imageCanvas->imageWidth();
+    int height = imageCanvas->imageHeight();
+    if (currentImageIndex >= 0 && currentImageIndex < annotationIndex->count() &&
+        annotationIndex->isLoaded(currentImageIndex)) {
+        // Already in memory; only images still loading are read from disk
+        const AnnotationIndex::Box *box = annotationIndex->boxes(currentImageIndex);
+        for (int i = annotationIndex->boxCount(currentImageIndex); i > 0; --i, ++box) {
+            boxes.append(BoundingBox::fromYoloFormat(box->xCenter, box->yCenter, box->width, box->height,
+                                                     width, height, annotationManager.getLabel(box->classId),
+                                                     box->classId));
+        }
+    } else {
+        annotationManager.loadAnnotations(currentImagePath, boxes, width, height);
+    }
 
     imageCanvas->setBoundingBoxes(boxes);
 }
 
 void ObjectDetectionWindow::updateProgress()
 {
+    if (folderScanner->isRunning()) {
+        progressLabel->setText(QString("Scanning folder... %1 images found | Image %2 | Annotated: %3")
+            .arg(imageFiles.size())
+            .arg(currentImageIndex + 1)
+            .arg(session.processedCount()));
+        progressBar->setRange(0, 0);
+        return;
+    }
+    progressBar->setRange(0, 100);
+    
     if (imageFiles.isEmpty()) {
         progressLabel->setText("No images loaded");
         progressBar->setValue(0);
@@ -471,7 +1109,7 @@ void ObjectDetectionWindow::updateProgress()
     }
 
     int total = imageFiles.size();
-    int processed = processedImages.size();
+    int processed = session.processedCount();
     int current = currentImageIndex + 1;
 
     progressLabel->setText(QString("Image %1 of %2 | Annotated: %3")
@@ -485,8 +1123,96 @@ void ObjectDetectionWindow::updateProgress()
 
 void ObjectDetectionWindow::updateNavigationButtons()
 {
-    previousButton->setEnabled(currentImageIndex > 0);
-    nextButton->setEnabled(currentImageIndex < imageFiles.size() - 1);
+    previousButton->setEnabled(previousQueueIndex() >= 0);
+    nextButton->setEnabled(nextQueueIndex() >= 0);
+}
+
+int ObjectDetectionWindow::queueIndexOf(const QString &path)
+{
+    // The queue only grows between removals, so new entries are added on use
+    for (int i = queueIndexes.size(); i < imageFiles.size(); ++i) {
+        queueIndexes.insert(imageFiles[i], i);
+    }
+    return queueIndexes.value(path, -1);
+}
+
+int ObjectDetectionWindow::nextQueueIndex() const
+{
+    // Near-duplicates of an earlier image are passed over when collapsed
+    bool skipNearDuplicates = skipNearDuplicatesCheckBox->isChecked();
+    for (int i = currentImageIndex + 1; i < imageFiles.size(); ++i) {
+        if ((!skipNearDuplicates || !nearDuplicates->isNearDuplicate(imageFiles[i])) && matchesClassFilter(i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int ObjectDetectionWindow::previousQueueIndex() const
+{
+    for (int i = currentImageIndex - 1; i >= 0; --i) {
+        if (matchesClassFilter(i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool ObjectDetectionWindow::matchesClassFilter(int index) const
+{
+    // Images still loading into the index never match a class
+    int classId = classFilterComboBox->currentData().toInt();
+    return classId < 0 || (index < annotationIndex->count() && annotationIndex->containsClass(index, classId));
+}
+
+void ObjectDetectionWindow::onNearDuplicateOptionsChanged()
+{
+    QSettings settings;
+    settings.setValue("nearDuplicates/skip", skipNearDuplicatesCheckBox->isChecked());
+    settings.setValue("nearDuplicates/propagate", applyToNearDuplicatesCheckBox->isChecked());
+    updateNavigationButtons();
+}
+
+void ObjectDetectionWindow::onClassFilterChanged()
+{
+    updateNavigationButtons();
+}
+
+void ObjectDetectionWindow::updateDatasetStatistics()
+{
+    datasetStatsLabel->setVisible(annotationIndex->count() > 0);
+    QString text = QString("%1 annotated, %2 boxes").arg(annotationIndex->annotatedImages())
+        .arg(annotationIndex->totalBoxes());
+    if (annotationIndex->isLoading()) {
+        text += " (loading...)";
+    }
+    datasetStatsLabel->setText(text);
+    
+    // Filter entries carry their statistics; the selection survives the rebuild
+    int selectedClassId = classFilterComboBox->currentData().toInt();
+    QStringList perClass;
+    classFilterComboBox->blockSignals(true);
+    classFilterComboBox->clear();
+    classFilterComboBox->addItem("All images", -1);
+    for (const QString &label : annotationManager.labels()) {
+        int classId = annotationManager.getClassId(label);
+        int images = annotationIndex->imagesWithClass(classId);
+        classFilterComboBox->addItem(QString("%1 (%2)").arg(label).arg(images), classId);
+        perClass.append(QString("%1: %2 boxes in %3 images").arg(label)
+            .arg(annotationIndex->boxesOfClass(classId)).arg(images));
+    }
+    classFilterComboBox->setCurrentIndex(qMax(0, classFilterComboBox->findData(selectedClassId)));
+    classFilterComboBox->blockSignals(false);
+    datasetStatsLabel->setToolTip(perClass.join("\n"));
+    
+    updateNavigationButtons();
+}
+
+void ObjectDetectionWindow::updateNearDuplicateStatus()
+{
+    nearDuplicateLabel->setVisible(nearDuplicates->count() > 0);
+    nearDuplicateLabel->setText(nearDuplicates->statusText());
+    updateNavigationButtons();
 }
 
 void ObjectDetectionWindow::updateBoxList()
@@ -507,10 +1233,38 @@ void ObjectDetectionWindow::updateBoxList()
     }
 }
 
+void ObjectDetectionWindow::saveFolderIndex()
+{
+    indexSaveTimer->stop();
+    if (folderIndex && folderIndex->isDirty()) {
+        folderIndex->save();
+    }
+    // Renames of label files saved since the last timeout are fsync'ed together
+    annotationManager.sync();
+    
+    // Duplicates found by the background placements since the last save
+    int linked = annotationManager.contentStore().linkedCount();
+    if (linked > reportedLinkedCount) {
+        reportedLinkedCount = linked;
+        statusBar()->showMessage(annotationManager.contentStore().statusText(), 5000);
+    }
+}
+
 void ObjectDetectionWindow::clearCurrentSession()
 {
+    folderWatcher->stop();
+    saveFolderIndex();
+    folderIndex.clear();
+    folderScanner->cancel();
+    cancelScanButton->setVisible(false);
+    progressBar->setRange(0, 100);
+    prefetcher->clear();
     imageFiles.clear();
-    processedImages.clear();
+    queueIndexes.clear();
+    session.reset(0);
+    annotationIndex->clear();
+    nearDuplicates->clear();
+    updateNearDuplicateStatus();
     currentImageIndex = -1;
     currentImagePath.clear();
     imageCanvas->clearImage();
@@ -3,6 +3,15 @@
 
 #include "ImageCanvas.h"
 #include "AnnotationManager.h"
+#include "ImagePrefetcher.h"
+#include "FolderScanner.h"
+#include "FolderWatcher.h"
+#include "SessionStore.h"
+#include "NearDuplicateIndex.h"
+#include "AnnotationExporter.h"
+#include "CocoExporter.h"
+#include "VocImporter.h"
+#include "AnnotationIndex.h"
 #include <QMainWindow>
 #include <QLabel>
 #include <QPushButton>
@@ -10,10 +19,14 @@
 #include <QComboBox>
 #include <QListWidget>
 #include <QProgressBar>
+#include <QCheckBox>
 #include <QStringList>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGroupBox>
+#include <QTimer>
+#include <QHash>
+#include <QSet>
 
 /**
  * @brief Main window for object detection annotation mode
@@ -57,6 +70,33 @@ private slots:
     void previousImage();
     void skipImage();
     
+    // Folder scanning
+    void onScanBatch(const QStringList &paths);
+    void onScanFinished(int total);
+    void cancelScan();
+    void onFolderChanged(const QStringList &added, const QStringList &removed);
+    void onFilesRenamed(const QStringList &renamedFrom, const QStringList &renamedTo);
+    
+    // Near-duplicate handling
+    void onNearDuplicateOptionsChanged();
+    void onClassFilterChanged();
+    void updateDatasetStatistics();
+    void updateNearDuplicateStatus();
+    void onPlacementChanged(int index);
+    void onStorageBackendChanged(int index);
+    void exportYoloLabels();
+    void onExportProgress(int done, int total);
+    void onExportFinished(int written, int failed);
+    void exportCocoJson();
+    void onCocoExportProgress(int images);
+    void onCocoExportFinished(bool success, int images, int annotations, int failed);
+    
+    // Pascal VOC import
+    void importVoc();
+    void onVocDocumentsParsed();
+    void onVocAnnotationsSaved(const QStringList &saved, const QStringList &failed);
+    void onVocImportFinished(int documents, int failed);
+    
     // Save operations
     void saveCurrentAnnotations();
     void saveAndNext();
@@ -71,10 +111,16 @@ private:
     // Helper methods
     void setupUI();
     void loadImagesFromFolder(const QString &folderPath);
-    bool isImageFile(const QString &filePath);
     void clearCurrentSession();
     void loadAnnotationsForCurrentImage();
     bool promptForLabel(QString &label);
+    void saveFolderIndex();
+    int queueIndexOf(const QString &path);
+    int nextQueueIndex() const;
+    int previousQueueIndex() const;
+    bool matchesClassFilter(int index) const;
+    int annotateNearDuplicates(const QList<BoundingBox> &boxes);
+    void finishVocImportIfDone();
     
     // UI Components
     QWidget *centralWidget;
@@ -85,6 +131,7 @@ private:
     QLabel *imageInfoLabel;
     QLabel *progressLabel;
     QProgressBar *progressBar;
+    QPushButton *cancelScanButton;
     
     // Label management controls
     QGroupBox *labelGroup;
@@ -101,25 +148,53 @@ private:
     // Action buttons
     QPushButton *openImageButton;
     QPushButton *openFolderButton;
+    QCheckBox *includeSubfoldersCheckBox;
+    QPushButton *importVocButton;
     QPushButton *saveButton;
     QPushButton *saveAndNextButton;
+    QComboBox *placementComboBox;
+    QComboBox *storageComboBox;
+    QPushButton *exportLabelsButton;
+    QPushButton *exportCocoButton;
+    QProgressBar *exportProgressBar;
     QPushButton *nextButton;
     QPushButton *previousButton;
     QPushButton *skipButton;
+    QCheckBox *skipNearDuplicatesCheckBox;
+    QCheckBox *applyToNearDuplicatesCheckBox;
+    QLabel *nearDuplicateLabel;
+    QComboBox *classFilterComboBox;   // "All images" or a class id to navigate by
+    QLabel *datasetStatsLabel;
     
     // Data members
     QStringList imageFiles;           // List of all image file paths
-    QStringList processedImages;      // List of processed image paths
+    SessionStore session;             // Status of each entry of imageFiles, persisted per folder
+    QHash<QString, int> queueIndexes; // Path -> index in imageFiles; grows with it, cleared on removals
     int currentImageIndex;            // Current image index
     QString currentImagePath;         // Current image file path
     QString sourceFolder;             // Source folder for batch processing
+    ImagePrefetcher *prefetcher;      // Background decoder for neighbouring images
+    FolderScanner *folderScanner;     // Background enumerator for openFolder()
+    QSharedPointer<FolderIndex> folderIndex;  // Persistent index of sourceFolder, set once scanned
+    FolderWatcher *folderWatcher;     // Merges files added/removed while the folder is open
+    NearDuplicateIndex *nearDuplicates;  // Perceptual clusters of imageFiles, built in the background
+    QTimer *indexSaveTimer;           // Batches index writes and label fsyncs after saving annotations
+    int reportedLinkedCount;          // Hardlinked duplicates already shown in the status bar
+    AnnotationExporter *annotationExporter;  // Writes the packed store out as labels/<image>.txt files
+    CocoExporter *cocoExporter;       // Streams the output folder into one COCO JSON file
+    VocImporter *vocImporter;         // Parses Pascal VOC XML files in the background
+    AnnotationIndex *annotationIndex; // Boxes of every entry of imageFiles, loaded in the background
+    QSet<QString> vocImages;          // Images annotated by documents of the running import
+    QHash<QString, AnnotationManager::PendingAnnotation> vocPendingSaves;  // Image path -> boxes being saved
+    int vocSaveBatches;               // Batches handed to the annotation manager and not saved yet
+    int vocDocuments;                 // Documents of the running import; -1 while still parsing
+    int vocImported;                  // Images annotated by the running import
+    int vocDuplicates;                // Documents naming an image an earlier one already annotated
+    int vocFailed;                    // Documents of the running import that could not be used
     
     // Annotation management
     AnnotationManager annotationManager;
     QRect pendingBoundingBox;         // Temporary storage for box awaiting label
-    
-    // Constants
-    static const QStringList IMAGE_EXTENSIONS;
 };
 
 #endif // OBJECTDETECTIONWINDOW_H
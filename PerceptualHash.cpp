@@ -0,0 +1,121 @@
+#include "PerceptualHash.h"
+#include "ImageLoader.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int DctSize = 32;
+const int DctKept = 8;
+
+// Row u holds the DCT-II basis function u sampled at the 32 input positions.
+// Only the 8 lowest frequencies are ever needed.
+struct DctTable {
+    float c[DctKept][DctSize];
+
+    DctTable()
+    {
+        const double pi = 3.14159265358979323846;
+        for (int u = 0; u < DctKept; ++u) {
+            for (int x = 0; x < DctSize; ++x) {
+                c[u][x] = static_cast<float>(std::cos((2 * x + 1) * u * pi / (2 * DctSize)));
+            }
+        }
+    }
+};
+
+const DctTable &dctTable()
+{
+    static const DctTable table;
+    return table;
+}
+
+// Smooth downscale to an exact grayscale size, ignoring aspect ratio
+QImage grayscaleThumbnail(const QImage &image, int width, int height)
+{
+    return image.convertToFormat(QImage::Format_Grayscale8)
+                .scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+} // namespace
+
+quint64 PerceptualHash::dHash(const QImage &image)
+{
+    QImage gray = grayscaleThumbnail(image, 9, 8);
+    quint64 hash = 0;
+    int bit = 0;
+    for (int y = 0; y < 8; ++y) {
+        const uchar *row = gray.constScanLine(y);
+        for (int x = 0; x < 8; ++x, ++bit) {
+            if (row[x] > row[x + 1]) {
+                hash |= Q_UINT64_C(1) << bit;
+            }
+        }
+    }
+    return hash;
+}
+
+quint64 PerceptualHash::pHash(const QImage &image)
+{
+    QImage gray = grayscaleThumbnail(image, DctSize, DctSize);
+    const DctTable &table = dctTable();
+
+    // Separable DCT: rows first, keeping 8 frequencies, then columns. The
+    // inner loops run over contiguous floats so the compiler vectorizes them.
+    float rows[DctSize][DctKept];
+    float pixels[DctSize];
+    for (int y = 0; y < DctSize; ++y) {
+        const uchar *line = gray.constScanLine(y);
+        for (int x = 0; x < DctSize; ++x) {
+            pixels[x] = line[x];
+        }
+        for (int u = 0; u < DctKept; ++u) {
+            float sum = 0.0f;
+            for (int x = 0; x < DctSize; ++x) {
+                sum += pixels[x] * table.c[u][x];
+            }
+            rows[y][u] = sum;
+        }
+    }
+
+    float coefficients[DctKept * DctKept];
+    for (int v = 0; v < DctKept; ++v) {
+        float sums[DctKept] = {};
+        for (int y = 0; y < DctSize; ++y) {
+            float weight = table.c[v][y];
+            for (int u = 0; u < DctKept; ++u) {
+                sums[u] += rows[y][u] * weight;
+            }
+        }
+        for (int u = 0; u < DctKept; ++u) {
+            coefficients[v * DctKept + u] = sums[u];
+        }
+    }
+
+    // The DC term only says how bright the image is; leave it out
+    float ac[DctKept * DctKept - 1];
+    std::copy(coefficients + 1, coefficients + DctKept * DctKept, ac);
+    const int middle = (DctKept * DctKept - 1) / 2;
+    std::nth_element(ac, ac + middle, ac + DctKept * DctKept - 1);
+    float median = ac[middle];
+
+    quint64 hash = 0;
+    for (int i = 1; i < DctKept * DctKept; ++i) {
+        if (coefficients[i] > median) {
+            hash |= Q_UINT64_C(1) << i;
+        }
+    }
+    return hash;
+}
+
+bool PerceptualHash::compute(const QString &path, quint64 *dHashOut, quint64 *pHashOut)
+{
+    // JPEG decodes straight to a fraction of its size here
+    QImage image = ImageLoader::read(path, QSize(4 * DctSize, 4 * DctSize));
+    if (image.isNull()) {
+        return false;
+    }
+    *dHashOut = dHash(image);
+    *pHashOut = pHash(image);
+    return true;
+}
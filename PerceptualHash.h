@@ -0,0 +1,31 @@
+#ifndef PERCEPTUALHASH_H
+#define PERCEPTUALHASH_H
+
+#include <QImage>
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * @brief 64-bit perceptual hashes for spotting near-identical images
+ *
+ * Unlike ContentHash these survive re-encoding, small exposure changes and
+ * sensor noise, so consecutive burst frames end up a few bits apart:
+ * - dHash: sign of the horizontal gradient on a 9x8 grayscale thumbnail
+ * - pHash: low 8x8 DCT coefficients of a 32x32 grayscale thumbnail,
+ *   thresholded at their median
+ *
+ * Similarity is the Hamming distance between two hashes (0..64).
+ */
+class PerceptualHash
+{
+public:
+    static quint64 dHash(const QImage &image);
+    static quint64 pHash(const QImage &image);
+
+    // Decode path at thumbnail size and compute both hashes
+    static bool compute(const QString &path, quint64 *dHash, quint64 *pHash);
+
+    static int distance(quint64 a, quint64 b) { return qPopulationCount(a ^ b); }
+};
+
+#endif // PERCEPTUALHASH_H
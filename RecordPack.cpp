@@ -0,0 +1,367 @@
+#include "RecordPack.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QMap>
+#include <QRandomGenerator>
+#include <QSaveFile>
+#include <cstring>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#elif defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+namespace {
+
+const qint64 PackHeaderSize = 16;
+// Layout of the index file, independent of the record format
+const quint32 IndexVersion = 2;
+// Offset of the quint16 key length in every record header
+const int KeyLengthOffset = 4;
+
+} // namespace
+
+RecordPack::RecordPack(const QString &filePath, const Format &format)
+    : m_filePath(filePath),
+      m_format(format),
+      m_map(nullptr),
+      m_mapSize(0),
+      m_identity(0),
+      m_size(0),
+      m_garbage(0),
+      m_indexedSize(0),
+      m_unsynced(false)
+{
+}
+
+RecordPack::~RecordPack()
+{
+    close();
+}
+
+QString RecordPack::indexFilePath() const
+{
+    return m_filePath + ".idx";
+}
+
+bool RecordPack::writeHeader(QIODevice &device)
+{
+    // Never zero, which marks packs written before identities existed
+    m_identity = QRandomGenerator::global()->generate64() | 1;
+    quint32 header[4] = {m_format.packMagic, m_format.version,
+                         static_cast<quint32>(m_identity), static_cast<quint32>(m_identity >> 32)};
+    return device.write(reinterpret_cast<const char *>(header), sizeof(header)) == sizeof(header);
+}
+
+bool RecordPack::open(bool replaceUnreadable)
+{
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+    m_file.setFileName(m_filePath);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+
+    quint32 header[4] = {0, 0, 0, 0};
+    if (m_file.size() < PackHeaderSize ||
+        m_file.read(reinterpret_cast<char *>(header), sizeof(header)) != sizeof(header) ||
+        header[0] != m_format.packMagic || header[1] != m_format.version) {
+        if (m_file.size() > 0 && !replaceUnreadable) {
+            // Never overwrite something we do not understand
+            m_file.close();
+            return false;
+        }
+        // New or unusable pack: start over, without the index of the old one
+        QFile::remove(indexFilePath());
+        m_file.resize(0);
+        m_file.seek(0);
+        writeHeader(m_file);
+        m_file.flush();
+        m_size = PackHeaderSize;
+        m_garbage = 0;
+        m_indexedSize = 0;
+        m_entries.clear();
+        return true;
+    }
+
+    m_identity = header[2] | (static_cast<quint64>(header[3]) << 32);
+    if (m_identity == 0) {
+        // Older pack: give it an identity; its index is rebuilt by a scan
+        m_file.seek(0);
+        writeHeader(m_file);
+        m_file.flush();
+    }
+
+    if (!loadIndex()) {
+        m_entries.clear();
+        m_garbage = 0;
+        m_indexedSize = PackHeaderSize;
+    }
+    m_size = m_indexedSize;
+
+    // Records appended after the index was last saved
+    scanRecords(m_indexedSize);
+    return true;
+}
+
+void RecordPack::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+    if (m_unsynced) {
+        m_file.flush();
+        m_unsynced = false;
+    }
+    if (m_size != m_indexedSize) {
+        saveIndex();
+    }
+    unmap();
+    m_file.close();
+}
+
+void RecordPack::unmap() const
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+        m_mapSize = 0;
+    }
+}
+
+bool RecordPack::ensureMapped(qint64 end) const
+{
+    if (m_map && end <= m_mapSize) {
+        return true;
+    }
+    unmap();
+    qint64 size = m_file.size();
+    if (end > size) {
+        return false;
+    }
+    m_map = m_file.map(0, size);
+    m_mapSize = m_map ? size : 0;
+    return m_map != nullptr;
+}
+
+void RecordPack::scanRecords(qint64 from)
+{
+    qint64 fileSize = m_file.size();
+    qint64 offset = from;
+    if (fileSize > offset && ensureMapped(fileSize)) {
+        while (offset + m_format.recordHeaderSize <= fileSize) {
+            const uchar *header = m_map + offset;
+            quint32 magic;
+            std::memcpy(&magic, header, sizeof(magic));
+            if (magic != m_format.recordMagic) {
+                break;
+            }
+            qint64 length = m_format.recordLength(header);
+            if (offset + length > fileSize) {
+                break;
+            }
+
+            quint16 keyLength;
+            std::memcpy(&keyLength, header + KeyLengthOffset, sizeof(keyLength));
+            QString key = QString::fromUtf8(reinterpret_cast<const char *>(header + m_format.recordHeaderSize),
+                                            keyLength);
+            Entry entry;
+            entry.recordOffset = offset;
+            entry.recordLength = static_cast<quint32>(length);
+            addEntry(key, entry);
+            offset += length;
+        }
+    }
+
+    // A record cut short by a crash is dropped
+    if (offset < fileSize) {
+        unmap();
+        m_file.resize(offset);
+    }
+    m_size = offset;
+}
+
+void RecordPack::addEntry(const QString &key, const Entry &entry)
+{
+    QHash<QString, Entry>::iterator it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        m_garbage += it->recordLength;
+        *it = entry;
+    } else {
+        m_entries.insert(key, entry);
+    }
+}
+
+bool RecordPack::append(const QString &key, const QByteArray &record)
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+    if (!m_file.seek(m_size) || m_file.write(record) != record.size() || !m_file.flush()) {
+        return false;
+    }
+
+    Entry entry;
+    entry.recordOffset = m_size;
+    entry.recordLength = static_cast<quint32>(record.size());
+    addEntry(key, entry);
+    m_size += record.size();
+    m_unsynced = true;
+    return true;
+}
+
+const uchar *RecordPack::record(const QString &key, quint32 *length) const
+{
+    QHash<QString, Entry>::const_iterator it = m_entries.constFind(key);
+    if (it == m_entries.constEnd() || it->recordLength < static_cast<quint32>(m_format.recordHeaderSize) ||
+        !ensureMapped(it->recordOffset + it->recordLength)) {
+        return nullptr;
+    }
+
+    // The entry must point at a whole record of this key
+    const uchar *header = m_map + it->recordOffset;
+    quint32 magic;
+    quint16 keyLength;
+    std::memcpy(&magic, header, sizeof(magic));
+    std::memcpy(&keyLength, header + KeyLengthOffset, sizeof(keyLength));
+    if (magic != m_format.recordMagic || m_format.recordLength(header) != it->recordLength) {
+        return nullptr;
+    }
+    QByteArray keyBytes = key.toUtf8();
+    if (keyLength != keyBytes.size() ||
+        std::memcmp(header + m_format.recordHeaderSize, keyBytes.constData(), keyLength) != 0) {
+        return nullptr;
+    }
+
+    *length = it->recordLength;
+    return header;
+}
+
+bool RecordPack::sync()
+{
+    if (!m_unsynced || !m_file.isOpen()) {
+        return true;
+    }
+    m_unsynced = false;
+#if defined(Q_OS_WIN)
+    return _commit(m_file.handle()) == 0;
+#elif defined(Q_OS_UNIX)
+    return ::fsync(m_file.handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+bool RecordPack::compact()
+{
+    if (!m_file.isOpen() || !ensureMapped(m_size)) {
+        return false;
+    }
+
+    QSaveFile output(m_filePath);
+    if (!output.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    // A new identity, so the index of the old pack is not trusted if the
+    // new one cannot be saved
+    quint64 identity = m_identity;
+    if (!writeHeader(output)) {
+        m_identity = identity;
+        output.cancelWriting();
+        return false;
+    }
+
+    // Live records in pack order, so the new pack reads sequentially too
+    QMap<qint64, QString> order;
+    for (QHash<QString, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        order.insert(it->recordOffset, it.key());
+    }
+
+    QHash<QString, Entry> compacted;
+    qint64 offset = PackHeaderSize;
+    for (QMap<qint64, QString>::const_iterator it = order.constBegin(); it != order.constEnd(); ++it) {
+        Entry entry = m_entries.value(it.value());
+        output.write(reinterpret_cast<const char *>(m_map) + entry.recordOffset, entry.recordLength);
+        entry.recordOffset = offset;
+        offset += entry.recordLength;
+        compacted.insert(it.value(), entry);
+    }
+
+    // The old mapping must go before the file is replaced
+    unmap();
+    m_file.close();
+    bool committed = output.commit();
+    if (!committed) {
+        m_identity = identity;
+    }
+
+    m_file.setFileName(m_filePath);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        m_entries.clear();
+        return false;
+    }
+    if (committed) {
+        m_entries = compacted;
+        m_size = offset;
+        m_garbage = 0;
+        m_unsynced = false;
+        saveIndex();
+    }
+    return committed;
+}
+
+bool RecordPack::loadIndex()
+{
+    QFile file(indexFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0, indexVersion = 0, version = 0, count = 0;
+    quint64 identity = 0;
+    qint64 indexedSize = 0;
+    in >> magic >> indexVersion >> version >> identity >> indexedSize >> m_garbage >> count;
+    if (magic != m_format.indexMagic || indexVersion != IndexVersion || version != m_format.version ||
+        identity != m_identity || indexedSize < PackHeaderSize || indexedSize > m_file.size()) {
+        return false;
+    }
+
+    m_entries.clear();
+    m_entries.reserve(static_cast<int>(count));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString key;
+        Entry entry;
+        in >> key >> entry.recordOffset >> entry.recordLength;
+        m_entries.insert(key, entry);
+    }
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    m_indexedSize = indexedSize;
+    return true;
+}
+
+bool RecordPack::saveIndex()
+{
+    QSaveFile file(indexFilePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << m_format.indexMagic << IndexVersion << m_format.version << m_identity << m_size << m_garbage
+        << static_cast<quint32>(m_entries.size());
+    for (QHash<QString, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        out << it.key() << it->recordOffset << it->recordLength;
+    }
+    if (!file.commit()) {
+        return false;
+    }
+    m_indexedSize = m_size;
+    return true;
+}
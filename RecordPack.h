@@ -0,0 +1,104 @@
+#ifndef RECORDPACK_H
+#define RECORDPACK_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+
+/**
+ * @brief Append-only file of keyed records with a saved offset index
+ *
+ * The storage shared by ThumbnailStore and AnnotationStore. Records are
+ * appended to a single pack file that is memory-mapped for reading, and an
+ * in-memory index maps each key to its latest record. The index is saved
+ * next to the pack on close(); records appended after it (e.g. before a
+ * crash) are recovered by scanning, and a record cut short is dropped.
+ * Superseded records stay in the pack as garbage until compact().
+ *
+ * The pack header carries a random identity that is renewed whenever the
+ * pack is started over or rewritten. The index records it, so an index
+ * left behind by an earlier pack at the same path is never trusted, and
+ * every record handed out is checked against its key first.
+ *
+ * Every record starts with the record magic (quint32) and the length of
+ * its UTF-8 key (quint16); the key follows the record header. The rest of
+ * the layout belongs to the store, which tells the pack how long a record
+ * is through Format::recordLength.
+ *
+ * Not thread-safe; the stores serialize access with their own mutex.
+ */
+class RecordPack
+{
+public:
+    struct Format {
+        quint32 packMagic;
+        quint32 recordMagic;
+        quint32 indexMagic;
+        quint32 version;
+        int recordHeaderSize;
+        // Total length of a record, given its complete header
+        qint64 (*recordLength)(const uchar *header);
+    };
+
+    RecordPack(const QString &filePath, const Format &format);
+    ~RecordPack();
+
+    // A file that is not a pack of this format is replaced if
+    // replaceUnreadable is set; otherwise open() fails and leaves it alone
+    bool open(bool replaceUnreadable);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+    QString filePath() const { return m_filePath; }
+
+    // Append a complete record (header, key, payload) and make it the
+    // latest one of key
+    bool append(const QString &key, const QByteArray &record);
+
+    // Latest record of key, or null if it is missing or does not hold key.
+    // Valid until the next call that appends, remaps or closes.
+    const uchar *record(const QString &key, quint32 *length) const;
+
+    bool contains(const QString &key) const { return m_entries.contains(key); }
+    QStringList keys() const { return m_entries.keys(); }
+    int count() const { return m_entries.size(); }
+
+    // Force appended records to disk
+    bool sync();
+
+    // Rewrite the pack without superseded records
+    bool compact();
+
+    qint64 size() const { return m_size; }
+    qint64 garbageBytes() const { return m_garbage; }
+
+private:
+    struct Entry {
+        qint64 recordOffset;
+        quint32 recordLength;
+    };
+
+    QString indexFilePath() const;
+    bool writeHeader(QIODevice &device);
+    bool loadIndex();
+    bool saveIndex();
+    void scanRecords(qint64 from);
+    bool ensureMapped(qint64 end) const;
+    void unmap() const;
+    void addEntry(const QString &key, const Entry &entry);
+
+    QString m_filePath;
+    Format m_format;
+    mutable QFile m_file;
+    mutable uchar *m_map;
+    mutable qint64 m_mapSize;
+    quint64 m_identity;                // Random, stored in the header and the index
+    qint64 m_size;                     // Bytes of valid records (plus header)
+    qint64 m_garbage;                  // Bytes of superseded records
+    qint64 m_indexedSize;              // Pack size covered by the saved index
+    bool m_unsynced;
+    QHash<QString, Entry> m_entries;
+};
+
+#endif // RECORDPACK_H
@@ -0,0 +1,306 @@
+#include "SessionStore.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <cstring>
+
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+namespace {
+
+const quint32 SessionMagic = 0x53455353;   // "SESS"
+const quint32 SessionVersion = 1;
+const int MinCapacity = 4096;
+
+} // namespace
+
+SessionStore::SessionStore()
+    : m_map(nullptr),
+      m_capacity(0),
+      m_memoryCurrentIndex(-1),
+      m_count(0),
+      m_processedCount(0)
+{
+}
+
+SessionStore::~SessionStore()
+{
+    close();
+}
+
+QString SessionStore::sessionFilePath(const QString &folderPath, bool recursive, const QString &mode)
+{
+    QString key = QDir(folderPath).absolutePath() + (recursive ? "|recursive" : "|flat") + "|" + mode;
+    QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           "/sessions/" + QString::fromLatin1(hash) + ".session";
+}
+
+quint64 SessionStore::fingerprint(const QStringList &paths)
+{
+    // FNV-1a over the UTF-16 code units; qHash() is seeded per process
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    const quint64 prime = Q_UINT64_C(1099511628211);
+    for (const QString &path : paths) {
+        const ushort *units = path.utf16();
+        for (int i = 0; i < path.size(); ++i) {
+            hash = (hash ^ units[i]) * prime;
+        }
+        hash = (hash ^ '\n') * prime;
+    }
+    return hash;
+}
+
+uchar *SessionStore::statusData()
+{
+    return m_map ? m_map + sizeof(Header) : reinterpret_cast<uchar *>(m_memory.data());
+}
+
+const uchar *SessionStore::statusData() const
+{
+    return m_map ? m_map + sizeof(Header) : reinterpret_cast<const uchar *>(m_memory.constData());
+}
+
+void SessionStore::reset(int count)
+{
+    close();
+
+    m_memory = QByteArray(qMax(0, count), Unprocessed);
+    m_memoryCurrentIndex = -1;
+    m_count = qMax(0, count);
+    m_processedCount = 0;
+}
+
+bool SessionStore::mapFile(int capacity)
+{
+    // Growing the file zero-fills the new statuses
+    qint64 size = static_cast<qint64>(sizeof(Header)) + capacity;
+    if (m_file.size() < size && !m_file.resize(size)) {
+        return false;
+    }
+    size = m_file.size();
+
+    // The old mapping is only dropped once the new one exists, so a failure
+    // leaves the statuses readable for close()
+    uchar *map = m_file.map(0, size);
+    if (!map) {
+        return false;
+    }
+    if (m_map) {
+        m_file.unmap(m_map);
+    }
+    m_map = map;
+    m_capacity = static_cast<int>(size - static_cast<qint64>(sizeof(Header)));
+    return true;
+}
+
+bool SessionStore::open(const QString &folderPath, bool recursive, const QString &mode, quint64 fingerprint)
+{
+    close();
+
+    QString path = sessionFilePath(folderPath, recursive, mode);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+
+    Header stored;
+    bool restored = false;
+    if (m_file.size() >= static_cast<qint64>(sizeof(Header)) &&
+        m_file.read(reinterpret_cast<char *>(&stored), sizeof(Header)) == sizeof(Header)) {
+        restored = stored.magic == SessionMagic && stored.version == SessionVersion &&
+                   stored.count == m_count && stored.fingerprint == fingerprint &&
+                   m_file.size() >= static_cast<qint64>(sizeof(Header)) + stored.count;
+    }
+
+    // A different queue starts from the statuses held in memory
+    if (!restored) {
+        m_file.resize(0);
+    }
+
+    QByteArray pending = m_memory;
+    if (!mapFile(qMax(m_count, MinCapacity))) {
+        m_file.close();
+        return false;
+    }
+
+    uchar *data = statusData();
+    if (restored) {
+        // Keep what was marked while the queue was still being scanned
+        for (int i = 0; i < m_count; ++i) {
+            if (pending[i] == Processed) {
+                data[i] = Processed;
+            }
+        }
+    } else {
+        Header *h = header();
+        h->magic = SessionMagic;
+        h->version = SessionVersion;
+        h->count = m_count;
+        h->currentIndex = m_memoryCurrentIndex;
+        h->fingerprint = fingerprint;
+        h->reserved = 0;
+        if (m_count > 0) {
+            std::memcpy(data, pending.constData(), m_count);
+        }
+    }
+
+    m_memory.clear();
+    recountProcessed();
+    return restored;
+}
+
+void SessionStore::close()
+{
+    if (!m_map) {
+        return;
+    }
+
+    // Statuses stay usable in memory after the file is released
+    m_memory = QByteArray(reinterpret_cast<const char *>(statusData()), m_count);
+    m_memoryCurrentIndex = header()->currentIndex;
+
+    // Page cache writeback already covers application crashes; this also
+    // covers power loss
+#if defined(Q_OS_UNIX)
+    ::msync(m_map, sizeof(Header) + m_capacity, MS_SYNC);
+#elif defined(Q_OS_WIN)
+    FlushViewOfFile(m_map, 0);
+#endif
+
+    m_file.unmap(m_map);
+    m_map = nullptr;
+    m_capacity = 0;
+    m_file.close();
+}
+
+void SessionStore::recountProcessed()
+{
+    const uchar *data = statusData();
+    m_processedCount = 0;
+    for (int i = 0; i < m_count; ++i) {
+        if (data[i] == Processed) {
+            m_processedCount++;
+        }
+    }
+}
+
+SessionStore::Status SessionStore::status(int index) const
+{
+    if (index < 0 || index >= m_count) {
+        return Unprocessed;
+    }
+    return statusData()[index] == Processed ? Processed : Unprocessed;
+}
+
+void SessionStore::setStatus(int index, Status status)
+{
+    if (index < 0 || index >= m_count) {
+        return;
+    }
+
+    uchar &value = statusData()[index];
+    if (value == status) {
+        return;
+    }
+
+    if (status == Processed) {
+        m_processedCount++;
+    } else if (value == Processed) {
+        m_processedCount--;
+    }
+    value = static_cast<uchar>(status);
+}
+
+int SessionStore::currentIndex() const
+{
+    return m_map ? header()->currentIndex : m_memoryCurrentIndex;
+}
+
+void SessionStore::setCurrentIndex(int index)
+{
+    if (m_map) {
+        header()->currentIndex = index;
+    } else {
+        m_memoryCurrentIndex = index;
+    }
+}
+
+void SessionStore::resize(int count)
+{
+    count = qMax(0, count);
+    if (count == m_count) {
+        return;
+    }
+
+    if (count < m_count) {
+        // Dropped statuses are cleared so a later resize starts unprocessed
+        uchar *data = statusData();
+        for (int i = count; i < m_count; ++i) {
+            if (data[i] == Processed) {
+                m_processedCount--;
+            }
+        }
+        std::memset(data + count, Unprocessed, m_count - count);
+    } else if (m_map && count > m_capacity) {
+        // Grow geometrically so streaming appends do not remap every time
+        if (!mapFile(qMax(count, m_capacity * 2))) {
+            close();
+        }
+    }
+
+    if (!m_map) {
+        int oldSize = m_memory.size();
+        m_memory.resize(count);
+        if (count > oldSize) {
+            std::memset(m_memory.data() + oldSize, Unprocessed, count - oldSize);
+        }
+    }
+
+    m_count = count;
+    if (m_map) {
+        header()->count = count;
+    }
+}
+
+void SessionStore::removeIndexes(const QVector<int> &indexes)
+{
+    if (indexes.isEmpty()) {
+        return;
+    }
+
+    uchar *data = statusData();
+    int next = 0;
+    int kept = 0;
+    for (int i = 0; i < m_count; ++i) {
+        if (next < indexes.size() && indexes[next] == i) {
+            if (data[i] == Processed) {
+                m_processedCount--;
+            }
+            next++;
+            continue;
+        }
+        data[kept++] = data[i];
+    }
+    std::memset(data + kept, Unprocessed, m_count - kept);
+
+    m_count = kept;
+    if (m_map) {
+        header()->count = kept;
+    } else {
+        m_memory.resize(kept);
+    }
+}
+
+void SessionStore::setFingerprint(quint64 fingerprint)
+{
+    if (m_map) {
+        header()->fingerprint = fingerprint;
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+
+/**
+ * @brief Per-image processing status of the current queue, keyed by queue index
+ *
+ * One status byte per queued image plus a small header (queue length,
+ * current position and a fingerprint of the queue order). While a folder is
+ * open the statuses live in a memory-mapped file in the user's cache
+ * directory, so every status change is on disk as soon as it is made and
+ * survives a crash of the application. Reopening the same queue restores
+ * the statuses and the last position.
+ *
+ * Lookups and updates are O(1); the processed count is maintained
+ * incrementally so progress display does not scan the queue.
+ */
+class SessionStore
+{
+public:
+    enum Status {
+        Unprocessed = 0,
+        Processed = 1
+    };
+
+    SessionStore();
+    ~SessionStore();
+
+    // Keep count statuses in memory only, dropping the session file
+    void reset(int count);
+
+    // Move the statuses into the session file of folderPath. mode names the
+    // window ("classification", "detection"), so each resumes only its own
+    // progress. If that file describes the same queue (same length and
+    // fingerprint) its statuses and position are restored, merged with the
+    // ones already set; returns true in that case.
+    bool open(const QString &folderPath, bool recursive, const QString &mode, quint64 fingerprint);
+
+    // Flush and unmap the session file; statuses stay available in memory
+    void close();
+    bool isPersistent() const { return m_map != nullptr; }
+
+    int count() const { return m_count; }
+    int processedCount() const { return m_processedCount; }
+
+    Status status(int index) const;
+    bool isProcessed(int index) const { return status(index) == Processed; }
+    void setStatus(int index, Status status);
+
+    // Queue position to resume from
+    int currentIndex() const;
+    void setCurrentIndex(int index);
+
+    // Follow changes of the queue: appended entries start unprocessed;
+    // removed indexes must be sorted ascending
+    void resize(int count);
+    void removeIndexes(const QVector<int> &indexes);
+    void setFingerprint(quint64 fingerprint);
+
+    // Order-dependent fingerprint of a queue, stable across runs
+    static quint64 fingerprint(const QStringList &paths);
+
+    static QString sessionFilePath(const QString &folderPath, bool recursive, const QString &mode);
+
+private:
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        qint32 count;
+        qint32 currentIndex;
+        quint64 fingerprint;
+        quint64 reserved;
+    };
+
+    uchar *statusData();
+    const uchar *statusData() const;
+    Header *header() { return reinterpret_cast<Header *>(m_map); }
+    const Header *header() const { return reinterpret_cast<const Header *>(m_map); }
+    bool mapFile(int capacity);
+    void recountProcessed();
+
+    QFile m_file;
+    uchar *m_map;              // Header followed by the status bytes, null when in memory
+    int m_capacity;            // Status bytes the mapping can hold
+    QByteArray m_memory;       // Statuses while not persistent
+    int m_memoryCurrentIndex;
+    int m_count;
+    int m_processedCount;
+};
+
+#endif // SESSIONSTORE_H
@@ -0,0 +1,185 @@
+#include "ThumbnailLoader.h"
+#include "ImageLoader.h"
+#include <QBuffer>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QRunnable>
+#include <QThread>
+
+namespace {
+
+const int DefaultThumbnailSize = 128;
+const int CacheBudgetKB = 96 * 1024;
+const int StoreJpegQuality = 85;
+
+class ThumbnailTask : public QRunnable
+{
+public:
+    ThumbnailTask(QObject *target, const QString &path, int size, quint64 generation,
+                  const QSharedPointer<ThumbnailStore> &store)
+        : m_target(target), m_path(path), m_size(size), m_generation(generation), m_store(store)
+    {
+    }
+
+    void run() override
+    {
+        QImage image;
+        qint64 modified = 0;
+        if (m_store) {
+            modified = QFileInfo(m_path).lastModified().toMSecsSinceEpoch();
+            QByteArray data = m_store->find(m_path, modified, m_size);
+            if (!data.isEmpty()) {
+                image.loadFromData(data, "JPG");
+            }
+        }
+
+        if (image.isNull()) {
+            image = ImageLoader::read(m_path, QSize(m_size, m_size));
+            // Decoders may return a slightly larger image than asked for
+            if (!image.isNull() && (image.width() > m_size || image.height() > m_size)) {
+                image = image.scaled(m_size, m_size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            }
+            if (m_store && !image.isNull()) {
+                QByteArray data;
+                QBuffer buffer(&data);
+                buffer.open(QIODevice::WriteOnly);
+                // JPEG has no alpha channel
+                QImage opaque = image.hasAlphaChannel()
+                    ? image.convertToFormat(QImage::Format_RGB32) : image;
+                if (opaque.save(&buffer, "JPG", StoreJpegQuality)) {
+                    m_store->insert(m_path, modified, m_size, data);
+                }
+            }
+        }
+
+        QMetaObject::invokeMethod(m_target, "onThumbnailDecoded", Qt::QueuedConnection,
+                                  Q_ARG(QString, m_path),
+                                  Q_ARG(QImage, image),
+                                  Q_ARG(quint64, m_generation));
+    }
+
+private:
+    QObject *m_target;
+    QString m_path;
+    int m_size;
+    quint64 m_generation;
+    QSharedPointer<ThumbnailStore> m_store;
+};
+
+class CompactTask : public QRunnable
+{
+public:
+    CompactTask(QObject *target, const QSharedPointer<ThumbnailStore> &store)
+        : m_target(target), m_store(store)
+    {
+    }
+
+    void run() override
+    {
+        qint64 before = m_store->packSize();
+        m_store->compact();
+        QMetaObject::invokeMethod(m_target, "onStoreCompacted", Qt::QueuedConnection,
+                                  Q_ARG(qint64, before),
+                                  Q_ARG(qint64, m_store->packSize()));
+    }
+
+private:
+    QObject *m_target;
+    QSharedPointer<ThumbnailStore> m_store;
+};
+
+} // namespace
+
+ThumbnailLoader::ThumbnailLoader(QObject *parent)
+    : QObject(parent),
+      m_cache(CacheBudgetKB),
+      m_size(DefaultThumbnailSize),
+      m_generation(0)
+{
+    // Decoding is CPU bound; keep one core free for the GUI
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    m_compactPool.setMaxThreadCount(1);
+}
+
+ThumbnailLoader::~ThumbnailLoader()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+    m_compactPool.waitForDone();
+}
+
+void ThumbnailLoader::setThumbnailSize(int size)
+{
+    if (size == m_size) {
+        return;
+    }
+    m_size = size;
+    clear();
+}
+
+QPixmap ThumbnailLoader::thumbnail(const QString &path) const
+{
+    QPixmap *pixmap = m_cache.object(path);
+    return pixmap ? *pixmap : QPixmap();
+}
+
+void ThumbnailLoader::request(const QString &path)
+{
+    if (m_pending.contains(path) || m_failed.contains(path) || m_cache.contains(path)) {
+        return;
+    }
+    m_pending.insert(path);
+    m_pool.start(new ThumbnailTask(this, path, m_size, m_generation, m_store));
+}
+
+void ThumbnailLoader::cancelPending()
+{
+    // Tasks already running still deliver their result
+    m_pool.clear();
+    m_pending.clear();
+}
+
+void ThumbnailLoader::clear()
+{
+    cancelPending();
+    m_generation++;
+    m_cache.clear();
+    m_failed.clear();
+}
+
+void ThumbnailLoader::setStore(const QSharedPointer<ThumbnailStore> &store)
+{
+    // Tasks already running keep their own reference to the old store
+    cancelPending();
+    m_store = store;
+}
+
+void ThumbnailLoader::compactStore()
+{
+    // Decodes are cancelled on every scroll; a compaction must not be
+    if (m_store) {
+        m_compactPool.start(new CompactTask(this, m_store));
+    }
+}
+
+void ThumbnailLoader::onThumbnailDecoded(const QString &path, const QImage &image, quint64 generation)
+{
+    if (generation != m_generation) {
+        return;
+    }
+    m_pending.remove(path);
+
+    if (image.isNull()) {
+        m_failed.insert(path);
+    } else {
+        QPixmap *pixmap = new QPixmap(QPixmap::fromImage(image));
+        int costKB = qMax(1, pixmap->width() * pixmap->height() * pixmap->depth() / 8 / 1024);
+        m_cache.insert(path, pixmap, costKB);
+    }
+    emit thumbnailReady(path);
+}
+
+void ThumbnailLoader::onStoreCompacted(qint64 bytesBefore, qint64 bytesAfter)
+{
+    emit storeCompacted(bytesBefore, bytesAfter);
+}
@@ -0,0 +1,80 @@
+#ifndef THUMBNAILLOADER_H
+#define THUMBNAILLOADER_H
+
+#include "ThumbnailStore.h"
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QCache>
+#include <QPixmap>
+#include <QImage>
+#include <QSet>
+#include <QString>
+
+/**
+ * @brief Decodes thumbnails on a background pool and keeps them in memory
+ *
+ * Thumbnails are decoded at a fixed size through ImageLoader (JPEG scales
+ * in the DCT domain, so a 20 MP photo never becomes a full bitmap) and kept
+ * as pixmaps in an LRU cache bounded by bytes. request() only queues work;
+ * thumbnailReady() tells the caller when thumbnail() has it.
+ *
+ * cancelPending() drops requests that have not started yet, so fast
+ * scrolling only decodes what is still near the viewport.
+ *
+ * With a ThumbnailStore set, thumbnails are first looked up in the pack
+ * (keyed by path and modification time) and only decoded from the image
+ * on a miss, after which the encoded thumbnail is appended to the pack.
+ */
+class ThumbnailLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailLoader(QObject *parent = nullptr);
+    ~ThumbnailLoader();
+
+    // Edge length of the square thumbnails are fitted into
+    void setThumbnailSize(int size);
+    int thumbnailSize() const { return m_size; }
+
+    // Cached thumbnail, or a null pixmap if it is not decoded (yet)
+    QPixmap thumbnail(const QString &path) const;
+    bool isFailed(const QString &path) const { return m_failed.contains(path); }
+
+    // Decode path unless it is cached, failed before or already queued
+    void request(const QString &path);
+    void cancelPending();
+
+    // Drop all thumbnails and pending work
+    void clear();
+
+    // Persistent pack to read thumbnails from and append new ones to; may
+    // be null
+    void setStore(const QSharedPointer<ThumbnailStore> &store);
+    QSharedPointer<ThumbnailStore> store() const { return m_store; }
+
+    // Rewrite the store without superseded records on the pool;
+    // storeCompacted() reports the pack size before and after
+    void compactStore();
+
+signals:
+    void thumbnailReady(const QString &path);
+    void storeCompacted(qint64 bytesBefore, qint64 bytesAfter);
+
+private slots:
+    void onThumbnailDecoded(const QString &path, const QImage &image, quint64 generation);
+    void onStoreCompacted(qint64 bytesBefore, qint64 bytesAfter);
+
+private:
+    QThreadPool m_pool;
+    QThreadPool m_compactPool;          // One thread; not cleared by cancelPending()
+    QSharedPointer<ThumbnailStore> m_store;
+    QCache<QString, QPixmap> m_cache;   // Cost in KB
+    QSet<QString> m_pending;            // Queued or decoding
+    QSet<QString> m_failed;             // Not decodable; never retried
+    int m_size;
+    quint64 m_generation;               // Bumped by clear() and size changes
+};
+
+#endif // THUMBNAILLOADER_H
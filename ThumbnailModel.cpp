@@ -0,0 +1,161 @@
+#include "ThumbnailModel.h"
+#include <QFileInfo>
+#include <QPainter>
+#include <QVector>
+#include <algorithm>
+
+ThumbnailModel::ThumbnailModel(QObject *parent)
+    : QAbstractListModel(parent),
+      m_loader(new ThumbnailLoader(this))
+{
+    connect(m_loader, &ThumbnailLoader::thumbnailReady, this, &ThumbnailModel::onThumbnailReady);
+}
+
+void ThumbnailModel::appendPaths(const QStringList &paths)
+{
+    if (paths.isEmpty()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), m_paths.size(), m_paths.size() + paths.size() - 1);
+    m_paths.append(paths);
+    m_rows.clear();
+    endInsertRows();
+}
+
+void ThumbnailModel::removePaths(const QStringList &paths)
+{
+    QVector<int> rows;
+    for (const QString &path : paths) {
+        int index = row(path);
+        if (index >= 0) {
+            rows.append(index);
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+
+    // Remove contiguous runs from the end so earlier rows keep their numbers
+    int end = rows.size() - 1;
+    while (end >= 0) {
+        int start = end;
+        while (start > 0 && rows[start - 1] == rows[start] - 1) {
+            start--;
+        }
+        beginRemoveRows(QModelIndex(), rows[start], rows[end]);
+        m_paths.erase(m_paths.begin() + rows[start], m_paths.begin() + rows[end] + 1);
+        endRemoveRows();
+        end = start - 1;
+    }
+    m_rows.clear();
+}
+
+void ThumbnailModel::clear()
+{
+    beginResetModel();
+    m_paths.clear();
+    m_rows.clear();
+    m_loader->clear();
+    endResetModel();
+}
+
+QString ThumbnailModel::path(int row) const
+{
+    return row >= 0 && row < m_paths.size() ? m_paths[row] : QString();
+}
+
+void ThumbnailModel::renamePath(const QString &from, const QString &to)
+{
+    int index = row(from);
+    if (index < 0) {
+        return;
+    }
+    m_paths[index] = to;
+    m_rows.remove(from);
+    m_rows.insert(to, index);
+    QModelIndex modelIndex = this->index(index);
+    emit dataChanged(modelIndex, modelIndex);
+}
+
+int ThumbnailModel::row(const QString &path) const
+{
+    if (m_rows.isEmpty() && !m_paths.isEmpty()) {
+        m_rows.reserve(m_paths.size());
+        for (int i = 0; i < m_paths.size(); ++i) {
+            m_rows.insert(m_paths[i], i);
+        }
+    }
+    return m_rows.value(path, -1);
+}
+
+void ThumbnailModel::prefetch(int first, int last, int margin)
+{
+    if (m_paths.isEmpty()) {
+        return;
+    }
+    first = qBound(0, first, m_paths.size() - 1);
+    last = qBound(first, last, m_paths.size() - 1);
+
+    m_loader->cancelPending();
+    for (int row = first; row <= last; ++row) {
+        m_loader->request(m_paths[row]);
+    }
+    for (int distance = 1; distance <= margin; ++distance) {
+        if (last + distance < m_paths.size()) {
+            m_loader->request(m_paths[last + distance]);
+        }
+        if (first - distance >= 0) {
+            m_loader->request(m_paths[first - distance]);
+        }
+    }
+}
+
+int ThumbnailModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_paths.size();
+}
+
+QVariant ThumbnailModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_paths.size()) {
+        return QVariant();
+    }
+
+    const QString &path = m_paths[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+        return QFileInfo(path).fileName();
+    case Qt::ToolTipRole:
+        return path;
+    case Qt::DecorationRole: {
+        QPixmap pixmap = m_loader->thumbnail(path);
+        if (pixmap.isNull()) {
+            m_loader->request(path);
+            return placeholder();
+        }
+        return pixmap;
+    }
+    default:
+        return QVariant();
+    }
+}
+
+QPixmap ThumbnailModel::placeholder() const
+{
+    int size = m_loader->thumbnailSize();
+    if (m_placeholder.width() != size) {
+        m_placeholder = QPixmap(size, size);
+        m_placeholder.fill(QColor(0xf0, 0xf0, 0xf0));
+        QPainter painter(&m_placeholder);
+        painter.setPen(QColor(0x99, 0x99, 0x99));
+        painter.drawRect(0, 0, size - 1, size - 1);
+    }
+    return m_placeholder;
+}
+
+void ThumbnailModel::onThumbnailReady(const QString &path)
+{
+    int index = row(path);
+    if (index >= 0) {
+        QModelIndex changed = createIndex(index, 0);
+        emit dataChanged(changed, changed, QVector<int>() << Qt::DecorationRole);
+    }
+}
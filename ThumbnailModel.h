@@ -0,0 +1,55 @@
+#ifndef THUMBNAILMODEL_H
+#define THUMBNAILMODEL_H
+
+#include "ThumbnailLoader.h"
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QHash>
+#include <QPixmap>
+
+/**
+ * @brief List model of the image queue for the thumbnail grid
+ *
+ * One row per queued image, in queue order. Views only ask for the
+ * decoration of rows they paint, so thumbnails are requested from the
+ * ThumbnailLoader lazily; until one arrives a shared placeholder is shown.
+ * prefetch() additionally queues the rows around the visible range.
+ */
+class ThumbnailModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailModel(QObject *parent = nullptr);
+
+    // Keep the rows in step with the queue
+    void appendPaths(const QStringList &paths);
+    void removePaths(const QStringList &paths);
+    void renamePath(const QString &from, const QString &to);
+    void clear();
+
+    QString path(int row) const;
+    int row(const QString &path) const;
+
+    // Decode rows first..last, then up to margin rows on either side,
+    // nearest first. Earlier requests that have not started are dropped.
+    void prefetch(int first, int last, int margin);
+
+    ThumbnailLoader *loader() const { return m_loader; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private slots:
+    void onThumbnailReady(const QString &path);
+
+private:
+    QPixmap placeholder() const;
+
+    QStringList m_paths;
+    mutable QHash<QString, int> m_rows;   // Built on first lookup after a change
+    ThumbnailLoader *m_loader;
+    mutable QPixmap m_placeholder;
+};
+
+#endif // THUMBNAILMODEL_H
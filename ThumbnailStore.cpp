@@ -0,0 +1,130 @@
+#include "ThumbnailStore.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <cstring>
+
+namespace {
+
+const quint32 PackMagic = 0x5450414b;    // "TPAK"
+const quint32 RecordMagic = 0x54524543;  // "TREC"
+const quint32 IndexMagic = 0x54494458;   // "TIDX"
+const quint32 PackVersion = 1;
+
+// Written in host byte order; the pack never leaves this machine
+struct RecordHeader {
+    quint32 magic;
+    quint16 pathLength;
+    quint16 size;
+    qint64 modified;
+    quint32 dataLength;
+    quint32 reserved;
+};
+
+qint64 recordLength(const uchar *data)
+{
+    RecordHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    return static_cast<qint64>(sizeof(header)) + header.pathLength + header.dataLength;
+}
+
+const RecordPack::Format PackFormat = {
+    PackMagic, RecordMagic, IndexMagic, PackVersion, sizeof(RecordHeader), recordLength
+};
+
+} // namespace
+
+ThumbnailStore::ThumbnailStore(const QString &packFilePath)
+    : m_pack(packFilePath, PackFormat)
+{
+}
+
+ThumbnailStore::~ThumbnailStore()
+{
+    close();
+}
+
+QString ThumbnailStore::packFilePath(const QString &folderPath)
+{
+    QByteArray hash = QCryptographicHash::hash(QDir(folderPath).absolutePath().toUtf8(),
+                                               QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           "/thumbnails/" + QString::fromLatin1(hash) + ".pack";
+}
+
+bool ThumbnailStore::open()
+{
+    QMutexLocker locker(&m_mutex);
+    // Only a cache: an unusable pack is started over
+    return m_pack.open(true);
+}
+
+void ThumbnailStore::close()
+{
+    QMutexLocker locker(&m_mutex);
+    m_pack.close();
+}
+
+QByteArray ThumbnailStore::find(const QString &path, qint64 modified, int size) const
+{
+    QMutexLocker locker(&m_mutex);
+    quint32 length = 0;
+    const uchar *record = m_pack.record(path, &length);
+    if (!record) {
+        return QByteArray();
+    }
+
+    RecordHeader header;
+    std::memcpy(&header, record, sizeof(header));
+    if (header.modified != modified || header.size != size) {
+        return QByteArray();
+    }
+    // Copied, so the caller can decode outside the lock while the mapping
+    // may be replaced
+    const char *data = reinterpret_cast<const char *>(record) + length - header.dataLength;
+    return QByteArray(data, static_cast<int>(header.dataLength));
+}
+
+bool ThumbnailStore::insert(const QString &path, qint64 modified, int size, const QByteArray &data)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QByteArray pathBytes = path.toUtf8();
+    RecordHeader header;
+    header.magic = RecordMagic;
+    header.pathLength = static_cast<quint16>(pathBytes.size());
+    header.size = static_cast<quint16>(size);
+    header.modified = modified;
+    header.dataLength = static_cast<quint32>(data.size());
+    header.reserved = 0;
+
+    QByteArray record(reinterpret_cast<const char *>(&header), sizeof(header));
+    record += pathBytes;
+    record += data;
+    return m_pack.append(path, record);
+}
+
+bool ThumbnailStore::compact()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pack.compact();
+}
+
+int ThumbnailStore::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pack.count();
+}
+
+qint64 ThumbnailStore::packSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pack.size();
+}
+
+qint64 ThumbnailStore::garbageBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pack.garbageBytes();
+}
@@ -0,0 +1,56 @@
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include "RecordPack.h"
+#include <QString>
+#include <QByteArray>
+#include <QMutex>
+
+/**
+ * @brief Persistent pack of encoded thumbnails for one folder
+ *
+ * Thumbnails are appended as self-describing records (path, modification
+ * time, thumbnail size, JPEG bytes) to a single RecordPack in the user's
+ * cache directory, which is memory-mapped for reading. An offset index is
+ * saved next to it when the store is closed, so a warm start reads the
+ * index and then touches only the records that are actually shown. If the
+ * index is missing or older than the pack (e.g. after a crash), the
+ * records after its end are recovered by scanning.
+ *
+ * A record is valid while the image keeps the same modification time;
+ * regenerated thumbnails are appended and the old record becomes garbage
+ * until compact() rewrites the pack.
+ *
+ * All methods are thread-safe; thumbnail workers read and append
+ * concurrently.
+ */
+class ThumbnailStore
+{
+public:
+    explicit ThumbnailStore(const QString &packFilePath);
+    ~ThumbnailStore();
+
+    // Pack file used for the images of folderPath
+    static QString packFilePath(const QString &folderPath);
+
+    bool open();
+    void close();
+
+    // Encoded thumbnail of path, or an empty array if there is none for
+    // this modification time and size
+    QByteArray find(const QString &path, qint64 modified, int size) const;
+    bool insert(const QString &path, qint64 modified, int size, const QByteArray &data);
+
+    // Rewrite the pack without superseded records
+    bool compact();
+
+    int count() const;
+    qint64 packSize() const;
+    qint64 garbageBytes() const;
+
+private:
+    mutable QMutex m_mutex;
+    RecordPack m_pack;
+};
+
+#endif // THUMBNAILSTORE_H
@@ -0,0 +1,131 @@
+#include "ThumbnailView.h"
+#include <QItemSelectionModel>
+#include <QResizeEvent>
+#include <QScrollBar>
+#include <algorithm>
+
+namespace {
+
+const int PrefetchDelayMs = 30;
+const int PrefetchScreens = 2;   // Rows decoded ahead of and behind the viewport, in screens
+const int CaptionHeight = 20;
+const int CellPadding = 12;
+
+} // namespace
+
+ThumbnailView::ThumbnailView(QWidget *parent)
+    : QListView(parent),
+      m_model(nullptr),
+      m_prefetchTimer(new QTimer(this))
+{
+    // Wrapping list mode rather than IconMode: with uniform item sizes its
+    // layout is pure arithmetic, while IconMode stores a geometry per item
+    setViewMode(QListView::ListMode);
+    setFlow(QListView::LeftToRight);
+    setWrapping(true);
+    setMovement(QListView::Static);
+    setResizeMode(QListView::Adjust);
+    setLayoutMode(QListView::Batched);
+    setUniformItemSizes(true);
+    setSelectionMode(QAbstractItemView::ExtendedSelection);
+    setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    setTextElideMode(Qt::ElideMiddle);
+    setWordWrap(false);
+
+    m_prefetchTimer->setSingleShot(true);
+    m_prefetchTimer->setInterval(PrefetchDelayMs);
+    connect(m_prefetchTimer, &QTimer::timeout, this, &ThumbnailView::prefetchVisible);
+}
+
+void ThumbnailView::setThumbnailModel(ThumbnailModel *model)
+{
+    m_model = model;
+    setModel(model);
+
+    int size = model->loader()->thumbnailSize();
+    setIconSize(QSize(size, size));
+    setGridSize(QSize(size + CellPadding, size + CellPadding + CaptionHeight));
+
+    // The selection model is replaced by setModel()
+    connect(selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &ThumbnailView::onCurrentChanged);
+    connect(model, &QAbstractItemModel::rowsInserted, m_prefetchTimer, QOverload<>::of(&QTimer::start));
+    connect(model, &QAbstractItemModel::modelReset, m_prefetchTimer, QOverload<>::of(&QTimer::start));
+}
+
+void ThumbnailView::setCurrentRow(int row)
+{
+    if (!m_model || row < 0 || row >= m_model->rowCount()) {
+        return;
+    }
+
+    QModelIndex index = m_model->index(row);
+    QItemSelectionModel::SelectionFlags flags = selectionModel()->isSelected(index)
+        ? QItemSelectionModel::NoUpdate
+        : QItemSelectionModel::ClearAndSelect;
+    selectionModel()->setCurrentIndex(index, flags);
+    scrollTo(index);
+}
+
+QList<int> ThumbnailView::selectedRows() const
+{
+    QList<int> rows;
+    if (!selectionModel()) {
+        return rows;
+    }
+    const QModelIndexList indexes = selectionModel()->selectedIndexes();
+    for (const QModelIndex &index : indexes) {
+        rows.append(index.row());
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+QStyleOptionViewItem ThumbnailView::viewOptions() const
+{
+    // Caption under the thumbnail, as in IconMode
+    QStyleOptionViewItem options = QListView::viewOptions();
+    options.decorationPosition = QStyleOptionViewItem::Top;
+    options.decorationAlignment = Qt::AlignCenter;
+    options.displayAlignment = Qt::AlignHCenter | Qt::AlignBottom;
+    return options;
+}
+
+void ThumbnailView::scrollContentsBy(int dx, int dy)
+{
+    QListView::scrollContentsBy(dx, dy);
+    m_prefetchTimer->start();
+}
+
+void ThumbnailView::resizeEvent(QResizeEvent *event)
+{
+    QListView::resizeEvent(event);
+    m_prefetchTimer->start();
+}
+
+void ThumbnailView::prefetchVisible()
+{
+    if (!m_model || m_model->rowCount() == 0) {
+        return;
+    }
+
+    // Uniform cells make the visible range a matter of arithmetic
+    QSize cell = gridSize();
+    int columns = qMax(1, viewport()->width() / qMax(1, cell.width()));
+    int top = verticalScrollBar()->value();
+    int firstLine = top / qMax(1, cell.height());
+    int lastLine = (top + viewport()->height()) / qMax(1, cell.height());
+    int first = firstLine * columns;
+    int last = (lastLine + 1) * columns - 1;
+    int margin = PrefetchScreens * (last - first + 1);
+
+    m_model->prefetch(first, last, margin);
+}
+
+void ThumbnailView::onCurrentChanged(const QModelIndex &current, const QModelIndex &previous)
+{
+    Q_UNUSED(previous);
+    if (current.isValid()) {
+        emit currentRowChanged(current.row());
+    }
+}
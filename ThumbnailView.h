@@ -0,0 +1,52 @@
+#ifndef THUMBNAILVIEW_H
+#define THUMBNAILVIEW_H
+
+#include "ThumbnailModel.h"
+#include <QListView>
+#include <QList>
+#include <QTimer>
+
+/**
+ * @brief Virtualized grid of the image queue
+ *
+ * A wrapping QListView with uniform item sizes, so layout and painting
+ * only touch the rows in view no matter how long the queue is. After each
+ * scroll or resize settles, the visible rows plus a couple of screens on
+ * either side are queued for decoding. Supports extended (Shift/Ctrl)
+ * selection for bulk actions.
+ */
+class ThumbnailView : public QListView
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailView(QWidget *parent = nullptr);
+
+    void setThumbnailModel(ThumbnailModel *model);
+    ThumbnailModel *thumbnailModel() const { return m_model; }
+
+    // Make row current and visible. A row that is part of the selection
+    // keeps the selection; otherwise it becomes the only selected row.
+    void setCurrentRow(int row);
+
+    // Selected rows in ascending order
+    QList<int> selectedRows() const;
+
+signals:
+    void currentRowChanged(int row);
+
+protected:
+    QStyleOptionViewItem viewOptions() const override;
+    void scrollContentsBy(int dx, int dy) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private slots:
+    void prefetchVisible();
+    void onCurrentChanged(const QModelIndex &current, const QModelIndex &previous);
+
+private:
+    ThumbnailModel *m_model;
+    QTimer *m_prefetchTimer;   // Coalesces scroll steps
+};
+
+#endif // THUMBNAILVIEW_H
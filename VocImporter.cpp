@@ -0,0 +1,338 @@
+#include "VocImporter.h"
+#include "ImageLoader.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+#include <QXmlStreamReader>
+
+namespace {
+
+const int ChunkSize = 256;
+
+typedef QSharedPointer<const QHash<QString, QString> > ImageNames;   // File name -> queued path
+
+class ParseTask : public QRunnable
+{
+public:
+    ParseTask(QObject *target, const QStringList &paths, const ImageNames &queuedImages,
+              const QSharedPointer<VocImporter::Results> &results,
+              QAtomicInt *currentGeneration, int generation)
+        : m_target(target), m_paths(paths), m_queuedImages(queuedImages), m_results(results),
+          m_currentGeneration(currentGeneration), m_generation(generation)
+    {
+    }
+
+    void run() override
+    {
+        QVector<VocImporter::Document> documents;
+        documents.reserve(m_paths.size());
+        int failed = 0;
+        for (const QString &path : m_paths) {
+            if (m_currentGeneration->load() != m_generation) {
+                return;
+            }
+            VocImporter::Document document;
+            if (!VocImporter::parseFile(path, document) ||
+                !VocImporter::findImage(document, *m_queuedImages)) {
+                failed++;
+            }
+            documents.append(document);
+        }
+
+        {
+            QMutexLocker locker(&m_results->mutex);
+            m_results->documents += documents;
+        }
+        QMetaObject::invokeMethod(m_target, "onChunkParsed", Qt::QueuedConnection,
+                                  Q_ARG(int, documents.size()),
+                                  Q_ARG(int, failed),
+                                  Q_ARG(int, m_generation));
+    }
+
+private:
+    QObject *m_target;
+    QStringList m_paths;
+    ImageNames m_queuedImages;
+    QSharedPointer<VocImporter::Results> m_results;
+    QAtomicInt *m_currentGeneration;
+    int m_generation;
+};
+
+class ListTask : public QRunnable
+{
+public:
+    ListTask(QObject *target, QThreadPool *pool, const QString &directory, const QStringList &queuedImages,
+             const QSharedPointer<VocImporter::Results> &results,
+             QAtomicInt *currentGeneration, int generation)
+        : m_target(target), m_pool(pool), m_directory(directory), m_queuedImages(queuedImages),
+          m_results(results), m_currentGeneration(currentGeneration), m_generation(generation)
+    {
+    }
+
+    void run() override
+    {
+        // VOC files name their image without a path; match them to the queue
+        // by name, the first image winning
+        QHash<QString, QString> *names = new QHash<QString, QString>;
+        names->reserve(m_queuedImages.size());
+        for (int i = m_queuedImages.size() - 1; i >= 0; --i) {
+            names->insert(QFileInfo(m_queuedImages[i]).fileName(), m_queuedImages[i]);
+        }
+        ImageNames queuedImages(names);
+        m_queuedImages.clear();
+
+        int files = 0;
+        QStringList chunk;
+        QDirIterator it(m_directory, QStringList() << "*.xml", QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            if (m_currentGeneration->load() != m_generation) {
+                return;
+            }
+            chunk.append(it.next());
+            files++;
+            // Parsing starts while the rest of the folder is still listed
+            if (chunk.size() >= ChunkSize) {
+                m_pool->start(new ParseTask(m_target, chunk, queuedImages, m_results,
+                                            m_currentGeneration, m_generation));
+                chunk.clear();
+            }
+        }
+        if (!chunk.isEmpty()) {
+            m_pool->start(new ParseTask(m_target, chunk, queuedImages, m_results,
+                                        m_currentGeneration, m_generation));
+        }
+        QMetaObject::invokeMethod(m_target, "onListed", Qt::QueuedConnection,
+                                  Q_ARG(int, files),
+                                  Q_ARG(int, m_generation));
+    }
+
+private:
+    QObject *m_target;
+    QThreadPool *m_pool;
+    QString m_directory;
+    QStringList m_queuedImages;
+    QSharedPointer<VocImporter::Results> m_results;
+    QAtomicInt *m_currentGeneration;
+    int m_generation;
+};
+
+double elementNumber(QXmlStreamReader &xml, bool *ok)
+{
+    return xml.readElementText().trimmed().toDouble(ok);
+}
+
+} // namespace
+
+VocImporter::VocImporter(QObject *parent)
+    : QObject(parent),
+      m_generation(0),
+      m_results(new Results),
+      m_running(false),
+      m_listed(-1),
+      m_parsed(0),
+      m_failed(0)
+{
+    // One thread lists, the others parse
+    m_pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount() + 1));
+}
+
+VocImporter::~VocImporter()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void VocImporter::start(const QString &directory, const QStringList &queuedImages)
+{
+    cancel();
+    m_running = true;
+    m_listed = -1;
+    m_parsed = 0;
+    m_failed = 0;
+    m_pool.start(new ListTask(this, &m_pool, directory, queuedImages, m_results,
+                              &m_generation, m_generation.load()));
+}
+
+void VocImporter::cancel()
+{
+    // Workers still running finish their file and drop the results
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_results.reset(new Results);
+    m_running = false;
+}
+
+QVector<VocImporter::Document> VocImporter::takeParsed()
+{
+    QMutexLocker locker(&m_results->mutex);
+    QVector<Document> documents;
+    documents.swap(m_results->documents);
+    return documents;
+}
+
+bool VocImporter::parseFile(const QString &path, Document &document)
+{
+    document.xmlPath = path;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        document.error = file.errorString();
+        return false;
+    }
+    // Annotation files are small; one read beats buffered device access
+    return parse(file.readAll(), document);
+}
+
+bool VocImporter::findImage(Document &document, const QHash<QString, QString> &queuedImages)
+{
+    if (document.imageFileName.isEmpty()) {
+        document.error = "no <filename>";
+        return false;
+    }
+
+    document.imagePath = queuedImages.value(document.imageFileName);
+    if (document.imagePath.isEmpty()) {
+        // Standard layout: Annotations/ next to JPEGImages/; else beside the XML
+        QDir xmlDir = QFileInfo(document.xmlPath).dir();
+        QString candidate = QDir::cleanPath(xmlDir.filePath("../JPEGImages/" + document.imageFileName));
+        if (!QFileInfo::exists(candidate)) {
+            candidate = xmlDir.filePath(document.imageFileName);
+        }
+        if (!QFileInfo::exists(candidate)) {
+            document.error = "image not found: " + document.imageFileName;
+            return false;
+        }
+        document.imagePath = candidate;
+    }
+
+    if (!document.imageSize.isValid()) {
+        document.imageSize = ImageLoader::imageSize(document.imagePath);
+        if (!document.imageSize.isValid()) {
+            document.error = "unreadable image: " + document.imagePath;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool VocImporter::parse(const QByteArray &data, Document &document)
+{
+    QXmlStreamReader xml(data);
+    bool inSize = false;
+    bool inObject = false;
+    bool inBox = false;
+    int partDepth = 0;           // <part> elements (e.g. head, hand) are ignored
+    Object object;
+    int boxFields = 0;           // Bit per coordinate found
+    double xmin = 0, ymin = 0, xmax = 0, ymax = 0;
+    double width = 0, height = 0;
+
+    while (!xml.atEnd()) {
+        QXmlStreamReader::TokenType token = xml.readNext();
+        if (token == QXmlStreamReader::StartElement) {
+            QStringRef name = xml.name();
+            bool ok = false;
+            if (name == QLatin1String("part")) {
+                partDepth++;
+            } else if (partDepth > 0) {
+                continue;
+            } else if (name == QLatin1String("object")) {
+                inObject = true;
+                object = Object();
+                boxFields = 0;
+            } else if (inObject) {
+                if (name == QLatin1String("bndbox")) {
+                    inBox = true;
+                } else if (name == QLatin1String("name") && !inBox) {
+                    object.name = xml.readElementText().trimmed();
+                } else if (inBox && name == QLatin1String("xmin")) {
+                    xmin = elementNumber(xml, &ok);
+                    boxFields |= ok ? 1 : 0;
+                } else if (inBox && name == QLatin1String("ymin")) {
+                    ymin = elementNumber(xml, &ok);
+                    boxFields |= ok ? 2 : 0;
+                } else if (inBox && name == QLatin1String("xmax")) {
+                    xmax = elementNumber(xml, &ok);
+                    boxFields |= ok ? 4 : 0;
+                } else if (inBox && name == QLatin1String("ymax")) {
+                    ymax = elementNumber(xml, &ok);
+                    boxFields |= ok ? 8 : 0;
+                }
+            } else if (name == QLatin1String("filename")) {
+                document.imageFileName = xml.readElementText().trimmed();
+            } else if (name == QLatin1String("size")) {
+                inSize = true;
+            } else if (inSize && name == QLatin1String("width")) {
+                width = elementNumber(xml, &ok);
+            } else if (inSize && name == QLatin1String("height")) {
+                height = elementNumber(xml, &ok);
+            }
+        } else if (token == QXmlStreamReader::EndElement) {
+            QStringRef name = xml.name();
+            if (name == QLatin1String("part")) {
+                partDepth--;
+            } else if (partDepth > 0) {
+                continue;
+            } else if (name == QLatin1String("size")) {
+                inSize = false;
+            } else if (name == QLatin1String("bndbox")) {
+                inBox = false;
+            } else if (name == QLatin1String("object")) {
+                inObject = false;
+                // Inclusive 1-based corners to a 0-based rectangle
+                int left = qRound(xmin) - 1;
+                int top = qRound(ymin) - 1;
+                int right = qRound(xmax);
+                int bottom = qRound(ymax);
+                if (boxFields == 15 && !object.name.isEmpty() && right > left && bottom > top) {
+                    object.rect = QRect(left, top, right - left, bottom - top);
+                    document.objects.append(object);
+                } else {
+                    document.skippedObjects++;
+                }
+            }
+        }
+    }
+
+    if (xml.hasError()) {
+        document.error = QString("line %1: %2").arg(xml.lineNumber()).arg(xml.errorString());
+        return false;
+    }
+    if (width >= 1 && height >= 1) {
+        document.imageSize = QSize(qRound(width), qRound(height));
+    }
+    return true;
+}
+
+void VocImporter::onListed(int files, int generation)
+{
+    if (generation != m_generation.load()) {
+        return;
+    }
+    m_listed = files;
+    checkFinished();
+}
+
+void VocImporter::onChunkParsed(int documents, int failed, int generation)
+{
+    if (generation != m_generation.load()) {
+        return;
+    }
+    m_parsed += documents;
+    m_failed += failed;
+    emit documentsParsed();
+    checkFinished();
+}
+
+void VocImporter::checkFinished()
+{
+    if (m_running && m_listed >= 0 && m_parsed >= m_listed) {
+        m_running = false;
+        emit finished(m_parsed, m_failed);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef VOCIMPORTER_H
+#define VOCIMPORTER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QRect>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+/**
+ * @brief Parses Pascal VOC XML annotation files on a background pool
+ *
+ * The *.xml files below a folder are listed on one worker and parsed in
+ * chunks by the others with QXmlStreamReader, so no DOM is ever built. The
+ * workers also find each document's image and probe its size if the XML
+ * does not give one. Parsed documents are collected in batches;
+ * documentsParsed() tells the GUI thread to takeParsed() them, where only
+ * the class names are mapped to ids (the label table is not thread-safe).
+ */
+class VocImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Object {
+        QString name;
+        QRect rect;             // 0-based pixels (VOC coordinates are 1-based)
+    };
+
+    struct Document {
+        Document() : skippedObjects(0) {}
+
+        QString xmlPath;
+        QString imageFileName;  // <filename>
+        QString imagePath;      // Image found for imageFileName; empty if none
+        QSize imageSize;        // <size>, else probed from imagePath
+        QVector<Object> objects;
+        int skippedObjects;     // Objects without a name or a complete box
+        QString error;          // Set if the file could not be read or parsed,
+                                // or its image was not found
+    };
+
+    // Filled by the workers of one import; replaced when it is cancelled
+    struct Results {
+        QMutex mutex;
+        QVector<Document> documents;
+    };
+
+    explicit VocImporter(QObject *parent = nullptr);
+    ~VocImporter();
+
+    // Parse every *.xml below directory, cancelling any import in progress.
+    // Images are looked up by file name in queuedImages first, then in
+    // ../JPEGImages/ and next to the XML file.
+    void start(const QString &directory, const QStringList &queuedImages);
+
+    // Stop the running import; no further signals are emitted for it
+    void cancel();
+    bool isRunning() const { return m_running; }
+
+    // Documents parsed since the last call, in no particular order
+    QVector<Document> takeParsed();
+
+    static bool parse(const QByteArray &data, Document &document);
+    static bool parseFile(const QString &path, Document &document);
+    static bool findImage(Document &document, const QHash<QString, QString> &queuedImages);
+
+signals:
+    void documentsParsed();
+    // failed counts files that could not be read or parsed or whose image
+    // was not found
+    void finished(int documents, int failed);
+
+private slots:
+    void onListed(int files, int generation);
+    void onChunkParsed(int documents, int failed, int generation);
+
+private:
+    void checkFinished();
+
+    QThreadPool m_pool;
+    QAtomicInt m_generation;   // Bumped to cancel the running import
+    QSharedPointer<Results> m_results;
+    bool m_running;
+    int m_listed;              // Files found, -1 while still listing
+    int m_parsed;
+    int m_failed;
+};
+
+#endif // VOCIMPORTER_H
@@ -0,0 +1,280 @@
+#include "YoloLabelParser.h"
+#include <QByteArray>
+#include <QFile>
+#include <QtAlgorithms>
+#include <QtEndian>
+
+namespace {
+
+// Exactly representable powers of ten
+const double PowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const quint64 MaxExactMantissa = quint64(1) << 53;
+
+inline bool isDigit(char c)
+{
+    return static_cast<unsigned>(c - '0') < 10;
+}
+
+// Value of the 8 digits in chunk (ASCII '0' already subtracted, first
+// digit in the lowest byte), combined pairwise with three multiplications
+inline quint64 eightDigitsValue(quint64 chunk)
+{
+    chunk = (chunk * 10) + (chunk >> 8);
+    return (((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+            (((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+}
+
+const quint64 PowersOfTenInt[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull
+};
+
+// Accumulate the run of digits at p into mantissa, up to 8 at a time
+inline const char *accumulateDigits(const char *p, const char *end, quint64 &mantissa)
+{
+    while (end - p >= 8) {
+        quint64 chunk = qFromLittleEndian<quint64>(p) ^ 0x3030303030303030ull;
+        // High bit set in each byte that is not a digit; carries only run
+        // towards later bytes, so the first flagged byte is exact
+        quint64 nonDigits = ((chunk + 0x7676767676767676ull) | chunk) & 0x8080808080808080ull;
+        int count = nonDigits ? qCountTrailingZeroBits(nonDigits) / 8 : 8;
+        if (count == 0) {
+            return p;
+        }
+        // Unused bytes are shifted out at the bottom, i.e. become leading zeros
+        mantissa = mantissa * PowersOfTenInt[count] + eightDigitsValue(chunk << (8 * (8 - count)));
+        p += count;
+        if (count < 8) {
+            return p;
+        }
+    }
+    while (p < end && isDigit(*p)) {
+        mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+        ++p;
+    }
+    return p;
+}
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char *skipBlanks(const char *p, const char *end)
+{
+    while (p < end && isBlank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+const char *parseInt(const char *begin, const char *end, int &value)
+{
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+    const char *digits = p;
+    qint64 result = 0;
+    while (p < end && isDigit(*p)) {
+        result = result * 10 + (*p - '0');
+        if (result > 0x7fffffff) {
+            return nullptr;
+        }
+        ++p;
+    }
+    if (p == digits) {
+        return nullptr;
+    }
+    value = static_cast<int>(negative ? -result : result);
+    return p;
+}
+
+// The end of a field: the next blank, line end or end of data
+inline bool atFieldEnd(const char *p, const char *end)
+{
+    return p == end || isBlank(*p) || *p == '\n';
+}
+
+} // namespace
+
+const char *YoloLabelParser::parseDouble(const char *begin, const char *end, double &value)
+{
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    // All digits go into one integer; with more than 19 of them it may
+    // overflow, which sends the number to the slow path below
+    quint64 mantissa = 0;
+    const char *digits = p;
+    p = accumulateDigits(p, end, mantissa);
+    int digitCount = static_cast<int>(p - digits);
+    int exponent = 0;
+    if (p < end && *p == '.') {
+        ++p;
+        const char *fraction = p;
+        p = accumulateDigits(p, end, mantissa);
+        exponent = -static_cast<int>(p - fraction);
+        digitCount -= exponent;
+    }
+    if (digitCount == 0) {
+        return nullptr;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int explicitExponent = 0;
+        const char *parsed = parseInt(p + 1, end, explicitExponent);
+        if (!parsed) {
+            return nullptr;
+        }
+        exponent += explicitExponent;
+        p = parsed;
+    }
+
+    // Clinger's fast path: both operands are exact doubles, so one
+    // correctly rounded multiplication or division gives the exact result
+    if (digitCount <= 19 && mantissa <= MaxExactMantissa && exponent >= -22 && exponent <= 22) {
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / PowersOfTen[-exponent] : result * PowersOfTen[exponent];
+        value = negative ? -result : result;
+        return p;
+    }
+
+    // Long or extreme numbers: Qt's locale-independent strtod. fromRawData
+    // does not copy the bytes.
+    bool ok = false;
+    double result = QByteArray::fromRawData(begin, static_cast<int>(p - begin)).toDouble(&ok);
+    if (!ok) {
+        return nullptr;
+    }
+    value = result;
+    return p;
+}
+
+bool YoloLabelParser::parse(const char *data, qint64 size, QVector<Box> &boxes,
+                            Error *error, bool skipInvalidLines)
+{
+    if (error) {
+        error->line = 0;
+        error->column = 0;
+        error->message = nullptr;
+    }
+
+    const char *p = data;
+    const char *end = data + size;
+    bool valid = true;
+    int line = 0;
+
+    while (p < end) {
+        line++;
+        const char *lineStart = p;
+        const char *failedAt = nullptr;
+        const char *message = nullptr;
+
+        p = skipBlanks(p, end);
+        if (p < end && *p != '\n') {
+            Box box;
+            double *fields[4] = { &box.xCenter, &box.yCenter, &box.width, &box.height };
+
+            const char *next = parseInt(p, end, box.classId);
+            if (!next || !atFieldEnd(next, end)) {
+                failedAt = p;
+                message = "expected an integer class id";
+            } else {
+                p = next;
+                for (int i = 0; i < 4; ++i) {
+                    p = skipBlanks(p, end);
+                    if (p == end || *p == '\n') {
+                        failedAt = p;
+                        message = "expected 5 fields";
+                        break;
+                    }
+                    next = parseDouble(p, end, *fields[i]);
+                    if (!next || !atFieldEnd(next, end)) {
+                        failedAt = p;
+                        message = "expected a number";
+                        break;
+                    }
+                    p = next;
+                }
+                if (!failedAt) {
+                    p = skipBlanks(p, end);
+                    if (p < end && *p != '\n') {
+                        failedAt = p;
+                        message = "expected 5 fields";
+                    }
+                }
+            }
+
+            if (!failedAt) {
+                boxes.append(box);
+            }
+        }
+
+        if (failedAt) {
+            if (valid && error) {
+                error->line = line;
+                error->column = static_cast<int>(failedAt - lineStart) + 1;
+                error->message = message;
+            }
+            valid = false;
+            if (!skipInvalidLines) {
+                return false;
+            }
+        }
+
+        // On to the next line
+        while (p < end && *p != '\n') {
+            ++p;
+        }
+        if (p < end) {
+            ++p;
+        }
+    }
+    return valid;
+}
+
+bool YoloLabelParser::parseFile(const QString &filePath, QVector<Box> &boxes,
+                                Error *error, bool skipInvalidLines)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            error->line = 0;
+            error->column = 0;
+            error->message = "cannot open file";
+        }
+        return false;
+    }
+
+    qint64 size = file.size();
+    if (size == 0) {
+        if (error) {
+            error->line = 0;
+            error->column = 0;
+            error->message = nullptr;
+        }
+        return true;
+    }
+
+    // Label files are small; mapping saves the copy, reading is the fallback
+    // for files that cannot be mapped (e.g. on some network shares)
+    const uchar *mapped = file.map(0, size);
+    if (mapped) {
+        bool valid = parse(reinterpret_cast<const char *>(mapped), size, boxes, error, skipInvalidLines);
+        file.unmap(const_cast<uchar *>(mapped));
+        return valid;
+    }
+
+    QByteArray data = file.readAll();
+    return parse(data.constData(), data.size(), boxes, error, skipInvalidLines);
+}
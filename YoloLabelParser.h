@@ -0,0 +1,56 @@
+#ifndef YOLOLABELPARSER_H
+#define YOLOLABELPARSER_H
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Allocation-free parser for YOLO label files
+ *
+ * Parses "<class_id> <x_center> <y_center> <width> <height>" lines straight
+ * from a byte range (a memory-mapped file or a buffer read in one go)
+ * without creating any strings. Numbers take Clinger's fast path (exact
+ * for mantissas up to 2^53 and exponents up to 22, which covers the
+ * 6-decimal values this tool writes) and fall back to Qt's correctly
+ * rounded conversion otherwise, so results equal QString::toDouble().
+ *
+ * Fields are separated by spaces or tabs; blank lines and CRLF line ends
+ * are accepted. The first error is reported with its 1-based line and
+ * column. Boxes are appended to a caller-owned vector, which keeps its
+ * capacity when reused across files.
+ */
+class YoloLabelParser
+{
+public:
+    struct Box {
+        int classId;
+        double xCenter;
+        double yCenter;
+        double width;
+        double height;
+    };
+
+    struct Error {
+        int line;              // 1-based; 0 when there is no error
+        int column;            // 1-based byte column
+        const char *message;   // Static string
+    };
+
+    // Parse data[0, size) and append its boxes. With skipInvalidLines, a
+    // malformed line is left out and parsing continues; otherwise parsing
+    // stops at it. Returns false if any line was malformed; error (if
+    // given) then describes the first one.
+    static bool parse(const char *data, qint64 size, QVector<Box> &boxes,
+                      Error *error = nullptr, bool skipInvalidLines = false);
+
+    // Map (or, for files that cannot be mapped, read) filePath and parse it.
+    // A missing file is an error with line 0.
+    static bool parseFile(const QString &filePath, QVector<Box> &boxes,
+                          Error *error = nullptr, bool skipInvalidLines = false);
+
+    // Parse one number of [begin, end); returns the end of the number or
+    // nullptr if there is none. Exposed for the writer's round-trip checks.
+    static const char *parseDouble(const char *begin, const char *end, double &value);
+};
+
+#endif // YOLOLABELPARSER_H
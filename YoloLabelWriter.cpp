@@ -0,0 +1,116 @@
+#include "YoloLabelWriter.h"
+#include <cmath>
+
+namespace {
+
+const int InitialCapacity = 4096;
+
+// Keeps the rounding error of value * 1e6 far below TieMargin (YOLO
+// coordinates are normally within [0, 1])
+const double MaxFastValue = 1e3;
+
+// Distance from .5 below which the rounded product x * 1e6 cannot be
+// trusted to round like the exact decimal value
+const double TieMargin = 1e-4;
+
+// Writes the decimal digits of value ending before end; returns the start
+inline char *writeDigits(char *end, quint64 value)
+{
+    do {
+        *--end = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return end;
+}
+
+// Fixed 6-decimal formatting into buffer (at least 32 bytes); returns the
+// length, or -1 if value needs the exact conversion
+inline int formatFixed6(char *buffer, double value)
+{
+    if (!(value >= 0.0 && value < MaxFastValue) || std::signbit(value)) {
+        return -1;
+    }
+
+    double scaled = value * 1e6;
+    double whole = std::floor(scaled);
+    double fraction = scaled - whole;
+    if (std::fabs(fraction - 0.5) < TieMargin) {
+        return -1;
+    }
+    quint64 millionths = static_cast<quint64>(whole) + (fraction > 0.5 ? 1 : 0);
+
+    char digits[32];
+    char *end = digits + sizeof(digits);
+    quint64 fractionDigits = millionths % 1000000;
+    char *p = end;
+    for (int i = 0; i < 6; ++i) {
+        *--p = static_cast<char>('0' + fractionDigits % 10);
+        fractionDigits /= 10;
+    }
+    *--p = '.';
+    p = writeDigits(p, millionths / 1000000);
+
+    int length = static_cast<int>(end - p);
+    for (int i = 0; i < length; ++i) {
+        buffer[i] = p[i];
+    }
+    return length;
+}
+
+} // namespace
+
+YoloLabelWriter::YoloLabelWriter()
+{
+    // A reserved QByteArray keeps its allocation when resized to zero
+    m_buffer.reserve(InitialCapacity);
+}
+
+void YoloLabelWriter::clear()
+{
+    m_buffer.resize(0);
+}
+
+void YoloLabelWriter::appendFixed6(QByteArray &out, double value)
+{
+    char buffer[32];
+    int length = formatFixed6(buffer, value);
+    if (length < 0) {
+        out.append(QByteArray::number(value, 'f', 6));
+    } else {
+        out.append(buffer, length);
+    }
+}
+
+void YoloLabelWriter::appendBox(int classId, double xCenter, double yCenter, double width, double height)
+{
+    // The whole line is assembled on the stack and appended at once
+    char line[160];
+    char *p = line;
+
+    char digits[16];
+    char *digitsEnd = digits + sizeof(digits);
+    quint64 magnitude = classId < 0 ? quint64(-static_cast<qint64>(classId)) : quint64(classId);
+    char *start = writeDigits(digitsEnd, magnitude);
+    if (classId < 0) {
+        *p++ = '-';
+    }
+    while (start < digitsEnd) {
+        *p++ = *start++;
+    }
+
+    const double values[4] = { xCenter, yCenter, width, height };
+    for (double value : values) {
+        *p++ = ' ';
+        int length = formatFixed6(p, value);
+        if (length < 0) {
+            // Rare: flush what we have and let Qt format this value
+            m_buffer.append(line, static_cast<int>(p - line));
+            appendFixed6(m_buffer, value);
+            p = line;
+        } else {
+            p += length;
+        }
+    }
+    *p++ = '\n';
+    m_buffer.append(line, static_cast<int>(p - line));
+}
@@ -0,0 +1,38 @@
+#ifndef YOLOLABELWRITER_H
+#define YOLOLABELWRITER_H
+
+#include <QByteArray>
+
+/**
+ * @brief Formats YOLO label lines into one reusable byte buffer
+ *
+ * Produces exactly what the QTextStream/QString::number(value, 'f', 6)
+ * path wrote, without any temporary strings: values in the usual range
+ * are scaled to an integer number of millionths and printed directly.
+ * Values whose rounding is a near tie at the sixth decimal, negative
+ * values and very large ones go through QByteArray::number(), which
+ * shares QString::number()'s conversion.
+ *
+ * clear() keeps the buffer's capacity, so one writer serves any number of
+ * files without reallocating.
+ */
+class YoloLabelWriter
+{
+public:
+    YoloLabelWriter();
+
+    void clear();
+
+    // Append "<class_id> <x_center> <y_center> <width> <height>\n"
+    void appendBox(int classId, double xCenter, double yCenter, double width, double height);
+
+    const QByteArray &data() const { return m_buffer; }
+
+    // Append value as QString::number(value, 'f', 6) would print it
+    static void appendFixed6(QByteArray &out, double value);
+
+private:
+    QByteArray m_buffer;
+};
+
+#endif // YOLOLABELWRITER_H
@@ -0,0 +1,84 @@
+// Micro-benchmark: ImageResampler vs. QImage::scaled(Qt::SmoothTransformation)
+//
+// Usage: ResamplerBenchmark [width height iterations]
+// Scales a synthetic camera-sized image down to common viewport sizes and
+// prints the average time per call for each path.
+
+#include "../ImageResampler.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QSize>
+#include <QList>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+QImage makeTestImage(int width, int height)
+{
+    QImage image(width, height, QImage::Format_RGB32);
+    quint32 seed = 12345;
+    for (int y = 0; y < height; ++y) {
+        quint32 *line = reinterpret_cast<quint32 *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            // Gradient plus noise, so neither path can shortcut flat areas
+            seed = seed * 1664525u + 1013904223u;
+            quint32 noise = (seed >> 24) & 0x3f;
+            line[x] = 0xff000000u | (((x * 255 / width) ^ noise) << 16) |
+                      (((y * 255 / height) ^ noise) << 8) | noise;
+        }
+    }
+    return image;
+}
+
+template <typename Function>
+double averageMs(int iterations, Function function)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        function();
+    }
+    return static_cast<double>(timer.nsecsElapsed()) / 1e6 / iterations;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int width = argc > 2 ? std::atoi(argv[1]) : 6000;
+    int height = argc > 2 ? std::atoi(argv[2]) : 4000;
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 10;
+
+    QImage source = makeTestImage(width, height);
+    QList<QSize> targets;
+    targets << QSize(1920, 1080) << QSize(1180, 700) << QSize(640, 480) << QSize(160, 160);
+
+    std::printf("Source %dx%d, %d iterations, SIMD path: %s\n",
+                width, height, iterations, ImageResampler::simdPath());
+    std::printf("%-12s %14s %14s %14s %9s\n",
+                "target", "Qt smooth ms", "refined ms", "preview ms", "speedup");
+
+    for (const QSize &target : targets) {
+        QImage sink;
+        double qtMs = averageMs(iterations, [&]() {
+            sink = source.scaled(target, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        });
+        double refinedMs = averageMs(iterations, [&]() {
+            sink = ImageResampler::scaleToFit(source, target, ImageResampler::Refined);
+        });
+        double previewMs = averageMs(iterations, [&]() {
+            sink = ImageResampler::scaleToFit(source, target, ImageResampler::Preview);
+        });
+
+        QString label = QString("%1x%2").arg(target.width()).arg(target.height());
+        std::printf("%-12s %14.2f %14.2f %14.2f %8.1fx\n",
+                    label.toLatin1().constData(), qtMs, refinedMs, previewMs,
+                    refinedMs > 0 ? qtMs / refinedMs : 0.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Micro-benchmark: YoloLabelParser vs. the QTextStream/split/toDouble loop
+//
+// Usage: YoloParserBenchmark [boxes iterations]
+// Parses a synthetic label buffer (one box per line, 6 decimals as written
+// by AnnotationManager) and prints the throughput of both paths.
+
+#include "../YoloLabelParser.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QBuffer>
+#include <QStringList>
+#include <QTextStream>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+QByteArray makeLabels(int boxes)
+{
+    QByteArray data;
+    quint32 seed = 12345;
+    for (int i = 0; i < boxes; ++i) {
+        double values[4];
+        for (double &value : values) {
+            seed = seed * 1664525u + 1013904223u;
+            value = (seed >> 8) / 16777216.0;
+        }
+        data += QByteArray::number(i % 80) + ' ' +
+                QByteArray::number(values[0], 'f', 6) + ' ' +
+                QByteArray::number(values[1], 'f', 6) + ' ' +
+                QByteArray::number(values[2], 'f', 6) + ' ' +
+                QByteArray::number(values[3], 'f', 6) + '\n';
+    }
+    return data;
+}
+
+// The loop AnnotationManager::loadAnnotations() used before
+int parseWithTextStream(QByteArray &data, double &checksum)
+{
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly | QIODevice::Text);
+    QTextStream in(&buffer);
+    int count = 0;
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty()) continue;
+        QStringList parts = line.split(' ', Qt::SkipEmptyParts);
+        if (parts.size() != 5) continue;
+        bool ok;
+        int classId = parts[0].toInt(&ok);
+        double sum = 0;
+        for (int i = 1; i < 5 && ok; ++i) {
+            sum += parts[i].toDouble(&ok);
+        }
+        if (ok) {
+            checksum += classId + sum;
+            count++;
+        }
+    }
+    return count;
+}
+
+int parseWithParser(const QByteArray &data, QVector<YoloLabelParser::Box> &boxes, double &checksum)
+{
+    boxes.clear();
+    YoloLabelParser::parse(data.constData(), data.size(), boxes);
+    for (const YoloLabelParser::Box &box : boxes) {
+        // Summed in the same order as above, so equal values give equal sums
+        double sum = box.xCenter + box.yCenter + box.width + box.height;
+        checksum += box.classId + sum;
+    }
+    return boxes.size();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int boxCount = argc > 2 ? std::atoi(argv[1]) : 1000000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    QByteArray data = makeLabels(boxCount);
+    double megabytes = data.size() / 1e6;
+    std::printf("%d boxes, %.1f MB of label text, %d iterations\n", boxCount, megabytes, iterations);
+
+    double textStreamChecksum = 0;
+    QElapsedTimer timer;
+    timer.start();
+    int textStreamBoxes = 0;
+    for (int i = 0; i < iterations; ++i) {
+        textStreamBoxes = parseWithTextStream(data, textStreamChecksum);
+    }
+    double textStreamSeconds = timer.nsecsElapsed() / 1e9 / iterations;
+
+    QVector<YoloLabelParser::Box> boxes;
+    double parserChecksum = 0;
+    timer.restart();
+    int parserBoxes = 0;
+    for (int i = 0; i < iterations; ++i) {
+        parserBoxes = parseWithParser(data, boxes, parserChecksum);
+    }
+    double parserSeconds = timer.nsecsElapsed() / 1e9 / iterations;
+
+    std::printf("%-14s %10s %12s\n", "path", "MB/s", "boxes");
+    std::printf("%-14s %10.1f %12d\n", "QTextStream", megabytes / textStreamSeconds, textStreamBoxes);
+    std::printf("%-14s %10.1f %12d\n", "YoloLabelParser", megabytes / parserSeconds, parserBoxes);
+    std::printf("speedup %.1fx, results %s\n", textStreamSeconds / parserSeconds,
+                textStreamChecksum == parserChecksum ? "identical" : "DIFFER");
+    return 0;
+}
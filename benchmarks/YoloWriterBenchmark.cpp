@@ -0,0 +1,121 @@
+// Micro-benchmark: YoloLabelWriter vs. QTextStream + QString::number()
+//
+// Usage: YoloWriterBenchmark [boxes iterations]
+// Formats synthetic boxes in files of 20 boxes each, the way
+// AnnotationManager::saveAnnotations() does, and checks that both paths
+// produce the same bytes.
+
+#include "../YoloLabelWriter.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QString>
+#include <QTextStream>
+#include <QVector>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const int BoxesPerFile = 20;
+
+struct Box {
+    int classId;
+    double values[4];
+};
+
+QVector<Box> makeBoxes(int count)
+{
+    QVector<Box> boxes(count);
+    quint32 seed = 12345;
+    for (Box &box : boxes) {
+        seed = seed * 1664525u + 1013904223u;
+        box.classId = seed % 80;
+        for (double &value : box.values) {
+            seed = seed * 1664525u + 1013904223u;
+            value = (seed >> 8) / 16777216.0;
+        }
+    }
+    return boxes;
+}
+
+// The loop AnnotationManager::saveAnnotations() used before
+void formatWithTextStream(const QVector<Box> &boxes, int first, int last, QByteArray &data)
+{
+    QTextStream out(&data, QIODevice::WriteOnly);
+    for (int i = first; i < last; ++i) {
+        const Box &box = boxes[i];
+        out << box.classId << " "
+            << QString::number(box.values[0], 'f', 6) << " "
+            << QString::number(box.values[1], 'f', 6) << " "
+            << QString::number(box.values[2], 'f', 6) << " "
+            << QString::number(box.values[3], 'f', 6) << "\n";
+    }
+    out.flush();
+}
+
+void formatWithWriter(const QVector<Box> &boxes, int first, int last, YoloLabelWriter &writer)
+{
+    writer.clear();
+    for (int i = first; i < last; ++i) {
+        const Box &box = boxes[i];
+        writer.appendBox(box.classId, box.values[0], box.values[1], box.values[2], box.values[3]);
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int boxCount = argc > 2 ? std::atoi(argv[1]) : 1000000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+    QVector<Box> boxes = makeBoxes(boxCount);
+
+    // Both paths must produce the same files
+    bool identical = true;
+    YoloLabelWriter writer;
+    for (int first = 0; first < boxCount; first += BoxesPerFile) {
+        int last = qMin(first + BoxesPerFile, boxCount);
+        QByteArray expected;
+        formatWithTextStream(boxes, first, last, expected);
+        formatWithWriter(boxes, first, last, writer);
+        if (writer.data() != expected) {
+            identical = false;
+            std::printf("Mismatch in file %d:\n%s---\n%s", first / BoxesPerFile,
+                        expected.constData(), writer.data().constData());
+            break;
+        }
+    }
+
+    qint64 bytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        for (int first = 0; first < boxCount; first += BoxesPerFile) {
+            QByteArray data;
+            formatWithTextStream(boxes, first, qMin(first + BoxesPerFile, boxCount), data);
+            bytes += data.size();
+        }
+    }
+    double textStreamSeconds = timer.nsecsElapsed() / 1e9 / iterations;
+
+    timer.restart();
+    for (int i = 0; i < iterations; ++i) {
+        for (int first = 0; first < boxCount; first += BoxesPerFile) {
+            formatWithWriter(boxes, first, qMin(first + BoxesPerFile, boxCount), writer);
+            bytes += writer.data().size();
+        }
+    }
+    double writerSeconds = timer.nsecsElapsed() / 1e9 / iterations;
+
+    std::printf("%d boxes in files of %d, %d iterations (%lld bytes)\n",
+                boxCount, BoxesPerFile, iterations, bytes);
+    std::printf("%-16s %12s\n", "path", "Mboxes/s");
+    std::printf("%-16s %12.2f\n", "QTextStream", boxCount / textStreamSeconds / 1e6);
+    std::printf("%-16s %12.2f\n", "YoloLabelWriter", boxCount / writerSeconds / 1e6);
+    std::printf("speedup %.1fx, output %s\n", textStreamSeconds / writerSeconds,
+                identical ? "identical" : "DIFFERENT");
+    return identical ? 0 : 1;
+}
@@ -1,7 +1,9 @@
 #include "MainWindow.h"
 #include "ObjectDetectionWindow.h"
 #include "ModeSelectionDialog.h"
+#include "ImageCache.h"
 #include <QApplication>
+#include <QSettings>
 
 int main(int argc, char *argv[])
 {
@@ -12,6 +14,10 @@ int main(int argc, char *argv[])
     QApplication::setApplicationVersion("2.0");
     QApplication::setOrganizationName("ML Tools");
 
+    // Memory budget for decoded images shared by all windows
+    QSettings settings;
+    ImageCache::instance().setBudgetMB(settings.value("imageCache/budgetMB", 512).toInt());
+
     // Show mode selection dialog
     ModeSelectionDialog modeDialog;
     if (modeDialog.exec() == QDialog::Accepted) {